@@ -42,7 +42,7 @@ void simple_file_server(void) {
 
     if (*file) {
         char *rp = ribs_malloc(PATH_MAX);
-        if (NULL == realpath(file, rp) ||
+        if (NULL == ribs_offload_realpath(file, rp) ||
             0 != strncmp(current_dir_name, rp, current_dir_name_size)) {
             http_server_response_sprintf(HTTP_STATUS_404,
                                          HTTP_CONTENT_TYPE_TEXT_PLAIN, "not found: %s", file);
@@ -72,11 +72,41 @@ void simple_file_server(void) {
     }
 }
 
+/*
+ * threaded mode, one event loop per thread
+ */
+static struct http_server *servers[2];
+static struct http_server *thread_servers = NULL;
+
+static int init_thread(int thread_id) {
+    int i;
+    for (i = 0; i < 2; ++i) {
+        struct http_server *server = servers[i];
+        if (NULL == server)
+            continue;
+        /* thread 0 runs the server initialized by main() */
+        if (0 < thread_id) {
+            struct http_server *clone = thread_servers + thread_id * 2 + i;
+            if (0 > http_server_init_clone(clone, server))
+                return -1;
+            server = clone;
+        }
+        if (0 > http_server_init_acceptor(server))
+            return -1;
+    }
+    return 0;
+}
+
 int main(int argc, char *argv[]) {
     static struct option long_options[] = {
         {"port", 1, 0, 'p'},
         {"daemonize", 0, 0, 'd'},
         {"forks", 1, 0, 'f'},
+        {"uring", 0, 0, 'u'},
+        {"threads", 1, 0, 't'},
+        {"offload", 1, 0, 'o'},
+        {"busy-poll", 1, 0, 'b'},
+        {"reuseport", 0, 0, 'r'},
 #ifdef RIBS2_SSL
         {"ssl_port", 1, 0 ,'s'},
         {"key_file", 1, 0, 'k'},
@@ -89,6 +119,11 @@ int main(int argc, char *argv[]) {
     int port = 8080;
     int daemon_mode = 0;
     int forks = 0;
+    int use_uring = 0;
+    int threads = 0;
+    int offload = 0;
+    int busy_poll = 0;
+    int reuseport = 0;
 #ifdef RIBS2_SSL
     int sport = 8443;
     char *key_file = NULL;
@@ -97,7 +132,7 @@ int main(int argc, char *argv[]) {
 #endif
     for (;;) {
         int option_index = 0;
-        int c = getopt_long(argc, argv, "dp:f:"
+        int c = getopt_long(argc, argv, "drup:f:t:o:b:"
 #ifdef RIBS2_SSL
                             "s:c:k:l:"
 #endif
@@ -114,6 +149,21 @@ int main(int argc, char *argv[]) {
         case 'f':
             forks = atoi(optarg);
             break;
+        case 'u':
+            use_uring = 1;
+            break;
+        case 't':
+            threads = atoi(optarg);
+            break;
+        case 'o':
+            offload = atoi(optarg);
+            break;
+        case 'b':
+            busy_poll = atoi(optarg);
+            break;
+        case 'r':
+            reuseport = 1;
+            break;
 #ifdef RIBS2_SSL
         case 'k':
             key_file = optarg;
@@ -171,6 +221,15 @@ int main(int argc, char *argv[]) {
        specified data (fiber local storage) */
     server.context_size = 0,
     server.bind_addr = htonl(INADDR_ANY);
+    /* busy poll the accepted sockets (needs CAP_NET_ADMIN above
+       net.core.busy_read) */
+    server.busy_poll_usec = busy_poll;
+    /* a listen socket per thread (or fork) instead of a shared one */
+    server.reuseport = reuseport;
+    server.num_listeners = (0 < forks ? forks : sysconf(_SC_NPROCESSORS_CONF)) * (1 < threads ? threads : 1);
+    /* give the memory of stacks which were idle for a minute back
+       to the kernel */
+    server.stack_trim_msec = 60000;
 #ifdef RIBS2_SSL
     server.use_ssl = 0;
 
@@ -206,6 +265,8 @@ int main(int argc, char *argv[]) {
     server_ssl.context_size = 0,
     /* accept connections from any address */
     server_ssl.bind_addr = htonl(INADDR_ANY),
+    server_ssl.reuseport = reuseport;
+    server_ssl.num_listeners = server.num_listeners;
     server_ssl.use_ssl = 1,
     server_ssl.privatekey_file = key_file,
     server_ssl.certificate_chain_file = chain_file;
@@ -237,9 +298,39 @@ int main(int argc, char *argv[]) {
             vmfile_close(&vmf);
     }
 
+    /* spin before blocking in epoll_wait */
+    if (0 < busy_poll && 0 > epoll_worker_set_busy_poll(busy_poll))
+        exit(EXIT_FAILURE);
+
+    /* run the event loop on io_uring instead of epoll */
+    if (use_uring && 0 > epoll_worker_set_backend(EPOLL_WORKER_BACKEND_URING))
+        exit(EXIT_FAILURE);
+
     if (0 > ribs_server_init(daemon_mode, "httpd.pid", "httpd.log", forks))
         exit(EXIT_FAILURE);
 
+    /* run the blocking file system calls in a thread pool */
+    if (0 < offload && 0 > ribs_offload_init(offload))
+        exit(EXIT_FAILURE);
+
+    if (1 < threads) {
+        /* one event loop and acceptor per thread, sharing the listen
+           sockets (and everything else which is read only) */
+        servers[0] = &server;
+        server.accept_exclusive = 1;
+#ifdef RIBS2_SSL
+        if (key_file) {
+            servers[1] = &server_ssl;
+            server_ssl.accept_exclusive = 1;
+        }
+#endif
+        thread_servers = calloc(threads * 2, sizeof(struct http_server));
+        if (NULL == thread_servers || 0 > epoll_worker_init_threads(threads, init_thread))
+            exit(EXIT_FAILURE);
+        ribs_server_start();
+        return 0;
+    }
+
     /* initialize the event loop */
     if (0 > epoll_worker_init())
         exit(EXIT_FAILURE);
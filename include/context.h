@@ -26,6 +26,8 @@
 
 #define SMALL_STACK_SIZE 4096
 
+struct ctx_pool_chunk;
+
 #ifdef __x86_64__
 #define NUM_ADDITIONAL_REGS 5
 #endif
@@ -52,12 +54,15 @@ struct ribs_context {
 #endif
 #endif
     struct ribs_context *next_free;
+    struct ribs_context *next_runnable; /* epoll_worker run queue */
+    void (*entry_func)(void); /* set by ribs_makecontext */
+    struct ctx_pool_chunk *pool_chunk; /* NULL when not allocated from a ctx_pool */
     struct memalloc memalloc;
     uint32_t ribify_memalloc_refcount;
     char reserved[];
 };
 
-extern struct ribs_context *current_ctx, *event_loop_ctx;
+extern _RIBS_THREAD_LOCAL_ struct ribs_context *current_ctx, *event_loop_ctx;
 
 extern void ribs_swapcurcontext(struct ribs_context *rctx);
 extern void ribs_makecontext(struct ribs_context *ctx, struct ribs_context *pctx, void (*func)(void));
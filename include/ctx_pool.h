@@ -23,15 +23,71 @@
 #include "ribs_defs.h"
 #include "context.h"
 
+#define CTX_POOL_STACK_USAGE_BUCKETS 32
+/* number of measurements required before a smaller stack size is suggested */
+#define CTX_POOL_PROFILE_MIN_SAMPLES 1024
+
+struct ctx_pool_stack_info {
+    uint32_t used_pages; /* high water mark in pages, 0 when not profiled */
+    uint32_t reclaimed;
+};
+
+/* one mmap'ed region of stacks, ctx->pool_chunk points back to it */
+struct ctx_pool_chunk {
+    struct ctx_pool_chunk *next;
+    void *mem;
+    size_t stack_size;
+    size_t num_stacks;
+    size_t num_idle; /* used by ctx_pool_trim */
+    struct ctx_pool_stack_info *stacks;
+};
+
 struct ctx_pool {
     size_t grow_by;
     size_t stack_size;
     size_t reserved_size;
     struct ribs_context *freelist;
+    struct ctx_pool_chunk *chunks;
+    size_t num_stacks;
+    size_t min_stacks;
+    size_t num_free;
+    size_t min_free; /* low water mark of num_free since the last trim */
+    size_t mapped_bytes;
+    size_t reclaimed_bytes; /* as of the last ctx_pool_trim */
+    int trim_advice; /* MADV_DONTNEED by default, MADV_FREE is lazier */
+    /* stack profiler, see ctx_pool_profile_stacks */
+    int profile_stacks;
+    int apply_profile;
+    uint64_t num_samples;
+    size_t max_stack_usage;
+    uint64_t stack_usage[CTX_POOL_STACK_USAGE_BUCKETS]; /* log2 histogram, in bytes */
 };
 
 int ctx_pool_init(struct ctx_pool *cp, size_t initial_size, size_t grow_by, size_t stack_size, size_t reserved_size);
 int ctx_pool_createstacks(struct ctx_pool *cp, size_t num_stacks, size_t stack_size, size_t reserved_size);
+/*
+ * Stack profiler (opt-in). Free stacks and stacks of new chunks are
+ * painted with a canary, which commits their memory, so enable it on a
+ * canary instance or with a realistic stack size. Every ctx_pool_put
+ * measures the stack high water mark page-wise, continuing down from
+ * the previous mark. When apply is set, new chunks are allocated with
+ * the suggested stack size once enough samples were taken.
+ */
+void ctx_pool_profile_stacks(struct ctx_pool *cp, int apply);
+void ctx_pool_measure_stack(struct ctx_pool *cp, struct ribs_context *ctx);
+size_t ctx_pool_suggested_stack_size(struct ctx_pool *cp);
+void ctx_pool_dump_stack_usage(struct ctx_pool *cp);
+int ctx_pool_grow(struct ctx_pool *cp);
+/*
+ * Elastic pool. Since the freelist is LIFO, the free stacks below the
+ * low water mark were not touched since the previous call; their pages
+ * (all but the top one which holds the context) are returned to the
+ * kernel and chunks which are entirely idle are unmapped, as long as
+ * the pool doesn't shrink below its initial size. Call periodically,
+ * the period being the idle time. Returns the number of bytes reclaimed.
+ */
+size_t ctx_pool_trim(struct ctx_pool *cp);
+void ctx_pool_dump_stats(struct ctx_pool *cp);
 _RIBS_INLINE_ struct ribs_context *ctx_pool_get(struct ctx_pool *cp);
 _RIBS_INLINE_ void ctx_pool_put(struct ctx_pool *cp, struct ribs_context *ctx);
 
@@ -23,33 +23,87 @@
 #include "ribs_defs.h"
 #include "context.h"
 #include "list.h"
+#include "timer_wheel.h"
 #include "ribs_ssl.h"
 
-extern struct epoll_event last_epollev;
+extern _RIBS_THREAD_LOCAL_ struct epoll_event last_epollev;
 
 struct epoll_worker_fd_data {
     struct ribs_context *ctx;
-    struct list timeout_chain;
-    struct timeval timestamp;
+    uint32_t events; /* interest mask, as registered with epoll */
+    struct timer_wheel_entry timer; /* connection deadline */
 };
 
-extern struct epoll_worker_fd_data *epoll_worker_fd_map;
+extern _RIBS_THREAD_LOCAL_ struct epoll_worker_fd_data *epoll_worker_fd_map;
 
+/* max number of events harvested by a single epoll_wait */
+#define EPOLL_WORKER_DEFAULT_MAX_EVENTS 256
+#define EPOLL_WORKER_STATS_NUM_BUCKETS 16
+/* max number of queued ribbons to run between two epoll harvests */
+#define EPOLL_WORKER_DEFAULT_RUN_QUEUE_BUDGET 64
+
+struct epoll_worker_stats {
+    uint64_t num_wakeups;
+    uint64_t num_events;
+    uint64_t num_runnable; /* ribbons dispatched from the run queue */
+    uint64_t busy_poll_hits; /* events found while spinning */
+    uint64_t busy_poll_misses; /* had to block after spinning */
+    /* log2 histogram of the number of events per wakeup */
+    uint64_t events_per_wakeup[EPOLL_WORKER_STATS_NUM_BUCKETS];
+};
+
+/* execution backends, selected before epoll_worker_init(). The uring
+   backend falls back to epoll when io_uring is not available */
+enum {
+    EPOLL_WORKER_BACKEND_EPOLL,
+    EPOLL_WORKER_BACKEND_URING,
+};
+
+int epoll_worker_set_max_events(int max_events);
+int epoll_worker_set_run_queue_budget(int budget);
+int epoll_worker_set_backend(int backend);
+/* spin on a non blocking epoll_wait for up to usec before blocking,
+   trades CPU for wakeup latency. 0 disables */
+int epoll_worker_set_busy_poll(unsigned usec);
+int epoll_worker_get_backend(void);
 int epoll_worker_init(void);
+/* threaded mode: one event loop per thread, thread_init() runs on each
+   of them (thread 0 is the calling thread) after epoll_worker_init().
+   call after ribs_server_init(), link with -lpthread */
+int epoll_worker_init_threads(int num_threads, int (*thread_init)(int thread_id));
+int epoll_worker_get_thread_id(void);
+/* event loop threads per process, 1 unless epoll_worker_init_threads() */
+int epoll_worker_get_num_threads(void);
 void epoll_worker_loop(void);
 void epoll_worker_exit(void);
 void yield(void);
 void courtesy_yield(void);
 int ribs_epoll_add(int fd, uint32_t events, struct ribs_context* ctx);
+int ribs_epoll_mod(int fd, uint32_t events);
 struct ribs_context* small_ctx_for_fd(int fd, size_t reserved_size, void (*func)(void));
+void epoll_worker_queue_ctx(struct ribs_context *ctx);
+/* a ribbon which is about to be freed must not stay on the run queue */
+void epoll_worker_dequeue_ctx(struct ribs_context *ctx);
 int queue_current_ctx(void);
 int epoll_close();
 int ribs_close(int fd);
+void epoll_worker_get_stats(struct epoll_worker_stats *stats);
+void epoll_worker_dump_stats(void);
 
 _RIBS_INLINE_ void epoll_worker_ignore_events(int fd);
 _RIBS_INLINE_ void epoll_worker_resume_events(int fd);
 _RIBS_INLINE_ void epoll_worker_set_fd_ctx(int fd, struct ribs_context* ctx);
 _RIBS_INLINE_ void epoll_worker_set_last_fd(int fd);
+/* sockets are registered for EPOLLIN only, writers arm EPOLLOUT when
+   they have to wait (EAGAIN or short write) and disarm it when done */
+_RIBS_INLINE_ int epoll_worker_arm_write(int fd);
+_RIBS_INLINE_ int epoll_worker_disarm_write(int fd);
+/* per fd deadline, the socket is shut down when it expires which
+   wakes up its ribbon. ribs_close() clears it */
+_RIBS_INLINE_ int epoll_worker_set_timeout(int fd, time_t msec);
+_RIBS_INLINE_ void epoll_worker_clear_timeout(int fd);
+_RIBS_INLINE_ int epoll_worker_timeout_pending(int fd);
+void epoll_worker_timeout_expired(void *fd_data);
 
 
 #include "../src/_epoll_worker.c"
@@ -0,0 +1,74 @@
+/*
+    This file is part of RIBS2.0 (Robust Infrastructure for Backend Systems).
+    RIBS is an infrastructure for building great SaaS applications (but not
+    limited to).
+
+    Copyright (C) 2015 TrueSkills, Inc.
+
+    RIBS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, version 2.1 of the License.
+
+    RIBS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with RIBS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _EPOLL_WORKER_HEALTH__H_
+#define _EPOLL_WORKER_HEALTH__H_
+
+#include "ribs_defs.h"
+#include <pthread.h>
+
+/* log2 histograms of nanoseconds, bucket i counts [2^i, 2^(i+1)) */
+#define EPOLL_WORKER_HEALTH_NUM_BUCKETS 40
+
+struct epoll_worker_health {
+    uint64_t elapsed; /* ns since enabled or reset */
+    uint64_t num_switches;
+    uint64_t num_harvests;
+    uint64_t num_events;
+    uint64_t max_run_time;
+    uint64_t max_loop_lag;
+    /* how long a ribbon ran before yielding */
+    uint64_t run_time[EPOLL_WORKER_HEALTH_NUM_BUCKETS];
+    /* time spent between two harvests, i.e. how late new events
+       are picked up */
+    uint64_t loop_lag[EPOLL_WORKER_HEALTH_NUM_BUCKETS];
+};
+
+/* per event loop, call from the thread running the loop */
+int epoll_worker_health_enable(int enable);
+void epoll_worker_health_reset(void);
+void epoll_worker_health_get(struct epoll_worker_health *health);
+void epoll_worker_health_dump(void);
+uint64_t epoll_worker_health_now(void); /* ns, TSC based on x86_64 */
+
+/* logs the entry function and the stack of ribbons which run longer
+   than threshold_ms without yielding, in all the event loops which
+   have health enabled. link with -lpthread */
+int epoll_worker_watchdog_start(unsigned threshold_ms);
+
+/* state of the running ribbon, scanned by the watchdog */
+#define EPOLL_WORKER_HEALTH_MAX_LOOPS 1024
+struct epoll_worker_health_loop {
+    pthread_t thread;
+    volatile uint64_t switch_tick;
+    volatile uint32_t switch_seq;
+    volatile int in_wait;
+};
+extern struct epoll_worker_health_loop *epoll_worker_health_loops[EPOLL_WORKER_HEALTH_MAX_LOOPS];
+extern int epoll_worker_health_num_loops;
+uint64_t epoll_worker_health_ticks(void);
+uint64_t epoll_worker_health_ticks_to_ns(uint64_t ticks);
+
+/* hooks, called by epoll_worker */
+extern _RIBS_THREAD_LOCAL_ int epoll_worker_health_enabled;
+void epoll_worker_health_on_switch(void);
+void epoll_worker_health_on_wait(void);
+void epoll_worker_health_on_wakeup(int num_events);
+
+#endif // _EPOLL_WORKER_HEALTH__H_
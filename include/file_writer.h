@@ -30,6 +30,7 @@
 #include <sys/mman.h>
 #include <string.h>
 #include "ilog2.h"
+#include "ribs_offload.h"
 
 #define FILE_WRITER_INITIALIZER { -1, NULL, 0, 0, 0, 0, 1024*1024 }
 #define FILE_WRITER_INIT(var) (var) = ((struct file_writer)FILE_WRITER_INITIALIZER)
@@ -31,7 +31,11 @@
 struct http_client_pool {
     struct ctx_pool ctx_pool;
     struct timeout_handler timeout_handler;
-    struct timeout_handler timeout_handler_persistent;
+    struct timeout_handler timeout_handler_persistent; /* idle persistent connections */
+    /* per connection deadlines in msec, 0 to use timeout_handler.timeout */
+    time_t connect_timeout;
+    time_t read_timeout;
+    time_t write_timeout;
 #ifdef RIBS2_SSL
     SSL_CTX *ssl_ctx;
     int check_cert;
@@ -21,6 +21,7 @@
 #define _HTTP_HEADERS__H_
 
 #include "ribs_defs.h"
+#include "http_parser.h"
 #include <arpa/inet.h>
 
 /*
@@ -39,7 +40,7 @@ struct http_headers{
     char *origin;
     char *authorization;
     uint8_t accept_encoding_mask;
-    char peer_ip_addr[INET_ADDRSTRLEN];
+    char peer_ip_addr[INET6_ADDRSTRLEN];
 };
 
 /*
@@ -55,5 +56,8 @@ enum {
 
 int http_headers_init(void);
 void http_headers_parse(char *headers, struct http_headers *h);
+/* same from the spans of a completed parser, no rescanning. buf is the
+   parsed buffer, values are \0 terminated in place */
+void http_headers_parse_spans(char *buf, const struct http_parser *parser, struct http_headers *h);
 
 #endif // _HTTP_HEADERS__H_
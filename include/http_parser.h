@@ -0,0 +1,126 @@
+/*
+    This file is part of RIBS2.0 (Robust Infrastructure for Backend Systems).
+    RIBS is an infrastructure for building great SaaS applications (but not
+    limited to).
+
+    Copyright (C) 2015 TrueSkills, Inc.
+
+    RIBS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, version 2.1 of the License.
+
+    RIBS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with RIBS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _HTTP_PARSER__H_
+#define _HTTP_PARSER__H_
+
+#include "ribs_defs.h"
+
+/*
+ * Incremental HTTP/1.x request header parser. Feed it the whole
+ * buffer received so far, it resumes where the previous call stopped
+ * and never rescans complete lines. Nothing is copied or modified,
+ * the results are offsets into the buffer so it can be remapped
+ * (vmbuf growth) between calls.
+ */
+#define HTTP_PARSER_MAX_HEADERS 64
+
+enum {
+    HTTP_PARSER_ERROR = -1,
+    HTTP_PARSER_AGAIN = 0,
+    HTTP_PARSER_DONE = 1
+};
+
+enum {
+    HTTP_METHOD_UNKNOWN = 0,
+    HTTP_METHOD_GET,
+    HTTP_METHOD_HEAD,
+    HTTP_METHOD_POST,
+    HTTP_METHOD_PUT,
+    HTTP_METHOD_DELETE,
+    HTTP_METHOD_OPTIONS,
+    HTTP_METHOD_PATCH,
+    HTTP_METHOD_CONNECT,
+    HTTP_METHOD_TRACE
+};
+
+/* flags */
+#define HTTP_PARSER_CONTENT_LENGTH     0x01
+#define HTTP_PARSER_TRANSFER_ENCODING  0x02
+#define HTTP_PARSER_CHUNKED            0x04 /* chunked is the final coding */
+#define HTTP_PARSER_CONNECTION_CLOSE   0x08
+#define HTTP_PARSER_KEEP_ALIVE         0x10
+#define HTTP_PARSER_EXPECT_CONTINUE    0x20
+
+/* http_body_decoder states */
+enum {
+    HTTP_BODY_IDENTITY,
+    HTTP_BODY_CHUNK_SIZE,
+    HTTP_BODY_CHUNK_DATA,
+    HTTP_BODY_CHUNK_END,
+    HTTP_BODY_TRAILER,
+    HTTP_BODY_DONE
+};
+
+struct http_parser_span {
+    uint32_t ofs;
+    uint32_t len;
+};
+
+struct http_parser_header {
+    struct http_parser_span name;
+    struct http_parser_span value; /* without the surrounding whitespace */
+};
+
+struct http_parser {
+    int state;
+    uint32_t line; /* start of the current line */
+    uint32_t pos; /* resume scanning from here */
+    int method;
+    int version_minor; /* HTTP/1.x, 0 when the version is missing */
+    struct http_parser_span method_name;
+    struct http_parser_span uri;
+    uint32_t headers_ofs; /* first header line */
+    uint32_t headers_end; /* end of line of the last header (or request) line */
+    uint32_t header_len; /* the body starts here */
+    uint32_t flags;
+    uint64_t content_length;
+    uint32_t num_headers;
+    struct http_parser_header headers[HTTP_PARSER_MAX_HEADERS];
+};
+
+/*
+ * Request body decoder, Content-Length or chunked. Decodes in place:
+ * the chunk framing is squeezed out so the body is contiguous from
+ * where it starts (header_len) to wpos, raw bytes not decoded yet
+ * start at rpos. Once done, rpos is the start of the next request.
+ */
+struct http_body_decoder {
+    int state;
+    uint32_t rpos; /* next raw byte */
+    uint32_t wpos; /* end of the decoded body */
+    uint64_t left; /* of the body or of the current chunk */
+};
+
+void http_parser_init(struct http_parser *parser);
+/* returns HTTP_PARSER_DONE once the header is complete, HTTP_PARSER_AGAIN
+   when more data is needed and HTTP_PARSER_ERROR on malformed input */
+int http_parser_parse(struct http_parser *parser, const char *buf, size_t len);
+_RIBS_INLINE_ int http_parser_keep_alive(const struct http_parser *parser);
+/* header value by case insensitive name, NULL if not present */
+const struct http_parser_span *http_parser_find_header(const struct http_parser *parser, const char *buf, const char *name);
+
+void http_body_decoder_init(struct http_body_decoder *decoder, const struct http_parser *parser);
+/* same return values as http_parser_parse() */
+int http_body_decode(struct http_body_decoder *decoder, char *buf, size_t len);
+_RIBS_INLINE_ int http_body_decoder_done(const struct http_body_decoder *decoder);
+
+#include "../src/_http_parser.c"
+
+#endif // _HTTP_PARSER__H_
@@ -0,0 +1,75 @@
+/*
+    This file is part of RIBS2.0 (Robust Infrastructure for Backend Systems).
+    RIBS is an infrastructure for building great SaaS applications (but not
+    limited to).
+
+    Copyright (C) 2015 TrueSkills, Inc.
+
+    RIBS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, version 2.1 of the License.
+
+    RIBS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with RIBS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _HTTP_RESPONSE_CACHE__H_
+#define _HTTP_RESPONSE_CACHE__H_
+
+#include "ribs_defs.h"
+#include "hashtable.h"
+#include "list.h"
+#include "vmbuf.h"
+#include "ribs_sync.h"
+
+/*
+ * Per event loop cache of complete responses, keyed by method, URI
+ * (with the query) and the request headers named by the response's
+ * Vary. Responses are kept serialized, without the Connection header,
+ * and a hit is sent with a single writev. Requests for a key which is
+ * already being generated wait for it instead of running the handler
+ * again, unless the last response for the URI was not stored.
+ *
+ * Stored: GET/HEAD responses with a cacheable status, not streamed,
+ * no Set-Cookie, not no-store/no-cache/private. The TTL comes from
+ * s-maxage/max-age, default_ttl (msec) otherwise (0: not stored).
+ * Least recently used entries are evicted above max_bytes.
+ */
+
+struct http_response_cache_stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t coalesced; /* waited for the same request in flight */
+    uint64_t stores;
+    uint64_t evictions;
+};
+
+struct http_response_cache {
+    /* configurable */
+    size_t max_bytes;
+    time_t default_ttl;
+    int coalesce_timeout; /* msec */
+    /* internal use */
+    size_t bytes;
+    struct hashtable ht_entries;
+    struct hashtable ht_vary; /* method + URI -> Vary header names */
+    struct hashtable ht_not_stored; /* method + URI, last response not stored */
+    struct hashtable ht_pending; /* key -> request in flight */
+    struct list lru; /* most recently used first */
+    struct ribs_mutex mutex;
+    struct vmbuf scratch; /* the head of the response being stored */
+    struct http_response_cache_stats stats;
+};
+
+int http_response_cache_init(struct http_response_cache *cache, size_t max_bytes, time_t default_ttl);
+void http_response_cache_free(struct http_response_cache *cache);
+/* serve the current request from the cache, or call handler and keep
+   its response */
+void http_response_cache_serve(struct http_response_cache *cache, void (*handler)(void));
+void http_response_cache_purge(struct http_response_cache *cache);
+
+#endif // _HTTP_RESPONSE_CACHE__H_
@@ -0,0 +1,81 @@
+/*
+    This file is part of RIBS2.0 (Robust Infrastructure for Backend Systems).
+    RIBS is an infrastructure for building great SaaS applications (but not
+    limited to).
+
+    Copyright (C) 2015 TrueSkills, Inc.
+
+    RIBS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, version 2.1 of the License.
+
+    RIBS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with RIBS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _HTTP_ROUTER__H_
+#define _HTTP_ROUTER__H_
+
+#include "ribs_defs.h"
+#include "vmbuf.h"
+#include "http_parser.h"
+
+/*
+ * URI router, a radix trie of path patterns. A pattern is made of
+ * static text, ":name" segments (one non-empty path segment) and an
+ * optional "*name" tail (the rest of the path, may be empty), e.g.
+ * "/users/:id", or "/files/" followed by "*path", up to
+ * HTTP_ROUTER_MAX_PARAMS of them. Static text wins over a parameter
+ * which wins over a tail. Matching does not allocate, captured values
+ * point into the matched path.
+ *
+ * Handlers are per method (any method known to http_parser reaches
+ * user_func), HTTP_ROUTER_ANY_METHOD catches the methods without their
+ * own handler and HEAD falls back to GET.
+ */
+#define HTTP_ROUTER_MAX_PARAMS 8
+#define HTTP_ROUTER_NUM_METHODS (HTTP_METHOD_TRACE + 1)
+#define HTTP_ROUTER_ANY_METHOD HTTP_METHOD_UNKNOWN
+
+#define HTTP_ROUTER_INITIALIZER { VMBUF_INITIALIZER, VMBUF_INITIALIZER }
+
+enum {
+    HTTP_ROUTER_MATCH = 0,
+    HTTP_ROUTER_NOT_FOUND = -1,
+    HTTP_ROUTER_METHOD_NOT_ALLOWED = -2
+};
+
+struct http_router_param {
+    const char *name;
+    uint32_t name_len;
+    const char *value;
+    uint32_t value_len;
+};
+
+struct http_router_match {
+    void (*handler)(void);
+    uint32_t num_params;
+    struct http_router_param params[HTTP_ROUTER_MAX_PARAMS];
+};
+
+struct http_router {
+    /* internal use */
+    struct vmbuf nodes;
+    struct vmbuf strings;
+};
+
+int http_router_init(struct http_router *router);
+void http_router_free(struct http_router *router);
+int http_router_add(struct http_router *router, int method, const char *pattern, void (*handler)(void));
+/* returns HTTP_ROUTER_MATCH and fills match, or one of the errors */
+int http_router_match(const struct http_router *router, int method, const char *path, size_t len, struct http_router_match *match);
+const struct http_router_param *http_router_get_param(const struct http_router_match *match, const char *name);
+/* route the current request (http_server_context.route holds the
+   match), 404/405 when there is no handler */
+void http_router_run(struct http_router *router);
+
+#endif // _HTTP_ROUTER__H_
@@ -28,10 +28,15 @@
 #include "hashtable.h"
 #include "uri_decode.h"
 #include "http_headers.h"
+#include "http_parser.h"
+#include "http_router.h"
+#include <sys/uio.h>
 #ifdef RIBS2_SSL
 #include <openssl/ssl.h>
 #endif
 
+struct http_response_cache;
+
 struct http_server_context {
     int fd;
     struct http_server *server;
@@ -44,14 +49,28 @@ struct http_server_context {
     char *content;
     uint32_t content_len;
     int persistent;
+    int stream; /* streamed response state */
+    struct http_parser parser;
+    struct http_body_decoder body;
+    uint32_t body_ofs; /* next body byte for http_server_body_read() */
+    struct http_router_match route; /* set by http_router_run() */
     char user_data[];
 };
 
+/* per instance, see http_server.accept_stats */
+struct http_server_accept_stats {
+    uint64_t accepted;
+    uint64_t errors;
+    uint64_t rejected; /* out of fds, closed right away */
+    uint64_t wakeups; /* accepted / wakeups is the average batch */
+    uint64_t budget_exhausted; /* wakeups which hit accept_budget */
+};
+
 struct http_server {
     int fd;
     uint16_t port;
     struct ctx_pool ctx_pool;
-    void (*user_func)(void);
+    void (*user_func)(void); /* any known method (ctx->parser.method), 501 for the others */
     /* misc ctx */
     struct ribs_context *accept_ctx;
     struct ribs_context *idle_ctx;
@@ -63,7 +82,10 @@ struct http_server {
     size_t init_payload_size;
     size_t max_req_size;
     size_t context_size;
-    uint32_t bind_addr;
+    int family; /* AF_INET (default), AF_INET6 (dual stack) or AF_UNIX */
+    uint32_t bind_addr; /* AF_INET, network order */
+    struct in6_addr bind_addr6; /* AF_INET6 */
+    const char *unix_path; /* AF_UNIX, replaces a stale socket file */
 #ifdef RIBS2_SSL
     int use_ssl;
     SSL_CTX *ssl_ctx;
@@ -74,10 +96,35 @@ struct http_server {
     int (*http_server_read)(struct http_server_context *ctx);
     int (*http_server_write)(struct http_server_context *ctx);
     int (*http_server_sendfile)(struct http_server_context *ctx, int ffd, ssize_t size);
+    int use_uring; /* set by http_server_init_acceptor */
+    int accept_exclusive; /* share the listen socket with other event loops */
+    /* SO_REUSEPORT: a listen socket per instance (event loop thread of
+       a forked process), instance i accepts from socket i */
+    int reuseport;
+    int num_listeners; /* forks * threads, required with reuseport */
+    int reuseport_cpu; /* steer connections to the socket of the CPU they arrive on, pins instance i to CPU i */
+    int *listen_fds; /* set by http_server_init2() */
+    int instance; /* set by http_server_init_acceptor() */
+    struct http_server_accept_stats accept_stats;
+    int accept_budget; /* connections accepted per wakeup, 0 for the default */
+    int defer_accept; /* TCP_DEFER_ACCEPT in seconds, starts reading right after accept. 0 to disable */
+    int fastopen_qlen; /* TCP_FASTOPEN queue length, 0 to disable */
+    int slab_buffers; /* request and response buffers from vmbuf_init_slab(), released when the connection goes idle */
+    size_t response_cache_size; /* bytes per event loop, 0 to disable. see http_response_cache.h */
+    time_t response_cache_ttl; /* msec, for responses without max-age */
+    struct http_response_cache *response_cache; /* set by http_server_init_acceptor() */
+    int busy_poll_usec; /* SO_BUSY_POLL on accepted sockets, 0 to disable */
+    time_t stack_trim_msec; /* return stacks idle for that long to the kernel, 0 to disable */
+    /* per connection deadlines in msec, 0 to use timeout_handler.timeout */
+    time_t header_timeout; /* first byte, then the whole request header */
+    time_t body_timeout; /* the whole request body */
+    time_t write_timeout; /* no progress while writing the response */
+    time_t keepalive_timeout; /* idle persistent connection */
+    int stream_body; /* call user_func before reading the body, see http_server_body_read() */
 };
 
 
-#define _HTTP_SERVER_INIT .port = 0, .stack_size = 0, .num_stacks = 0, .init_request_size = 8*1024, .init_header_size = 8*1024, .init_payload_size = 8*1024, .max_req_size = 0, .context_size = 0, .timeout_handler.timeout = 60000, .bind_addr = INADDR_ANY, .http_server_read = NULL, .http_server_write = NULL, .http_server_sendfile = NULL
+#define _HTTP_SERVER_INIT .port = 0, .stack_size = 0, .num_stacks = 0, .init_request_size = 8*1024, .init_header_size = 8*1024, .init_payload_size = 8*1024, .max_req_size = 0, .context_size = 0, .timeout_handler.timeout = 60000, .family = AF_INET, .bind_addr = INADDR_ANY, .bind_addr6 = IN6ADDR_ANY_INIT, .unix_path = NULL, .http_server_read = NULL, .http_server_write = NULL, .http_server_sendfile = NULL, .use_uring = 0, .accept_exclusive = 0, .reuseport = 0, .num_listeners = 0, .reuseport_cpu = 0, .listen_fds = NULL, .instance = 0, .accept_stats = { 0, 0, 0, 0, 0 }, .accept_budget = 0, .defer_accept = 0, .fastopen_qlen = 0, .slab_buffers = 0, .response_cache_size = 0, .response_cache_ttl = 0, .response_cache = NULL, .busy_poll_usec = 0, .stack_trim_msec = 0, .header_timeout = 0, .body_timeout = 0, .write_timeout = 0, .keepalive_timeout = 0, .stream_body = 0
 
 #ifdef RIBS2_SSL
 #define _HTTP_SERVER_SSL_INIT .use_ssl = 0, .cipher_list = NULL, .privatekey_file = NULL, .certificate_chain_file = NULL
@@ -95,6 +142,9 @@ int http_server_init_ssl(struct http_server *server);
 #endif
 int http_server_init2(struct http_server *server);
 int http_server_init_acceptor(struct http_server *server);
+/* per thread copy of an initialized server (shares its listen socket),
+   call from the thread_init of epoll_worker_init_threads() */
+int http_server_init_clone(struct http_server *server, const struct http_server *parent);
 void http_server_header_start(const char *status, const char *content_type);
 void http_server_header_start_no_body(const char *status);
 void http_server_header_close(void);
@@ -111,7 +161,41 @@ void http_server_header_vredirect(const char *format, va_list ap);
 void http_server_redirect(const char *status, const char *content_type, const char *format, ...);
 void http_server_vredirect(const char *status, const char *content_type, const char *format, va_list ap);
 void http_server_header_content_length(void);
+/*
+ * Streamed responses, for bodies of unknown length. Chunked for
+ * HTTP/1.1, delimited by closing the connection for HTTP/1.0. Headers
+ * can be added to ctx->header until the first flush. Writes are
+ * buffered in ctx->payload and sent together with the chunk framing
+ * (and the header the first time) in a single writev, the ribbon
+ * yields while the socket buffer is full. All return -1 once the
+ * connection failed.
+ */
+int http_server_stream_begin(const char *status, const char *content_type);
+int http_server_stream_write(const void *data, size_t size);
+int http_server_stream_printf(const char *format, ...) __attribute__ ((format (gnu_printf, 1, 2)));
+int http_server_stream_vprintf(const char *format, va_list ap);
+int http_server_stream_flush(void);
+int http_server_stream_end(void);
+/* a complete response (status line included) straight to the socket,
+   ctx->header and ctx->payload are discarded. iov is modified */
+int http_server_writev(struct iovec *iov, int iovcnt);
+/*
+ * Request body. Without stream_body the whole body is in ctx->content
+ * when user_func is called. With it, user_func is called once the
+ * header is in and reads the body (Content-Length or chunked) with
+ * these, max_req_size does not limit it. A body which is not read to
+ * the end closes the connection.
+ */
+/* like read(2): 0 at the end of the body, -1 on error */
+ssize_t http_server_body_read(void *buf, size_t size);
+/* the rest of the body into fd, spliced from the socket when
+   possible. fd must be a regular file (EINVAL otherwise). returns the
+   number of bytes written, -1 on error */
+ssize_t http_server_body_splice(int fd);
 void http_server_fiber_main(void);
+/* fill h from the parsed request header, values are \0 terminated in
+   place (like http_headers_parse(), call it once per request) */
+void http_server_parse_headers(struct http_headers *h);
 int http_server_sendfile(const char *filename);
 int http_server_sendfile2(const char *filename, const char *additional_headers, const char *ext);
 int http_server_sendfile_payload(int ffd, off_t size);
@@ -29,14 +29,18 @@
 #include "thashtable.h"
 #include "lhashtable.h"
 #include "epoll_worker.h"
+#include "epoll_worker_health.h"
 #include "logger.h"
 #include "daemonize.h"
 #include "http_server.h"
 #include "http_file_server.h"
 #include "http_vhost.h"
+#include "http_response_cache.h"
+#include "http_router.h"
 #include "http_defs.h"
 #include "http_client_pool.h"
 #include "http_headers.h"
+#include "http_parser.h"
 #include "http_cookies.h"
 #include "file_mapper.h"
 #include "file_writer.h"
@@ -46,9 +50,14 @@
 #include "bitvect.h"
 #include "object_pool.h"
 #include "sleep.h"
+#include "ribs_offload.h"
+#include "ribs_task.h"
+#include "ribs_sync.h"
 #include "malloc.h"
 #include "timer.h"
 #include "timer_worker.h"
+#include "timer_wheel.h"
+#include "ribs_clock.h"
 #include "base64.h"
 
 #endif // _RIBS__H_
@@ -0,0 +1,56 @@
+/*
+    This file is part of RIBS2.0 (Robust Infrastructure for Backend Systems).
+    RIBS is an infrastructure for building great SaaS applications (but not
+    limited to).
+
+    Copyright (C) 2015 TrueSkills, Inc.
+
+    RIBS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, version 2.1 of the License.
+
+    RIBS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with RIBS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _RIBS_CLOCK__H_
+#define _RIBS_CLOCK__H_
+
+#include "ribs_defs.h"
+#include <time.h>
+
+/*
+ * Per event loop cached clocks, refreshed once per epoll harvest so
+ * the hot paths (timer bookkeeping, Date header, log lines) do not
+ * read the clock per call. The monotonic time is the loop's notion of
+ * "now": a ribbon which runs for a long time between harvests sees a
+ * stale value, timeouts are relative to the last harvest.
+ */
+struct ribs_clock {
+    struct timespec monotonic; /* CLOCK_MONOTONIC */
+    struct timespec realtime;  /* CLOCK_REALTIME_COARSE */
+    time_t http_date_sec;
+    time_t log_prefix_sec;
+    char http_date[32];  /* Sun, 06 Nov 1994 08:49:37 GMT */
+    char log_prefix[32]; /* 1994-11-06 08:49:37, local time */
+};
+
+extern _RIBS_THREAD_LOCAL_ struct ribs_clock ribs_clock;
+
+void ribs_clock_update(void);
+/* cached CLOCK_MONOTONIC in milliseconds */
+_RIBS_INLINE_ uint64_t ribs_clock_msec(void);
+/* cached wall clock in seconds */
+_RIBS_INLINE_ time_t ribs_clock_time(void);
+/* RFC 7231 IMF-fixdate of the cached wall clock, rendered once per second */
+const char *ribs_clock_http_date(void);
+/* "%Y-%m-%d %H:%M:%S" local time of t, rendered once per second */
+const char *ribs_clock_log_prefix(time_t t);
+
+#include "../src/_ribs_clock.c"
+
+#endif // _RIBS_CLOCK__H_
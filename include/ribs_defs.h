@@ -34,6 +34,13 @@
 
 #define _RIBS_INLINE_ static inline
 
+/* per event loop state, threaded mode is only available on x86_64 */
+#ifdef __x86_64__
+#define _RIBS_THREAD_LOCAL_ __thread
+#else
+#define _RIBS_THREAD_LOCAL_
+#endif
+
 #define likely(x)     __builtin_expect((x),1)
 #define unlikely(x)   __builtin_expect((x),0)
 
@@ -0,0 +1,56 @@
+/*
+    This file is part of RIBS2.0 (Robust Infrastructure for Backend Systems).
+    RIBS is an infrastructure for building great SaaS applications (but not
+    limited to).
+
+    Copyright (C) 2015 TrueSkills, Inc.
+
+    RIBS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, version 2.1 of the License.
+
+    RIBS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with RIBS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _RIBS_OFFLOAD__H_
+#define _RIBS_OFFLOAD__H_
+
+#include "ribs_defs.h"
+#include <sys/types.h>
+
+struct ribs_context;
+
+/* blocking calls (file system, compression, etc.) are run by a pool
+   of threads while the calling ribbon is parked. Without a pool
+   (ribs_offload_init wasn't called) or outside of a ribbon, func is
+   called directly */
+int ribs_offload_init(int num_threads); /* link with -lpthread */
+/* returns func's result, errno is set to the value func left */
+long ribs_offload(long (*func)(void *arg), void *arg);
+
+/* offloaded versions of common blocking calls */
+int ribs_offload_ftruncate(int fd, off_t length);
+void *ribs_offload_mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset);
+char *ribs_offload_realpath(const char *path, char *resolved_path);
+
+/* used by the pool */
+struct ribs_offload_loop;
+struct ribs_offload_job {
+    long (*func)(void *arg);
+    void *arg;
+    long result;
+    int err;
+    volatile int done;
+    struct ribs_context *ctx;
+    struct ribs_offload_loop *loop;
+    struct ribs_offload_job *next;
+};
+extern void (*ribs_offload_submit)(struct ribs_offload_job *job);
+void ribs_offload_complete(struct ribs_offload_job *job);
+
+#endif // _RIBS_OFFLOAD__H_
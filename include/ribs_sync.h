@@ -0,0 +1,64 @@
+/*
+    This file is part of RIBS2.0 (Robust Infrastructure for Backend Systems).
+    RIBS is an infrastructure for building great SaaS applications (but not
+    limited to).
+
+    Copyright (C) 2015 TrueSkills, Inc.
+
+    RIBS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, version 2.1 of the License.
+
+    RIBS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with RIBS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _RIBS_SYNC__H_
+#define _RIBS_SYNC__H_
+
+#include "ribs_defs.h"
+#include "ribs_task.h"
+
+/*
+ * cooperative synchronization between ribbons of the same event
+ * loop. Waiters are queued in FIFO order and woken up via the run
+ * queue, ownership is handed over directly to the first waiter.
+ * timeout_ms < 0 waits forever, on timeout -1 is returned and errno
+ * is set to ETIMEDOUT (ECANCELED when the waiting task is cancelled)
+ */
+
+struct ribs_sem {
+    int count;
+    struct list waiters;
+};
+
+struct ribs_mutex {
+    struct ribs_context *owner;
+    struct list waiters;
+};
+
+struct ribs_cond {
+    struct list waiters;
+};
+
+void ribs_sem_init(struct ribs_sem *sem, int count);
+int ribs_sem_wait(struct ribs_sem *sem, int timeout_ms);
+int ribs_sem_trywait(struct ribs_sem *sem);
+void ribs_sem_post(struct ribs_sem *sem);
+
+void ribs_mutex_init(struct ribs_mutex *mutex);
+int ribs_mutex_lock(struct ribs_mutex *mutex, int timeout_ms);
+int ribs_mutex_trylock(struct ribs_mutex *mutex);
+int ribs_mutex_unlock(struct ribs_mutex *mutex);
+
+void ribs_cond_init(struct ribs_cond *cond);
+/* the mutex is locked again before returning, even on timeout */
+int ribs_cond_wait(struct ribs_cond *cond, struct ribs_mutex *mutex, int timeout_ms);
+void ribs_cond_signal(struct ribs_cond *cond);
+void ribs_cond_broadcast(struct ribs_cond *cond);
+
+#endif // _RIBS_SYNC__H_
@@ -0,0 +1,133 @@
+/*
+    This file is part of RIBS2.0 (Robust Infrastructure for Backend Systems).
+    RIBS is an infrastructure for building great SaaS applications (but not
+    limited to).
+
+    Copyright (C) 2015 TrueSkills, Inc.
+
+    RIBS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, version 2.1 of the License.
+
+    RIBS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with RIBS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _RIBS_TASK__H_
+#define _RIBS_TASK__H_
+
+#include "ribs_defs.h"
+#include "context.h"
+#include "ctx_pool.h"
+#include "list.h"
+#include "epoll_worker.h"
+#include "timer_wheel.h"
+
+/*
+ * structured concurrency: child ribbons (tasks) are spawned into a
+ * group, the parent waits for the group (or joins a single task),
+ * cancelling a group wakes up all of its tasks. Tasks are scheduled
+ * through the run queue, no syscalls involved
+ */
+
+#define RIBS_TASK_DEFAULT_STACK_SIZE (64 * 1024)
+
+struct ribs_group;
+
+struct ribs_task {
+    struct ribs_group *group;
+    int (*func)(void *arg);
+    void *arg;
+    int result;
+    int done;
+    struct ribs_context *ctx;
+    struct ribs_context *joiner;
+    struct list group_tasks;
+};
+
+struct ribs_group {
+    struct ctx_pool *ctx_pool;
+    struct list tasks; /* running */
+    int num_running;
+    int cancelled;
+    int cancel_on_error; /* cancel the siblings when a task fails */
+    int error; /* result of the first failed task */
+    struct ribs_context *waiter;
+};
+
+/* ctx_pool is NULL for the default (per event loop) pool, its
+   reserved size must fit a pointer */
+int ribs_group_init(struct ribs_group *group, struct ctx_pool *ctx_pool);
+/* the task struct is owned by the caller and must stay valid until the
+   task is done */
+int ribs_task_spawn(struct ribs_group *group, struct ribs_task *task, int (*func)(void *arg), void *arg);
+/* returns the task's result */
+int ribs_task_join(struct ribs_task *task);
+/* timeout_ms < 0 waits forever, returns -1 and sets errno to
+   ETIMEDOUT when the deadline is reached first (tasks keep running) */
+int ribs_group_wait(struct ribs_group *group, int timeout_ms);
+void ribs_group_cancel(struct ribs_group *group);
+/* the running task (NULL when not running in a task) */
+struct ribs_task *ribs_task_self(void);
+/* should be checked by long running tasks */
+int ribs_task_cancelled(void);
+
+/*
+ * bounded channel of pointers, senders block when full, receivers
+ * block when empty
+ */
+struct ribs_chan {
+    void **buf;
+    uint32_t size;
+    uint32_t head;
+    uint32_t count;
+    int closed;
+    struct list senders;
+    struct list receivers;
+};
+
+int ribs_chan_init(struct ribs_chan *chan, uint32_t size);
+void ribs_chan_free(struct ribs_chan *chan);
+/* -1 and errno: EPIPE (closed), ECANCELED (task cancelled) */
+int ribs_chan_send(struct ribs_chan *chan, void *item);
+/* -1 and errno: EPIPE (closed and empty), ECANCELED (task cancelled) */
+int ribs_chan_recv(struct ribs_chan *chan, void **item);
+/* -1 and EAGAIN instead of blocking */
+int ribs_chan_try_send(struct ribs_chan *chan, void *item);
+int ribs_chan_try_recv(struct ribs_chan *chan, void **item);
+/* wakes up all the blocked senders and receivers */
+void ribs_chan_close(struct ribs_chan *chan);
+
+/*
+ * wait lists, ribbons park on them and are woken up via the run queue
+ */
+struct ribs_waiter {
+    struct list list;
+    struct ribs_context *ctx;
+};
+
+_RIBS_INLINE_ void ribs_waiter_add(struct list *wait_list, struct ribs_waiter *waiter);
+_RIBS_INLINE_ int ribs_waiter_woken(struct ribs_waiter *waiter);
+_RIBS_INLINE_ void ribs_waiter_remove(struct ribs_waiter *waiter);
+_RIBS_INLINE_ int ribs_wait_list_wake_one(struct list *wait_list);
+_RIBS_INLINE_ void ribs_wait_list_wake_all(struct list *wait_list);
+
+/*
+ * deadlines, wake up the current ribbon when expired (timer wheel)
+ */
+struct ribs_deadline {
+    struct timer_wheel_entry timer;
+    int armed;
+};
+
+int ribs_deadline_arm(struct ribs_deadline *deadline, int timeout_ms);
+int ribs_deadline_expired(struct ribs_deadline *deadline);
+void ribs_deadline_disarm(struct ribs_deadline *deadline);
+
+#include "../src/_ribs_task.c"
+
+#endif // _RIBS_TASK__H_
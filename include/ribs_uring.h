@@ -0,0 +1,60 @@
+/*
+    This file is part of RIBS2.0 (Robust Infrastructure for Backend Systems).
+    RIBS is an infrastructure for building great SaaS applications (but not
+    limited to).
+
+    Copyright (C) 2015 TrueSkills, Inc.
+
+    RIBS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, version 2.1 of the License.
+
+    RIBS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with RIBS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _RIBS_URING__H_
+#define _RIBS_URING__H_
+
+#include "ribs_defs.h"
+#include <sys/uio.h>
+#include <time.h>
+
+/*
+ * io_uring backend for epoll_worker, see epoll_worker_set_backend().
+ * Each call submits one SQE on behalf of the current ribbon and
+ * yields until the completion arrives. Submissions are flushed in
+ * batches right before the event loop goes back to epoll_wait.
+ * Return values follow the corresponding syscalls (-1 and errno on
+ * failure).
+ */
+#define RIBS_URING_DEFAULT_ENTRIES 1024
+
+int ribs_uring_init(unsigned entries);
+int ribs_uring_submit(void);
+ssize_t ribs_uring_recv(int fd, void *buf, size_t len, int flags);
+ssize_t ribs_uring_send(int fd, const void *buf, size_t len, int flags);
+ssize_t ribs_uring_writev(int fd, const struct iovec *iov, int iovcnt);
+int ribs_uring_accept(int fd, struct sockaddr *addr, socklen_t *addrlen, int flags);
+int ribs_uring_poll(int fd, short events);
+ssize_t ribs_uring_splice(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out, size_t len, unsigned int flags);
+/* like sendfile(2): short count at end of file (0 when offset is at
+   the end), -1 and errno when nothing could be sent */
+ssize_t ribs_uring_sendfile(int out_fd, int in_fd, off_t *offset, size_t count);
+int ribs_uring_timeout(const struct timespec *ts);
+
+extern _RIBS_THREAD_LOCAL_ unsigned ribs_uring_num_pending;
+
+/*
+ * inline
+ */
+static inline void ribs_uring_flush(void) {
+    if (ribs_uring_num_pending)
+        ribs_uring_submit();
+}
+
+#endif // _RIBS_URING__H_
@@ -19,6 +19,8 @@
 */
 #ifndef _SLEEP__H_
 #define _SLEEP__H_
+/* the tfd argument is ignored (sleeping uses the event loop's timer
+   wheel) and ribs_sleep_init() always returns 0 */
 int ribs_sleep_init(void);
 int ribs_nanosleep(int tfd, const struct timespec *req, struct timespec *rem);
 unsigned int ribs_sleep(int tfd, unsigned int seconds);
@@ -22,17 +22,15 @@
 
 #include "ribs_defs.h"
 #include "context.h"
-#include "list.h"
 #include "epoll_worker.h"
-#include <sys/time.h>
-#include <sys/timerfd.h>
-#include <stdio.h>
 #include "logger.h"
 
+/*
+ * connection timeouts, each fd carries its own deadline on the event
+ * loop's timer wheel (see epoll_worker_set_timeout). kept as the place
+ * holding the default timeout
+ */
 struct timeout_handler {
-    int fd;
-    struct ribs_context *timeout_handler_ctx;
-    struct list timeout_chain;
     time_t timeout;
 };
 
@@ -40,7 +38,7 @@ int timeout_handler_init(struct timeout_handler *timeout_handler);
 _RIBS_INLINE_ void timeout_handler_add_fd_data(struct timeout_handler *timeout_handler, struct epoll_worker_fd_data *fd_data);
 
 #define TIMEOUT_HANDLER_REMOVE_FD_DATA(fd_data) \
-    list_remove(&(fd_data)->timeout_chain)
+    timer_wheel_cancel(&(fd_data)->timer)
 
 #include "../src/_timeout_handler.c"
 
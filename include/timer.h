@@ -22,8 +22,17 @@
 
 #include "ribs_defs.h"
 
+/*
+ * timers live on the event loop's timer wheel. They are identified by
+ * an id (not a file descriptor) which is passed to the handler. The
+ * handler runs in its own ribbon and may block
+ */
+/* periodic, returns 0 on success, -1 on error */
 int ribs_timer(time_t msec, void (*handler)(int));
+/* returns the timer id, -1 on error */
 int ribs_timer_create(void (*handler)(int));
-int ribs_timer_arm(int tfd, time_t msec);
+/* one shot, returns 0 on success, -1 on error */
+int ribs_timer_arm(int id, time_t msec);
+int ribs_timer_disarm(int id);
 
 #endif // _TIMER__H_
@@ -0,0 +1,60 @@
+/*
+    This file is part of RIBS2.0 (Robust Infrastructure for Backend Systems).
+    RIBS is an infrastructure for building great SaaS applications (but not
+    limited to).
+
+    Copyright (C) 2015 TrueSkills, Inc.
+
+    RIBS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, version 2.1 of the License.
+
+    RIBS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with RIBS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _TIMER_WHEEL__H_
+#define _TIMER_WHEEL__H_
+
+#include "ribs_defs.h"
+#include "list.h"
+
+/*
+ * Hierarchical timing wheel, one per event loop, driven by a single
+ * timerfd which is armed to the next expiration. 1ms ticks, 5 levels
+ * of 64 slots (~12 days) plus an overflow list. Adding and cancelling
+ * are O(1). Callbacks run in the wheel's own context and must not
+ * block, use them to wake up ribbons (timer_wheel_wakeup) or to do
+ * short non blocking work.
+ */
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 5
+
+struct timer_wheel_entry {
+    struct list list;
+    uint64_t expires; /* in ticks */
+    uint32_t slot;
+    void (*func)(void *arg);
+    void *arg;
+};
+
+#define TIMER_WHEEL_ENTRY_INITIALIZER { LIST_NULL_INITIALIZER, 0, 0, NULL, NULL }
+
+_RIBS_INLINE_ void timer_wheel_entry_init(struct timer_wheel_entry *entry, void (*func)(void *arg), void *arg);
+_RIBS_INLINE_ int timer_wheel_pending(struct timer_wheel_entry *entry);
+/* (re)schedule the entry msec from now */
+int timer_wheel_add(struct timer_wheel_entry *entry, uint64_t msec);
+void timer_wheel_cancel(struct timer_wheel_entry *entry);
+/* current time in ticks (CLOCK_MONOTONIC milliseconds) */
+uint64_t timer_wheel_now(void);
+/* callback which queues the ribbon passed as arg */
+void timer_wheel_wakeup(void *ctx);
+
+#include "../src/_timer_wheel.c"
+
+#endif // _TIMER_WHEEL__H_
@@ -31,6 +31,10 @@
 #define VMBUF_INITIALIZER { NULL, NULL, 0, 0, 0 }
 #define VMBUF_INIT(var) (var) = ((struct vmbuf)VMBUF_INITIALIZER)
 
+/* vmbuf_init_slab() */
+#define VMBUF_SLAB_MIN_SIZE 4096
+#define VMBUF_SLAB_MAX_SIZE (64*1024)
+
 struct vmbuf {
     void *mem;
     struct vmbuf_mem_funcs *funcs;
@@ -45,6 +49,10 @@ struct vmbuf_header {
 };
 
 int vmbuf_init(struct vmbuf *vmbuf, size_t initial_size);
+/* thread local mempool chunks, mmap once over VMBUF_SLAB_MAX_SIZE.
+   like vmbuf_init() it only resets an already initialized buffer.
+   must be freed by the thread which allocated it */
+int vmbuf_init_slab(struct vmbuf *vmbuf, size_t initial_size);
 int vmbuf_init_tmp(struct vmbuf *vmbuf, size_t initial_size);
 int vmbuf_init_shared(struct vmbuf *vmbuf, size_t initial_size);
 int vmbuf_init_shared_fixed(struct vmbuf *vmbuf, size_t max_size);
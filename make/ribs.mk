@@ -33,6 +33,10 @@ ifneq ($(wildcard /usr/include/zlib.h),)
 CPPFLAGS+=-DHAVE_ZLIB
 endif
 
+ifneq ($(wildcard /usr/include/linux/io_uring.h),)
+CPPFLAGS+=-DHAVE_IO_URING
+endif
+
 ifeq ($(RIBS2_SSL),1)
 CPPFLAGS+=-DRIBS2_SSL
 endif
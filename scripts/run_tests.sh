@@ -60,6 +60,24 @@ function test_http()
     run_tests http
 }
 
+function test_http_uring()
+{
+    echo -n "Staring httpd with io_uring backend... " >&2
+    examples/httpd/bin/httpd -d -p0 -u >/dev/null || die "httpd failed to start"
+    echo '[OK]' >&2
+    port=$(cat httpd.port)
+    run_tests http
+}
+
+function test_http_threads()
+{
+    echo -n "Staring httpd with 4 event loop threads and 2 offload threads... " >&2
+    examples/httpd/bin/httpd -d -p0 -t4 -o2 >/dev/null || die "httpd failed to start"
+    echo '[OK]' >&2
+    port=$(cat httpd.port)
+    run_tests http
+}
+
 function test_https()
 {
     echo -n "Creating server key and certificate... " >&2
@@ -81,6 +99,8 @@ echo -n "Creating random data data file... " >&2
 dd if=/dev/urandom of=random_data bs=1024 count=4048 2>/dev/null || die "couldn't"
 echo '[OK]' >&2
 test_http
+test_http_uring
+test_http_threads
 if [ -f /usr/include/openssl/ssl.h ]; then
     test_https
 fi
@@ -21,14 +21,19 @@
  * inline
  */
 _RIBS_INLINE_ struct ribs_context *ctx_pool_get(struct ctx_pool *cp) {
-   if (NULL == cp->freelist && 0 != ctx_pool_createstacks(cp, cp->grow_by, cp->stack_size, cp->reserved_size))
+   if (NULL == cp->freelist && 0 != ctx_pool_grow(cp))
       return NULL;
    struct ribs_context *ctx = cp->freelist;
    cp->freelist = ctx->next_free;
+   if (--cp->num_free < cp->min_free)
+      cp->min_free = cp->num_free;
    return ctx;
 }
 
 _RIBS_INLINE_ void ctx_pool_put(struct ctx_pool *cp, struct ribs_context *ctx) {
+   if (cp->profile_stacks)
+      ctx_pool_measure_stack(cp, ctx);
    ctx->next_free = cp->freelist;
    cp->freelist = ctx;
+   ++cp->num_free;
 }
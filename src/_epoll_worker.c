@@ -35,3 +35,28 @@ _RIBS_INLINE_ void epoll_worker_set_fd_ctx(int fd, struct ribs_context* ctx) {
 _RIBS_INLINE_ void epoll_worker_set_last_fd(int fd) {
     last_epollev.data.fd = fd;
 }
+
+_RIBS_INLINE_ int epoll_worker_arm_write(int fd) {
+    uint32_t events = epoll_worker_fd_map[fd].events;
+    return (events & EPOLLOUT) ? 0 : ribs_epoll_mod(fd, events | EPOLLOUT);
+}
+
+_RIBS_INLINE_ int epoll_worker_disarm_write(int fd) {
+    uint32_t events = epoll_worker_fd_map[fd].events;
+    return (events & EPOLLOUT) ? ribs_epoll_mod(fd, events & ~EPOLLOUT) : 0;
+}
+
+_RIBS_INLINE_ int epoll_worker_set_timeout(int fd, time_t msec) {
+    struct epoll_worker_fd_data *fd_data = epoll_worker_fd_map + fd;
+    if (!timer_wheel_pending(&fd_data->timer))
+        timer_wheel_entry_init(&fd_data->timer, epoll_worker_timeout_expired, fd_data);
+    return timer_wheel_add(&fd_data->timer, msec);
+}
+
+_RIBS_INLINE_ void epoll_worker_clear_timeout(int fd) {
+    timer_wheel_cancel(&epoll_worker_fd_map[fd].timer);
+}
+
+_RIBS_INLINE_ int epoll_worker_timeout_pending(int fd) {
+    return timer_wheel_pending(&epoll_worker_fd_map[fd].timer);
+}
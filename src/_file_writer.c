@@ -36,7 +36,7 @@ _RIBS_INLINE_ int file_writer_attachfd(struct file_writer *fw, int fd, size_t in
     if (0 > fw->fd)
         return perror("open, file_writer_attachfd"), -1;
 
-    if (0 > ftruncate(fw->fd, fw->buffer_size))
+    if (0 > ribs_offload_ftruncate(fw->fd, fw->buffer_size))
         return perror("ftruncate, file_writer_init"), -1;
 
     fw->mem = mmap(NULL, fw->buffer_size, PROT_READ | PROT_WRITE, MAP_SHARED, fw->fd, 0);
@@ -72,7 +72,7 @@ _RIBS_INLINE_ int file_writer_wseek(struct file_writer *fw, size_t n) {
         fw->next_loc = fw->base_loc + fw->buffer_size;
         if (fw->write_loc == fw->capacity) { /* can be false if used lseek */
             fw->capacity += fw->buffer_size;
-            if (0 > ftruncate(fw->fd, fw->capacity))
+            if (0 > ribs_offload_ftruncate(fw->fd, fw->capacity))
                 return perror("ftruncate, file_writer_wseek"), -1;
         }
         fw->mem = mmap(fw->mem, fw->buffer_size, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_SHARED, fw->fd, fw->base_loc);
@@ -96,7 +96,7 @@ _RIBS_INLINE_ int file_writer_lseek(struct file_writer *fw, off_t offset, int wh
 
     if (fw->write_loc > fw->capacity) {
         fw->capacity = (fw->write_loc + fw->buffer_size - 1) & ~(fw->buffer_size - 1);
-        if (0 > ftruncate(fw->fd, fw->capacity))
+        if (0 > ribs_offload_ftruncate(fw->fd, fw->capacity))
             return perror("ftruncate, file_writer_wseek"), -1;
     }
     fw->base_loc = fw->write_loc & ~(fw->buffer_size - 1);
@@ -130,7 +130,7 @@ _RIBS_INLINE_ int file_writer_close(struct file_writer *fw) {
         return 0;
     if (0 > munmap(fw->mem, fw->buffer_size))
         perror("munmap, file_writer_close");
-    if (0 > ftruncate(fw->fd, fw->write_loc))
+    if (0 > ribs_offload_ftruncate(fw->fd, fw->write_loc))
         perror("ftruncate, file_writer_close"), res = -1;
     close(fw->fd);
     fw->fd = -1;
@@ -56,11 +56,14 @@ _RIBS_INLINE_ int http_client_send_request(struct http_client_context *cctx) {
         }
     }
 #endif
+    /* incomplete (connect in progress or full socket buffer), the
+       fiber is started by EPOLLOUT and finishes the write */
+    if (0 == res && 0 > epoll_worker_arm_write(fd))
+        res = -1;
     if (res < 0) {
         LOGGER_PERROR("write request %s:%hu", inet_ntoa(cctx->key.addr), cctx->key.port);
         cctx->http_status_code = 500;
         cctx->persistent = 0;
-        TIMEOUT_HANDLER_REMOVE_FD_DATA(epoll_worker_fd_map + fd);
         ribs_close(fd);
     }
     return res;
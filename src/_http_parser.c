@@ -0,0 +1,33 @@
+/*
+    This file is part of RIBS2.0 (Robust Infrastructure for Backend Systems).
+    RIBS is an infrastructure for building great SaaS applications (but not
+    limited to).
+
+    Copyright (C) 2015 TrueSkills, Inc.
+
+    RIBS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, version 2.1 of the License.
+
+    RIBS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with RIBS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * inline
+ */
+_RIBS_INLINE_ int http_parser_keep_alive(const struct http_parser *parser) {
+    if (parser->flags & HTTP_PARSER_CONNECTION_CLOSE)
+        return 0;
+    if (parser->version_minor > 0)
+        return 1;
+    return (parser->flags & HTTP_PARSER_KEEP_ALIVE) ? 1 : 0;
+}
+
+_RIBS_INLINE_ int http_body_decoder_done(const struct http_body_decoder *decoder) {
+    return HTTP_BODY_DONE == decoder->state;
+}
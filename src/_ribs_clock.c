@@ -0,0 +1,34 @@
+/*
+    This file is part of RIBS2.0 (Robust Infrastructure for Backend Systems).
+    RIBS is an infrastructure for building great SaaS applications (but not
+    limited to).
+
+    Copyright (C) 2015 TrueSkills, Inc.
+
+    RIBS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, version 2.1 of the License.
+
+    RIBS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with RIBS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * inline
+ */
+_RIBS_INLINE_ uint64_t ribs_clock_msec(void) {
+    /* not harvested yet on this thread */
+    if (0 == ribs_clock.monotonic.tv_sec && 0 == ribs_clock.monotonic.tv_nsec)
+        ribs_clock_update();
+    return (uint64_t)ribs_clock.monotonic.tv_sec * 1000 + ribs_clock.monotonic.tv_nsec / 1000000;
+}
+
+_RIBS_INLINE_ time_t ribs_clock_time(void) {
+    if (0 == ribs_clock.realtime.tv_sec)
+        ribs_clock_update();
+    return ribs_clock.realtime.tv_sec;
+}
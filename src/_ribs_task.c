@@ -0,0 +1,50 @@
+/*
+    This file is part of RIBS2.0 (Robust Infrastructure for Backend Systems).
+    RIBS is an infrastructure for building great SaaS applications (but not
+    limited to).
+
+    Copyright (C) 2015 TrueSkills, Inc.
+
+    RIBS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, version 2.1 of the License.
+
+    RIBS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with RIBS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * inline
+ */
+_RIBS_INLINE_ void ribs_waiter_add(struct list *wait_list, struct ribs_waiter *waiter) {
+    waiter->ctx = current_ctx;
+    list_insert_tail(wait_list, &waiter->list);
+}
+
+_RIBS_INLINE_ int ribs_waiter_woken(struct ribs_waiter *waiter) {
+    return list_is_null(&waiter->list);
+}
+
+_RIBS_INLINE_ void ribs_waiter_remove(struct ribs_waiter *waiter) {
+    if (list_is_null(&waiter->list))
+        return;
+    list_remove(&waiter->list);
+    list_set_null(&waiter->list);
+}
+
+_RIBS_INLINE_ int ribs_wait_list_wake_one(struct list *wait_list) {
+    if (list_empty(wait_list))
+        return 0;
+    struct list *e = list_pop_head(wait_list);
+    list_set_null(e);
+    epoll_worker_queue_ctx(LIST_ENTRY(e, struct ribs_waiter, list)->ctx);
+    return 1;
+}
+
+_RIBS_INLINE_ void ribs_wait_list_wake_all(struct list *wait_list) {
+    while (ribs_wait_list_wake_one(wait_list));
+}
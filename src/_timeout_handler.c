@@ -21,11 +21,7 @@
  * inline
  */
 _RIBS_INLINE_ void timeout_handler_add_fd_data(struct timeout_handler *timeout_handler, struct epoll_worker_fd_data *fd_data) {
-    gettimeofday(&fd_data->timestamp, NULL);
-    if (list_empty(&timeout_handler->timeout_chain)) {
-        struct itimerspec when = {{0,0},{timeout_handler->timeout/1000,(timeout_handler->timeout%1000)*1000000L}};
-        if (0 > timerfd_settime(timeout_handler->fd, 0, &when, NULL))
-            LOGGER_PERROR("timerfd_settime"), abort();
-    }
-    list_insert_tail(&timeout_handler->timeout_chain, &fd_data->timeout_chain);
+    /* can't arm the deadline, expire it right away */
+    if (0 > epoll_worker_set_timeout(fd_data - epoll_worker_fd_map, timeout_handler->timeout))
+        LOGGER_ERROR("failed to arm the connection timeout"), epoll_worker_timeout_expired(fd_data);
 }
@@ -0,0 +1,31 @@
+/*
+    This file is part of RIBS2.0 (Robust Infrastructure for Backend Systems).
+    RIBS is an infrastructure for building great SaaS applications (but not
+    limited to).
+
+    Copyright (C) 2015 TrueSkills, Inc.
+
+    RIBS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, version 2.1 of the License.
+
+    RIBS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with RIBS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * inline
+ */
+_RIBS_INLINE_ void timer_wheel_entry_init(struct timer_wheel_entry *entry, void (*func)(void *arg), void *arg) {
+    list_set_null(&entry->list);
+    entry->func = func;
+    entry->arg = arg;
+}
+
+_RIBS_INLINE_ int timer_wheel_pending(struct timer_wheel_entry *entry) {
+    return !list_is_null(&entry->list);
+}
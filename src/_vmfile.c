@@ -18,7 +18,7 @@
     along with RIBS.  If not, see <http://www.gnu.org/licenses/>.
 */
 #define VMFILE_FTRUNCATE(size,funcname)                                 \
-    if (0 > ftruncate(vmb->fd, (size)))                                 \
+    if (0 > ribs_offload_ftruncate(vmb->fd, (size)))                \
         return perror("ftruncate, " STRINGIFY(VMBUF_T) "_" funcname), -1;
 
 _RIBS_INLINE_ int TEMPLATE(VMBUF_T,attachfd)(struct VMBUF_T *vmb, int fd, size_t initial_size) {
@@ -27,7 +27,7 @@ _RIBS_INLINE_ int TEMPLATE(VMBUF_T,attachfd)(struct VMBUF_T *vmb, int fd, size_t
     vmb->fd = fd;
     initial_size = RIBS_VM_ALIGN(initial_size);
     VMFILE_FTRUNCATE(initial_size, "attachfd");
-    vmb->buf = (char *)mmap(NULL, initial_size, PROT_WRITE | PROT_READ, MAP_SHARED, vmb->fd, 0);
+    vmb->buf = (char *)ribs_offload_mmap(NULL, initial_size, PROT_WRITE | PROT_READ, MAP_SHARED, vmb->fd, 0);
     if (MAP_FAILED == vmb->buf) {
         perror("mmap, " STRINGIFY(VMBUF_T) "_attachfd");
         vmb->buf = NULL;
@@ -47,6 +47,7 @@ void ribs_makecontext(struct ribs_context *ctx, struct ribs_context *pctx, void
 
     ctx->stack_pointer_reg = (uintptr_t) sp;
     ctx->parent_context_reg = (uintptr_t) pctx;
+    ctx->entry_func = func;
 }
 
 struct ribs_context *ribs_context_create(size_t stack_size, size_t reserved_size, void (*func)(void)) {
@@ -20,7 +20,12 @@
 #include "ctx_pool.h"
 #include <sys/mman.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
 #include "logger.h"
+#include "ilog2.h"
+#include "vm_misc.h"
 
 /*
   when defined, it will increase dramatically the number of maps
@@ -28,6 +33,8 @@
 */
 /* #define STACK_PROTECTION */
 
+#define STACK_CANARY 0xDEADBEEFCAFEF00DULL
+
 int ctx_pool_init(struct ctx_pool *cp, size_t initial_size, size_t grow_by, size_t stack_size, size_t reserved_size) {
     stack_size += 4095ULL;
     stack_size &= ~4095ULL;
@@ -35,17 +42,78 @@ int ctx_pool_init(struct ctx_pool *cp, size_t initial_size, size_t grow_by, size
     cp->stack_size = stack_size;
     cp->reserved_size = reserved_size;
     cp->freelist = NULL;
+    cp->chunks = NULL;
+    cp->num_stacks = 0;
+    cp->min_stacks = initial_size;
+    cp->num_free = 0;
+    cp->min_free = 0;
+    cp->mapped_bytes = 0;
+    cp->reclaimed_bytes = 0;
+    cp->trim_advice = MADV_DONTNEED;
+    cp->profile_stacks = 0;
+    cp->apply_profile = 0;
+    cp->num_samples = 0;
+    cp->max_stack_usage = 0;
+    memset(cp->stack_usage, 0, sizeof(cp->stack_usage));
     return ctx_pool_createstacks(cp, initial_size, stack_size, reserved_size);
 }
 
+static inline char *stack_bottom(struct ctx_pool_chunk *chunk, size_t idx) {
+    char *bottom = (char *)chunk->mem + idx * chunk->stack_size;
+#ifdef STACK_PROTECTION
+    bottom += 4096;
+#endif
+    return bottom;
+}
+
+static inline char *stack_top_page(struct ribs_context *ctx) {
+    /* the page holding the context (and reserved) is always in use */
+    return (char *)((uintptr_t)ctx & ~(RIBS_VM_PAGEMASK));
+}
+
+static inline size_t stack_index(struct ribs_context *ctx) {
+    struct ctx_pool_chunk *chunk = ctx->pool_chunk;
+    return ((char *)ctx - (char *)chunk->mem) / chunk->stack_size;
+}
+
+static void paint_stack(struct ctx_pool_chunk *chunk, size_t idx, struct ribs_context *ctx) {
+    uint64_t *p = (uint64_t *)stack_bottom(chunk, idx), *end = (uint64_t *)stack_top_page(ctx);
+    for (; p < end; ++p)
+        *p = STACK_CANARY;
+    chunk->stacks[idx].used_pages = 1;
+    chunk->stacks[idx].reclaimed = 0;
+}
+
+static inline int page_is_painted(const char *page) {
+    const uint64_t *p = (const uint64_t *)page, *end = (const uint64_t *)(page + RIBS_VM_PAGESIZE);
+    for (; p < end; ++p)
+        if (STACK_CANARY != *p)
+            return 0;
+    return 1;
+}
+
 int ctx_pool_createstacks(struct ctx_pool *cp, size_t num_stacks, size_t stack_size, size_t reserved_size) {
     LOGGER_INFO("ctx_pool: allocating %zu stacks, size = %zu", num_stacks, stack_size);
 #ifdef STACK_PROTECTION
    stack_size += 4096; // one more page as stack guard page
 #endif
+    struct ctx_pool_chunk *chunk = calloc(1, sizeof(struct ctx_pool_chunk));
+    if (NULL == chunk)
+        return LOGGER_PERROR("calloc, ctx_pool_init"), -1;
+    chunk->stacks = calloc(num_stacks ? num_stacks : 1, sizeof(struct ctx_pool_stack_info));
+    if (NULL == chunk->stacks)
+        return free(chunk), LOGGER_PERROR("calloc, ctx_pool_init"), -1;
     void *mem = mmap(NULL, num_stacks * stack_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
     if (MAP_FAILED == mem)
-        return LOGGER_PERROR("mmap, ctx_pool_init"), -1;
+        return free(chunk->stacks), free(chunk), LOGGER_PERROR("mmap, ctx_pool_init"), -1;
+    chunk->mem = mem;
+    chunk->stack_size = stack_size;
+    chunk->num_stacks = num_stacks;
+    chunk->next = cp->chunks;
+    cp->chunks = chunk;
+    cp->num_stacks += num_stacks;
+    cp->num_free += num_stacks;
+    cp->mapped_bytes += num_stacks * stack_size;
     size_t rc_ofs = stack_size - sizeof(struct ribs_context) - reserved_size;
     size_t i;
     for (i = 0; i < num_stacks; ++i, mem += stack_size) {
@@ -54,8 +122,158 @@ int ctx_pool_createstacks(struct ctx_pool *cp, size_t num_stacks, size_t stack_s
             return LOGGER_PERROR("mmap, ctx_pool_init, PROT_NONE"), -1;
 #endif
         struct ribs_context *rc = (struct ribs_context *)(mem + rc_ofs);
+        rc->pool_chunk = chunk;
+        if (cp->profile_stacks)
+            paint_stack(chunk, i, rc);
         rc->next_free = cp->freelist;
         cp->freelist = rc;
     }
     return 0;
 }
+
+int ctx_pool_grow(struct ctx_pool *cp) {
+    if (cp->apply_profile) {
+        size_t stack_size = ctx_pool_suggested_stack_size(cp);
+        if (stack_size < cp->stack_size) {
+            LOGGER_INFO("ctx_pool: max stack usage is %zu, reducing stack size from %zu to %zu", cp->max_stack_usage, cp->stack_size, stack_size);
+            cp->stack_size = stack_size;
+        }
+    }
+    return ctx_pool_createstacks(cp, cp->grow_by, cp->stack_size, cp->reserved_size);
+}
+
+void ctx_pool_profile_stacks(struct ctx_pool *cp, int apply) {
+    cp->profile_stacks = 1;
+    cp->apply_profile = apply;
+    /* stacks in use are painted (and measured) only after being recycled */
+    struct ribs_context *ctx;
+    for (ctx = cp->freelist; ctx; ctx = ctx->next_free) {
+        struct ctx_pool_chunk *chunk = ctx->pool_chunk;
+        size_t idx = stack_index(ctx);
+        if (0 == chunk->stacks[idx].used_pages)
+            paint_stack(chunk, idx, ctx);
+    }
+}
+
+void ctx_pool_measure_stack(struct ctx_pool *cp, struct ribs_context *ctx) {
+    struct ctx_pool_chunk *chunk = ctx->pool_chunk;
+    size_t idx = stack_index(ctx);
+    uint32_t n = chunk->stacks[idx].used_pages;
+    if (0 == n)
+        return; /* was in use when profiling started */
+    char *bottom = stack_bottom(chunk, idx);
+    char *top = stack_top_page(ctx);
+    /* everything above the previous mark is known to be dirty */
+    char *page = top - (size_t)n * RIBS_VM_PAGESIZE;
+    for (; page >= bottom && !page_is_painted(page); page -= RIBS_VM_PAGESIZE)
+        ++n;
+    chunk->stacks[idx].used_pages = n;
+    size_t usage = (size_t)((char *)ctx - top) + (size_t)(n - 1) * RIBS_VM_PAGESIZE;
+    uint32_t bucket = usage ? ilog2_64(usage) : 0;
+    if (bucket >= CTX_POOL_STACK_USAGE_BUCKETS)
+        bucket = CTX_POOL_STACK_USAGE_BUCKETS - 1;
+    ++cp->stack_usage[bucket];
+    ++cp->num_samples;
+    if (usage > cp->max_stack_usage)
+        cp->max_stack_usage = usage;
+}
+
+size_t ctx_pool_suggested_stack_size(struct ctx_pool *cp) {
+    if (cp->num_samples < CTX_POOL_PROFILE_MIN_SAMPLES)
+        return cp->stack_size;
+    /* leave at least as much headroom as the deepest stack seen so far */
+    size_t stack_size = next_p2_64(2 * cp->max_stack_usage + 1) + sizeof(struct ribs_context) + cp->reserved_size;
+    stack_size = RIBS_VM_ALIGN(stack_size);
+    return stack_size < cp->stack_size ? stack_size : cp->stack_size;
+}
+
+void ctx_pool_dump_stack_usage(struct ctx_pool *cp) {
+    int i;
+    const char HEADER[] = "=== stack usage ===";
+    LOGGER_INFO("%*s", (int)(50 + sizeof(HEADER))/2, HEADER);
+    LOGGER_INFO("stack size: %zu, max usage: %zu, samples: %" PRIu64 ", suggested: %zu",
+                cp->stack_size, cp->max_stack_usage, cp->num_samples, ctx_pool_suggested_stack_size(cp));
+    LOGGER_INFO("%15s   %15s", "bytes", "stacks");
+    for (i = 0; i < CTX_POOL_STACK_USAGE_BUCKETS; ++i) {
+        if (0 < cp->stack_usage[i])
+            LOGGER_INFO("%15llu   %15" PRIu64, 1ULL << i, cp->stack_usage[i]);
+    }
+}
+
+size_t ctx_pool_trim(struct ctx_pool *cp) {
+    /* the bottom min_free stacks were not used since the last call */
+    size_t num_busy = cp->num_free - cp->min_free;
+    cp->min_free = cp->num_free;
+    if (cp->profile_stacks)
+        return 0; /* would destroy the canary */
+    struct ctx_pool_chunk *chunk;
+    for (chunk = cp->chunks; chunk; chunk = chunk->next)
+        chunk->num_idle = 0;
+    struct ribs_context *ctx;
+    size_t i = 0;
+    for (ctx = cp->freelist; ctx; ctx = ctx->next_free, ++i) {
+        if (i >= num_busy)
+            ++ctx->pool_chunk->num_idle;
+    }
+    /* pick the chunks to unmap, keep at least min_stacks */
+    size_t num_stacks = cp->num_stacks;
+    for (chunk = cp->chunks; chunk; chunk = chunk->next) {
+        if (chunk->num_idle == chunk->num_stacks && num_stacks - chunk->num_stacks >= cp->min_stacks)
+            num_stacks -= chunk->num_stacks;
+        else
+            chunk->num_idle = 0; /* keep */
+    }
+    size_t reclaimed = 0, reclaimed_total = 0;
+    struct ribs_context **ctx_ref = &cp->freelist;
+    for (i = 0; (ctx = *ctx_ref); ++i) {
+        chunk = ctx->pool_chunk;
+        if (0 < chunk->num_idle) {
+            *ctx_ref = ctx->next_free; /* chunk is about to be unmapped */
+            continue;
+        }
+        ctx_ref = &ctx->next_free;
+        size_t idx = stack_index(ctx);
+        struct ctx_pool_stack_info *info = chunk->stacks + idx;
+        if (i < num_busy) {
+            info->reclaimed = 0;
+            continue;
+        }
+        char *bottom = stack_bottom(chunk, idx);
+        size_t len = stack_top_page(ctx) - bottom;
+        if (!info->reclaimed) {
+            if (0 > madvise(bottom, len, cp->trim_advice))
+                LOGGER_PERROR("madvise, ctx_pool_trim");
+            info->reclaimed = 1;
+            reclaimed += len;
+        }
+        reclaimed_total += len;
+    }
+    struct ctx_pool_chunk **chunk_ref = &cp->chunks;
+    while ((chunk = *chunk_ref)) {
+        if (0 == chunk->num_idle) {
+            chunk_ref = &chunk->next;
+            continue;
+        }
+        *chunk_ref = chunk->next;
+        size_t size = chunk->num_stacks * chunk->stack_size;
+        LOGGER_INFO("ctx_pool: releasing %zu idle stacks, size = %zu", chunk->num_stacks, chunk->stack_size);
+        if (0 > munmap(chunk->mem, size))
+            LOGGER_PERROR("munmap, ctx_pool_trim");
+        cp->num_stacks -= chunk->num_stacks;
+        cp->num_free -= chunk->num_stacks;
+        cp->mapped_bytes -= size;
+        reclaimed += size;
+        free(chunk->stacks);
+        free(chunk);
+    }
+    cp->min_free = cp->num_free;
+    cp->reclaimed_bytes = reclaimed_total;
+    return reclaimed;
+}
+
+void ctx_pool_dump_stats(struct ctx_pool *cp) {
+    const char HEADER[] = "=== ctx pool stats ===";
+    LOGGER_INFO("%*s", (int)(50 + sizeof(HEADER))/2, HEADER);
+    LOGGER_INFO("%15s   %15s   %15s   %15s", "stacks", "in use", "mapped bytes", "reclaimed bytes");
+    LOGGER_INFO("%15zu   %15zu   %15zu   %15zu", cp->num_stacks, cp->num_stacks - cp->num_free, cp->mapped_bytes, cp->reclaimed_bytes);
+}
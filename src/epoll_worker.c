@@ -21,23 +21,47 @@
 #include <sys/epoll.h>
 #include <stdio.h>
 #include <sys/time.h>
+#include <time.h>
 #include <sys/resource.h>
 #include <stdlib.h>
 #include <signal.h>
 #include <sys/signalfd.h>
+#include <sys/socket.h>
 #include "logger.h"
-#include <fcntl.h>
+#include "ilog2.h"
+#include "epoll_worker_health.h"
+#include "ribs_uring.h"
+#include "ribs_clock.h"
 #include <errno.h>
+#include <inttypes.h>
 
-static int ribs_epoll_fd = -1;
-struct epoll_event last_epollev;
-struct epoll_worker_fd_data *epoll_worker_fd_map;
+/* config, shared by all the event loops */
+static int ready_events_max = EPOLL_WORKER_DEFAULT_MAX_EVENTS;
+static int run_queue_budget = EPOLL_WORKER_DEFAULT_RUN_QUEUE_BUDGET;
+static int epoll_worker_backend = EPOLL_WORKER_BACKEND_EPOLL;
+static unsigned busy_poll_usec = 0;
+
+/* per event loop (thread) state */
+static _RIBS_THREAD_LOCAL_ int ribs_epoll_fd = -1;
+_RIBS_THREAD_LOCAL_ struct epoll_event last_epollev;
+
+/* events harvested by the last epoll_wait, dispatched one per yield() */
+static _RIBS_THREAD_LOCAL_ struct epoll_event *ready_events = NULL;
+static _RIBS_THREAD_LOCAL_ int ready_events_num = 0;
+static _RIBS_THREAD_LOCAL_ int ready_events_cur = 0;
+static _RIBS_THREAD_LOCAL_ struct epoll_worker_stats epoll_worker_stats;
+static _RIBS_THREAD_LOCAL_ int active_backend = EPOLL_WORKER_BACKEND_EPOLL;
+_RIBS_THREAD_LOCAL_ struct epoll_worker_fd_data *epoll_worker_fd_map;
 
 static struct ribs_context main_ctx = { .memalloc = MEMALLOC_INITIALIZER };
-struct ribs_context *current_ctx = &main_ctx;
-struct ribs_context *event_loop_ctx;
+static _RIBS_THREAD_LOCAL_ struct ribs_context *thread_main_ctx = &main_ctx;
+_RIBS_THREAD_LOCAL_ struct ribs_context *current_ctx = &main_ctx;
+_RIBS_THREAD_LOCAL_ struct ribs_context *event_loop_ctx;
 
-static int queue_ctx_fd = -1;
+/* FIFO of runnable ribbons, drained by yield() between epoll harvests */
+static _RIBS_THREAD_LOCAL_ struct ribs_context *run_queue_head = NULL;
+static _RIBS_THREAD_LOCAL_ struct ribs_context *run_queue_tail = NULL;
+static _RIBS_THREAD_LOCAL_ int run_queue_streak = 0;
 
 #ifdef UGLY_GETADDRINFO_WORKAROUND
 static void sigrtmin_to_context(void) {
@@ -53,22 +77,20 @@ static void sigrtmin_to_context(void) {
 }
 #endif
 
-static void pipe_to_context(void) {
-    void *ctx;
-    for (;;) {
-        if (sizeof(ctx) != read(last_epollev.data.fd, &ctx, sizeof(ctx))) {
-            LOGGER_PERROR("read in pipe_to_context");
-            yield();
-        } else
-            ribs_swapcurcontext(ctx);
-    }
-}
-
 int ribs_epoll_add(int fd, uint32_t events, struct ribs_context* ctx) {
     struct epoll_event ev = { .events = events, .data.fd = fd };
     if (0 > epoll_ctl(ribs_epoll_fd, EPOLL_CTL_ADD, fd, &ev))
         return LOGGER_PERROR("epoll_ctl"), -1;
     epoll_worker_set_fd_ctx(fd, ctx);
+    epoll_worker_fd_map[fd].events = events;
+    return 0;
+}
+
+int ribs_epoll_mod(int fd, uint32_t events) {
+    struct epoll_event ev = { .events = events, .data.fd = fd };
+    if (0 > epoll_ctl(ribs_epoll_fd, EPOLL_CTL_MOD, fd, &ev))
+        return LOGGER_PERROR("epoll_ctl"), -1;
+    epoll_worker_fd_map[fd].events = events;
     return 0;
 }
 
@@ -81,13 +103,94 @@ struct ribs_context* small_ctx_for_fd(int fd, size_t reserved_size, void (*func)
     return ctx;
 }
 
+static inline uint64_t _monotonic_usec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int _epoll_worker_busy_poll(void) {
+    uint64_t start = _monotonic_usec();
+    do {
+        int n = epoll_wait(ribs_epoll_fd, ready_events, ready_events_max, 0);
+        if (0 < n)
+            return ++epoll_worker_stats.busy_poll_hits, n;
+    } while (_monotonic_usec() - start < busy_poll_usec);
+    ++epoll_worker_stats.busy_poll_misses;
+    return 0;
+}
+
+static inline int _epoll_worker_harvest(int timeout) {
+    int n;
+    ribs_uring_flush();
+    if (epoll_worker_health_enabled)
+        epoll_worker_health_on_wait();
+    if (0 > timeout && 0 < busy_poll_usec)
+        n = _epoll_worker_busy_poll();
+    else
+        n = 0;
+    while (0 >= n) {
+        n = epoll_wait(ribs_epoll_fd, ready_events, ready_events_max, timeout);
+        if (0 <= timeout)
+            break;
+    }
+    ribs_clock_update();
+    if (epoll_worker_health_enabled)
+        epoll_worker_health_on_wakeup(n);
+    run_queue_streak = 0;
+    if (0 >= n)
+        return 0;
+    ready_events_num = n;
+    ready_events_cur = 0;
+    ++epoll_worker_stats.num_wakeups;
+    epoll_worker_stats.num_events += n;
+    ++epoll_worker_stats.events_per_wakeup[ilog2(n)];
+    return n;
+}
+
 static void event_loop(void) {
     for (;;yield());
 }
 
+int epoll_worker_set_max_events(int max_events) {
+    if (0 <= ribs_epoll_fd)
+        return LOGGER_ERROR("max events must be set before epoll_worker_init"), -1;
+    if (0 >= max_events || (1 << EPOLL_WORKER_STATS_NUM_BUCKETS) <= max_events)
+        return LOGGER_ERROR("invalid max events: %d", max_events), -1;
+    ready_events_max = max_events;
+    return 0;
+}
+
+int epoll_worker_set_run_queue_budget(int budget) {
+    if (0 >= budget)
+        return LOGGER_ERROR("invalid run queue budget: %d", budget), -1;
+    run_queue_budget = budget;
+    return 0;
+}
+
+int epoll_worker_set_backend(int backend) {
+    if (0 <= ribs_epoll_fd)
+        return LOGGER_ERROR("backend must be set before epoll_worker_init"), -1;
+    if (EPOLL_WORKER_BACKEND_EPOLL != backend && EPOLL_WORKER_BACKEND_URING != backend)
+        return LOGGER_ERROR("invalid backend: %d", backend), -1;
+    epoll_worker_backend = backend;
+    return 0;
+}
+
+int epoll_worker_set_busy_poll(unsigned usec) {
+    busy_poll_usec = usec;
+    return 0;
+}
+
+int epoll_worker_get_backend(void) {
+    return active_backend;
+}
+
 int epoll_worker_init(void) {
     if (0 <= ribs_epoll_fd)
         return 0;
+    /* epoll_worker_exit() returns here */
+    thread_main_ctx = current_ctx;
 #ifdef RIBS2_SSL
     ribs_ssl_init();
 #endif
@@ -97,6 +200,10 @@ int epoll_worker_init(void) {
         return LOGGER_PERROR("getrlimit(RLIMIT_NOFILE)"), -1;
     epoll_worker_fd_map = calloc(rlim.rlim_cur, sizeof(struct epoll_worker_fd_data));
 
+    ready_events = calloc(ready_events_max, sizeof(struct epoll_event));
+    if (NULL == ready_events)
+        return LOGGER_PERROR("calloc ready events"), -1;
+
     ribs_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
     if (0 > ribs_epoll_fd)
         return LOGGER_PERROR("epoll_create1"), -1;
@@ -124,14 +231,13 @@ int epoll_worker_init(void) {
 
     event_loop_ctx = ribs_context_create(SMALL_STACK_SIZE, 0, event_loop);
 
-    /* pipe to context */
-    int pipefd[2];
-    if (0 > pipe2(pipefd, O_NONBLOCK))
-        return LOGGER_PERROR("pipe"), -1;
-    if (NULL == small_ctx_for_fd(pipefd[0], 0, pipe_to_context))
-        return -1;
-    queue_ctx_fd = pipefd[1];
-    return ribs_epoll_add(queue_ctx_fd, EPOLLOUT | EPOLLET, event_loop_ctx);
+    active_backend = epoll_worker_backend;
+    if (EPOLL_WORKER_BACKEND_URING == active_backend &&
+        0 > ribs_uring_init(RIBS_URING_DEFAULT_ENTRIES)) {
+        LOGGER_ERROR("io_uring is not available, falling back to epoll");
+        active_backend = EPOLL_WORKER_BACKEND_EPOLL;
+    }
+    return 0;
 }
 
 void epoll_worker_loop(void) {
@@ -139,48 +245,117 @@ void epoll_worker_loop(void) {
 }
 
 void epoll_worker_exit(void) {
-    ribs_swapcurcontext(&main_ctx);
+    ribs_swapcurcontext(thread_main_ctx);
 }
 
 inline void yield(void) {
-    while(0 >= epoll_wait(ribs_epoll_fd, &last_epollev, 1, -1));
-    ribs_swapcurcontext(epoll_worker_fd_map[last_epollev.data.fd].ctx);
+    if (epoll_worker_health_enabled)
+        epoll_worker_health_on_switch();
+    for (;;) {
+        if (ready_events_cur < ready_events_num) {
+            last_epollev = ready_events[ready_events_cur++];
+            if (0 > last_epollev.data.fd)
+                continue; /* closed after being harvested */
+            ribs_swapcurcontext(epoll_worker_fd_map[last_epollev.data.fd].ctx);
+            return;
+        }
+        /* all harvested events were dispatched, run the queued
+           ribbons, up to the budget before checking for I/O again */
+        if (NULL != run_queue_head && run_queue_streak < run_queue_budget) {
+            struct ribs_context *ctx = run_queue_head;
+            if (NULL == (run_queue_head = ctx->next_runnable))
+                run_queue_tail = NULL;
+            ctx->next_runnable = NULL;
+            ++run_queue_streak;
+            ++epoll_worker_stats.num_runnable;
+            ribs_swapcurcontext(ctx);
+            return;
+        }
+        _epoll_worker_harvest(NULL == run_queue_head ? -1 : 0);
+    }
 }
 
-int queue_current_ctx(void) {
-    while (0 > write(queue_ctx_fd, &current_ctx, sizeof(void *))) {
-        if (EAGAIN != errno)
-            return LOGGER_PERROR("unable to queue context: write"), -1;
-        /* pipe is full!!! wait for it to clear
-           This is switching to LIFO mode, which can cause IO starvation
-           if too many contexes are trying to use this facility, very unlikely
-        */
-        LOGGER_INFO("Warning: context queue is full");
-        struct ribs_context *previous_context = epoll_worker_fd_map[queue_ctx_fd].ctx;
-        epoll_worker_fd_map[queue_ctx_fd].ctx = current_ctx;
-        yield(); // come back to me when can write
-        epoll_worker_fd_map[queue_ctx_fd].ctx = previous_context;
+void epoll_worker_queue_ctx(struct ribs_context *ctx) {
+    /* already queued */
+    if (NULL != ctx->next_runnable || run_queue_tail == ctx)
+        return;
+    if (NULL == run_queue_tail)
+        run_queue_head = ctx;
+    else
+        run_queue_tail->next_runnable = ctx;
+    run_queue_tail = ctx;
+}
+
+void epoll_worker_dequeue_ctx(struct ribs_context *ctx) {
+    /* not queued */
+    if (NULL == ctx->next_runnable && run_queue_tail != ctx)
+        return;
+    struct ribs_context **prev = &run_queue_head, *last = NULL;
+    while (*prev != ctx) {
+        last = *prev;
+        prev = &last->next_runnable;
     }
+    *prev = ctx->next_runnable;
+    if (run_queue_tail == ctx)
+        run_queue_tail = last;
+    ctx->next_runnable = NULL;
+}
+
+int queue_current_ctx(void) {
+    epoll_worker_queue_ctx(current_ctx);
     return 0;
 }
 
 inline void courtesy_yield(void) {
-    if (0 == epoll_wait(ribs_epoll_fd, &last_epollev, 1, 0))
+    if (ready_events_cur == ready_events_num && NULL == run_queue_head && 0 == _epoll_worker_harvest(0))
         return;
-    // save since queue_current_ctx() will override if queue if full;
-    struct ribs_context *save_ctx = epoll_worker_fd_map[last_epollev.data.fd].ctx;
     queue_current_ctx();
-    ribs_swapcurcontext(save_ctx);
+    yield();
 }
 
 int epoll_close() {
     return close(ribs_epoll_fd);
 }
 
+void epoll_worker_timeout_expired(void *fd_data) {
+    int fd = (struct epoll_worker_fd_data *)fd_data - epoll_worker_fd_map;
+    if (0 > shutdown(fd, SHUT_RDWR))
+        LOGGER_PERROR("shutdown");
+}
+
 int ribs_close(int fd) {
+    epoll_worker_clear_timeout(fd);
 #ifdef RIBS2_SSL
     ribs_ssl_free(fd);
 #endif
     epoll_ctl(ribs_epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    /* the fd number can be reused before the rest of the batch is
+       dispatched, drop the events which were already harvested */
+    int i;
+    for (i = ready_events_cur; i < ready_events_num; ++i)
+        if (ready_events[i].data.fd == fd)
+            ready_events[i].data.fd = -1;
     return epoll_worker_ignore_events(fd), close(fd);
 }
+
+void epoll_worker_get_stats(struct epoll_worker_stats *stats) {
+    *stats = epoll_worker_stats;
+}
+
+void epoll_worker_dump_stats(void) {
+    int i;
+    const char HEADER[] = "=== epoll worker stats ===";
+    LOGGER_INFO("%*s", (int)(50 + sizeof(HEADER))/2, HEADER);
+    LOGGER_INFO("wakeups: %" PRIu64 ", events: %" PRIu64 ", avg events per wakeup: %.2f, runnable: %" PRIu64,
+                epoll_worker_stats.num_wakeups, epoll_worker_stats.num_events,
+                epoll_worker_stats.num_wakeups ? (double)epoll_worker_stats.num_events / epoll_worker_stats.num_wakeups : 0.0,
+                epoll_worker_stats.num_runnable);
+    if (0 < busy_poll_usec)
+        LOGGER_INFO("busy poll: %uus, hits: %" PRIu64 ", misses: %" PRIu64, busy_poll_usec,
+                    epoll_worker_stats.busy_poll_hits, epoll_worker_stats.busy_poll_misses);
+    LOGGER_INFO("%15s   %15s", "events", "wakeups");
+    for (i = 0; i < EPOLL_WORKER_STATS_NUM_BUCKETS; ++i) {
+        if (0 < epoll_worker_stats.events_per_wakeup[i])
+            LOGGER_INFO("%7u - %-5u   %15" PRIu64, 1U << i, (2U << i) - 1, epoll_worker_stats.events_per_wakeup[i]);
+    }
+}
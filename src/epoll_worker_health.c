@@ -0,0 +1,187 @@
+/*
+    This file is part of RIBS2.0 (Robust Infrastructure for Backend Systems).
+    RIBS is an infrastructure for building great SaaS applications (but not
+    limited to).
+
+    Copyright (C) 2015 TrueSkills, Inc.
+
+    RIBS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, version 2.1 of the License.
+
+    RIBS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with RIBS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "epoll_worker_health.h"
+#include "epoll_worker.h"
+#include "logger.h"
+#include "ilog2.h"
+#include <time.h>
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <signal.h>
+
+_RIBS_THREAD_LOCAL_ int epoll_worker_health_enabled = 0;
+static _RIBS_THREAD_LOCAL_ struct epoll_worker_health health;
+static _RIBS_THREAD_LOCAL_ struct epoll_worker_health_loop *loop = NULL;
+static _RIBS_THREAD_LOCAL_ uint64_t enabled_tick;
+static _RIBS_THREAD_LOCAL_ uint64_t harvest_tick;
+
+struct epoll_worker_health_loop *epoll_worker_health_loops[EPOLL_WORKER_HEALTH_MAX_LOOPS];
+int epoll_worker_health_num_loops = 0;
+
+/* 0: not calibrated, 1: in progress, 2: done */
+static volatile int calibrated = 0;
+static double ns_per_tick = 1.0;
+
+#define HEALTH_ALTSTACK_SIZE (64 * 1024)
+
+static inline uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+inline uint64_t epoll_worker_health_ticks(void) {
+#ifdef __x86_64__
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+    return ((uint64_t)hi << 32) | lo;
+#else
+    return monotonic_ns();
+#endif
+}
+
+static void calibrate(void) {
+    if (!__sync_bool_compare_and_swap(&calibrated, 0, 1)) {
+        while (2 != calibrated)
+            __sync_synchronize();
+        return;
+    }
+#ifdef __x86_64__
+    /* spin for 10ms against the monotonic clock */
+    uint64_t t0 = monotonic_ns(), c0 = epoll_worker_health_ticks(), t1;
+    while ((t1 = monotonic_ns()) - t0 < 10000000ULL);
+    ns_per_tick = (double)(t1 - t0) / (epoll_worker_health_ticks() - c0);
+#endif
+    __sync_synchronize();
+    calibrated = 2;
+}
+
+uint64_t epoll_worker_health_ticks_to_ns(uint64_t ticks) {
+    return (uint64_t)(ticks * ns_per_tick);
+}
+
+uint64_t epoll_worker_health_now(void) {
+    return epoll_worker_health_ticks_to_ns(epoll_worker_health_ticks());
+}
+
+static inline void record(uint64_t *hist, uint64_t *max, uint64_t ticks) {
+    uint64_t ns = epoll_worker_health_ticks_to_ns(ticks);
+    uint64_t b = ilog2_64(ns | 1);
+    ++hist[b < EPOLL_WORKER_HEALTH_NUM_BUCKETS ? b : EPOLL_WORKER_HEALTH_NUM_BUCKETS - 1];
+    if (ns > *max)
+        *max = ns;
+}
+
+int epoll_worker_health_enable(int enable) {
+    if (!enable) {
+        epoll_worker_health_enabled = 0;
+        if (loop)
+            loop->in_wait = 1; /* keep the watchdog quiet */
+        return 0;
+    }
+    if (NULL == loop) {
+        int n = __sync_fetch_and_add(&epoll_worker_health_num_loops, 1);
+        if (EPOLL_WORKER_HEALTH_MAX_LOOPS <= n)
+            return __sync_fetch_and_sub(&epoll_worker_health_num_loops, 1), LOGGER_ERROR("too many event loops"), -1;
+        loop = calloc(1, sizeof(struct epoll_worker_health_loop));
+        if (NULL == loop)
+            return LOGGER_PERROR("calloc"), -1;
+        /* for the watchdog's signal handler */
+        stack_t ss;
+        memset(&ss, 0, sizeof(ss));
+        if (NULL == (ss.ss_sp = malloc(HEALTH_ALTSTACK_SIZE)))
+            return LOGGER_PERROR("malloc"), -1;
+        ss.ss_size = HEALTH_ALTSTACK_SIZE;
+        if (0 > sigaltstack(&ss, NULL))
+            return LOGGER_PERROR("sigaltstack"), -1;
+        loop->thread = pthread_self();
+        loop->in_wait = 1;
+        calibrate();
+        __sync_synchronize();
+        epoll_worker_health_loops[n] = loop;
+    }
+    epoll_worker_health_reset();
+    epoll_worker_health_enabled = 1;
+    return 0;
+}
+
+void epoll_worker_health_reset(void) {
+    memset(&health, 0, sizeof(health));
+    enabled_tick = harvest_tick = epoll_worker_health_ticks();
+    if (loop)
+        loop->switch_tick = enabled_tick;
+}
+
+void epoll_worker_health_get(struct epoll_worker_health *h) {
+    *h = health;
+    h->elapsed = epoll_worker_health_ticks_to_ns(epoll_worker_health_ticks() - enabled_tick);
+}
+
+void epoll_worker_health_on_switch(void) {
+    uint64_t now = epoll_worker_health_ticks();
+    record(health.run_time, &health.max_run_time, now - loop->switch_tick);
+    ++health.num_switches;
+    loop->switch_tick = now;
+    ++loop->switch_seq;
+    loop->in_wait = 0;
+}
+
+void epoll_worker_health_on_wait(void) {
+    uint64_t now = epoll_worker_health_ticks();
+    record(health.loop_lag, &health.max_loop_lag, now - harvest_tick);
+    harvest_tick = now;
+    loop->in_wait = 1;
+}
+
+void epoll_worker_health_on_wakeup(int num_events) {
+    uint64_t now = epoll_worker_health_ticks();
+    /* the time spent waiting is not attributed to any ribbon */
+    loop->switch_tick += now - harvest_tick;
+    harvest_tick = now;
+    loop->in_wait = 0;
+    ++health.num_harvests;
+    if (0 < num_events)
+        health.num_events += num_events;
+}
+
+static void dump_hist(const char *name, uint64_t *hist) {
+    int i;
+    LOGGER_INFO("%15s   %15s", "usec", name);
+    for (i = 0; i < EPOLL_WORKER_HEALTH_NUM_BUCKETS; ++i) {
+        if (0 < hist[i])
+            LOGGER_INFO("%15.3f   %15" PRIu64, (double)(1ULL << i) / 1000, hist[i]);
+    }
+}
+
+void epoll_worker_health_dump(void) {
+    struct epoll_worker_health h;
+    epoll_worker_health_get(&h);
+    const char HEADER[] = "=== event loop health ===";
+    LOGGER_INFO("%*s", (int)(50 + sizeof(HEADER))/2, HEADER);
+    double sec = (double)h.elapsed / 1000000000;
+    LOGGER_INFO("loop: %d, elapsed: %.3fs, switches: %" PRIu64 ", harvests: %" PRIu64 ", events/sec: %.1f",
+                epoll_worker_get_thread_id(), sec, h.num_switches, h.num_harvests,
+                0 < sec ? h.num_events / sec : 0.0);
+    LOGGER_INFO("max run time: %.3fms, max loop lag: %.3fms",
+                (double)h.max_run_time / 1000000, (double)h.max_loop_lag / 1000000);
+    dump_hist("run time", h.run_time);
+    dump_hist("loop lag", h.loop_lag);
+}
@@ -0,0 +1,94 @@
+/*
+    This file is part of RIBS2.0 (Robust Infrastructure for Backend Systems).
+    RIBS is an infrastructure for building great SaaS applications (but not
+    limited to).
+
+    Copyright (C) 2015 TrueSkills, Inc.
+
+    RIBS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, version 2.1 of the License.
+
+    RIBS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with RIBS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "epoll_worker.h"
+#include "context.h"
+#include "logger.h"
+#include <pthread.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+
+struct thread_args {
+    int thread_id;
+    int (*thread_init)(int thread_id);
+    int report_fd;
+};
+
+static _RIBS_THREAD_LOCAL_ int thread_id = 0;
+static int num_threads_per_process = 1;
+static _RIBS_THREAD_LOCAL_ struct ribs_context thread_ctx = { .memalloc = MEMALLOC_INITIALIZER };
+
+static void *epoll_worker_thread(void *arg) {
+    struct thread_args args = *(struct thread_args *)arg;
+    thread_id = args.thread_id;
+    current_ctx = &thread_ctx;
+    int res = 0;
+    if (0 > epoll_worker_init() || 0 > args.thread_init(thread_id))
+        res = -1;
+    if (sizeof(res) != write(args.report_fd, &res, sizeof(res)) || 0 > res)
+        return NULL;
+    epoll_worker_loop();
+    return NULL;
+}
+
+int epoll_worker_init_threads(int num_threads, int (*thread_init)(int thread_id)) {
+#ifndef __x86_64__
+    if (1 < num_threads)
+        return LOGGER_ERROR("threaded mode is only supported on x86_64"), -1;
+#endif
+    num_threads_per_process = num_threads;
+    if (0 > epoll_worker_init() || 0 > thread_init(0))
+        return -1;
+    int pipefd[2];
+    if (0 > pipe2(pipefd, O_CLOEXEC))
+        return LOGGER_PERROR("pipe"), -1;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int i, res = 0;
+    for (i = 1; i < num_threads && 0 == res; ++i) {
+        /* one at a time, thread_init() doesn't have to be thread safe */
+        struct thread_args args = { i, thread_init, pipefd[1] };
+        pthread_t t;
+        int err = pthread_create(&t, &attr, epoll_worker_thread, &args);
+        if (0 != err) {
+            errno = err;
+            LOGGER_PERROR("pthread_create");
+            res = -1;
+        } else if (sizeof(res) != read(pipefd[0], &res, sizeof(res)))
+            res = -1;
+        if (0 > res)
+            LOGGER_ERROR("failed to initialize thread %d", i);
+    }
+    pthread_attr_destroy(&attr);
+    close(pipefd[0]);
+    close(pipefd[1]);
+    if (0 == res)
+        LOGGER_INFO("event loop threads: %d", num_threads);
+    return res;
+}
+
+int epoll_worker_get_thread_id(void) {
+    return thread_id;
+}
+
+int epoll_worker_get_num_threads(void) {
+    return num_threads_per_process;
+}
@@ -0,0 +1,131 @@
+/*
+    This file is part of RIBS2.0 (Robust Infrastructure for Backend Systems).
+    RIBS is an infrastructure for building great SaaS applications (but not
+    limited to).
+
+    Copyright (C) 2015 TrueSkills, Inc.
+
+    RIBS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, version 2.1 of the License.
+
+    RIBS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with RIBS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "epoll_worker_health.h"
+#include "context.h"
+#include "logger.h"
+#include <execinfo.h>
+#include <signal.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+
+#define WATCHDOG_SIGNAL (SIGRTMIN + 1)
+#define WATCHDOG_MAX_FRAMES 64
+
+static uint64_t threshold_ns;
+
+/* async-signal-safe formatting, the stalled ribbon may be in the
+   middle of logging (thread local buffer, localtime_r's lock) */
+static char *append_str(char *p, const char *s) {
+    while (*s)
+        *p++ = *s++;
+    return p;
+}
+
+static char *append_num(char *p, uint64_t n, unsigned base) {
+    char buf[24];
+    char *b = buf + sizeof(buf);
+    do {
+        *--b = "0123456789abcdef"[n % base];
+        n /= base;
+    } while (n);
+    while (b < buf + sizeof(buf))
+        *p++ = *b++;
+    return p;
+}
+
+static void watchdog_signal_handler(int signum) {
+    (void)signum;
+    int saved_errno = errno;
+    void *frames[WATCHDOG_MAX_FRAMES];
+    void *entry = (void *)current_ctx->entry_func;
+    char msg[128];
+    char *p = append_str(msg, "ERROR watchdog: stalled ribbon 0x");
+    p = append_num(p, (uintptr_t)current_ctx, 16);
+    p = append_str(p, " has been running for over ");
+    p = append_num(p, threshold_ns / 1000000, 10);
+    p = append_str(p, "ms, entry function:\n");
+    if (0 > write(STDERR_FILENO, msg, p - msg)) {
+        /* nothing to do */
+    }
+    backtrace_symbols_fd(&entry, 1, STDERR_FILENO);
+    int n = backtrace(frames, WATCHDOG_MAX_FRAMES);
+    /* skip the signal handler itself */
+    backtrace_symbols_fd(frames + 1, n - 1, STDERR_FILENO);
+    errno = saved_errno;
+}
+
+static void *watchdog(void *arg) {
+    (void)arg;
+    uint32_t reported_seq[EPOLL_WORKER_HEALTH_MAX_LOOPS];
+    int reported[EPOLL_WORKER_HEALTH_MAX_LOOPS];
+    memset(reported, 0, sizeof(reported));
+    struct timespec interval = { threshold_ns / 2000000000, (threshold_ns / 2) % 1000000000 };
+    for (;;) {
+        nanosleep(&interval, NULL);
+        uint64_t now = epoll_worker_health_ticks();
+        int i, num_loops = epoll_worker_health_num_loops;
+        for (i = 0; i < num_loops; ++i) {
+            struct epoll_worker_health_loop *loop = epoll_worker_health_loops[i];
+            if (NULL == loop || loop->in_wait)
+                continue;
+            uint32_t seq = loop->switch_seq;
+            uint64_t tick = loop->switch_tick;
+            if (now < tick || epoll_worker_health_ticks_to_ns(now - tick) < threshold_ns)
+                continue;
+            /* once per stall */
+            if (reported[i] && reported_seq[i] == seq)
+                continue;
+            reported[i] = 1;
+            reported_seq[i] = seq;
+            pthread_kill(loop->thread, WATCHDOG_SIGNAL);
+        }
+    }
+    return NULL;
+}
+
+int epoll_worker_watchdog_start(unsigned threshold_ms) {
+    if (0 == threshold_ms)
+        return LOGGER_ERROR("invalid watchdog threshold"), -1;
+    threshold_ns = (uint64_t)threshold_ms * 1000000;
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = watchdog_signal_handler;
+    /* on the alternate stack set by epoll_worker_health_enable(),
+       the ribbon's stack might be too small for the handler */
+    sa.sa_flags = SA_ONSTACK | SA_RESTART;
+    if (0 > sigaction(WATCHDOG_SIGNAL, &sa, NULL))
+        return LOGGER_PERROR("sigaction"), -1;
+    /* load libgcc now, backtrace() may allocate on the first call */
+    void *frame;
+    backtrace(&frame, 1);
+    pthread_t t;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int err = pthread_create(&t, &attr, watchdog, NULL);
+    pthread_attr_destroy(&attr);
+    if (0 != err)
+        return errno = err, LOGGER_PERROR("pthread_create"), -1;
+    LOGGER_INFO("event loop watchdog: %ums", threshold_ms);
+    return 0;
+}
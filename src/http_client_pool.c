@@ -31,6 +31,8 @@
 #include "sstr.h"
 #include "list.h"
 #include "hash_funcs.h"
+#include "ribs_uring.h"
+#include <poll.h>
 
 #define CLIENT_STACK_SIZE 65536
 
@@ -43,12 +45,12 @@ SSTRL(TRANSFER_ENCODING, "\r\nTransfer-Encoding: ");
 SSTRL(CONNECTION, "\r\nConnection: ");
 SSTRL(CONNECTION_CLOSE, "close");
 
-static struct http_client_context* last_ctx = NULL;
-static struct list* client_chains = NULL;
-static struct list* client_heads = NULL;
-static struct list free_list = LIST_INITIALIZER(free_list);
-static struct ribs_context *idle_ctx;
-static struct hashtable ht_persistent_clients = HASHTABLE_INITIALIZER;
+static _RIBS_THREAD_LOCAL_ struct http_client_context* last_ctx = NULL;
+static _RIBS_THREAD_LOCAL_ struct list* client_chains = NULL;
+static _RIBS_THREAD_LOCAL_ struct list* client_heads = NULL;
+static _RIBS_THREAD_LOCAL_ struct list free_list;
+static _RIBS_THREAD_LOCAL_ struct ribs_context *idle_ctx;
+static _RIBS_THREAD_LOCAL_ struct hashtable ht_persistent_clients = HASHTABLE_INITIALIZER;
 
 void http_client_free(struct http_client_context *cctx) {
     if (cctx->persistent) {
@@ -67,10 +69,11 @@ void http_client_free(struct http_client_context *cctx) {
             list_init(head);
         } else
             head = client_heads + *(uint32_t *)hashtable_get_val(&ht_persistent_clients, ofs);
-        struct list *client = client_chains + fd;
-        list_insert_tail(head, client);
-        struct epoll_worker_fd_data *fd_data = epoll_worker_fd_map + fd;
-        timeout_handler_add_fd_data(&cctx->pool->timeout_handler_persistent, fd_data);
+        /* not kept without the idle deadline */
+        if (0 > epoll_worker_set_timeout(fd, cctx->pool->timeout_handler_persistent.timeout))
+            ribs_close(fd);
+        else
+            list_insert_tail(head, client_chains + fd);
     }
     ctx_pool_put(&cctx->pool->ctx_pool, RIBS_RESERVED_TO_CONTEXT(cctx));
 }
@@ -82,9 +85,7 @@ static void http_client_idle_handler(void) {
             int fd = last_epollev.data.fd;
             struct list *client = client_chains + fd;
             list_remove(client);
-            ribs_close(fd);
-            struct epoll_worker_fd_data *fd_data = epoll_worker_fd_map + fd;
-            TIMEOUT_HANDLER_REMOVE_FD_DATA(fd_data);
+            ribs_close(fd); /* clears the idle deadline */
             /* TODO: remove from hashtable when list is empty (first add remove method to hashtable) */
             /* TODO: insert list head into free list */
         }
@@ -111,6 +112,7 @@ int http_client_pool_init(struct http_client_pool *http_client_pool, size_t init
         struct list *tmp = client_heads, *tmp_end = tmp + rlim.rlim_cur;
         if (!client_heads)
             return LOGGER_PERROR("calloc client_heads"), -1;
+        list_init(&free_list);
         for (;tmp != tmp_end; ++tmp)
             list_insert_tail(&free_list, tmp);
 
@@ -122,6 +124,12 @@ int http_client_pool_init(struct http_client_pool *http_client_pool, size_t init
     if (0 > timeout_handler_init(&http_client_pool->timeout_handler) ||
         0 > timeout_handler_init(&http_client_pool->timeout_handler_persistent))
         return -1;
+    if (0 == http_client_pool->connect_timeout)
+        http_client_pool->connect_timeout = http_client_pool->timeout_handler.timeout;
+    if (0 == http_client_pool->read_timeout)
+        http_client_pool->read_timeout = http_client_pool->timeout_handler.timeout;
+    if (0 == http_client_pool->write_timeout)
+        http_client_pool->write_timeout = http_client_pool->timeout_handler.timeout;
 
 #ifdef RIBS2_SSL
     http_client_pool->ssl_ctx = NULL;
@@ -163,13 +171,14 @@ int http_client_pool_init_ssl(struct http_client_pool *http_client_pool, size_t
         return;                          \
     }
 
-#define __READ_MORE_DATA(cond, container, buf, th, fd, extra)           \
+#define __READ_MORE_DATA(cond, container, buf, timeout, fd, extra)           \
     extra;                                                              \
     while(cond) {                                                       \
         if (*res <= 0)                                                  \
             return -1; /* partial response */                           \
-        if (errno == EAGAIN)                                            \
-            http_client_yield_ignore_epollout(th, fd);                  \
+        if (errno == EAGAIN &&                                          \
+            0 > http_client_yield_ignore_epollout(timeout, fd))         \
+            return -1;                                                  \
         if ((*res = container ## _read(buf, fd)) < 0) {                 \
             LOGGER_PERROR("read %s:%hu",                                \
                           inet_ntoa(cctx->key.addr),                    \
@@ -180,21 +189,22 @@ int http_client_pool_init_ssl(struct http_client_pool *http_client_pool, size_t
     }
 
 #ifndef RIBS2_SSL
-#define _READ_MORE_DATA(cond, container, buf, th, fd, extra)        \
-    __READ_MORE_DATA(cond, container, buf, th, fd, extra)
+#define _READ_MORE_DATA(cond, container, buf, timeout, fd, extra)        \
+    __READ_MORE_DATA(cond, container, buf, timeout, fd, extra)
 #else
-#define _READ_MORE_DATA(cond, container, buf, th, fd, extra)            \
+#define _READ_MORE_DATA(cond, container, buf, timeout, fd, extra)            \
     SSL *ssl = ribs_ssl_get(fd);                                        \
     if (!ssl) {                                                         \
-        __READ_MORE_DATA(cond, container, buf, th, fd, extra)           \
+        __READ_MORE_DATA(cond, container, buf, timeout, fd, extra)           \
     }                                                                   \
     else {                                                              \
         extra;                                                          \
         while (cond) {                                                  \
             if (*res < 0) {                                             \
-                if (ribs_ssl_want_io(ssl, *res))                        \
-                    http_client_yield(th, fd);                          \
-                else {                                                  \
+                if (ribs_ssl_want_io(ssl, *res)) {                      \
+                    if (0 > http_client_yield(timeout, fd))             \
+                        return -1;                                      \
+                } else {                                                \
                     LOGGER_PERROR("SSL_read %s:%hu %s",                 \
                                   inet_ntoa(cctx->key.addr),            \
                                   cctx->key.port,                       \
@@ -215,51 +225,90 @@ int http_client_pool_init_ssl(struct http_client_pool *http_client_pool, size_t
     }
 #endif
 
-#define READ_MORE_DATA_STR(cond, container, buf, th, fd)            \
-    _READ_MORE_DATA(cond, container, buf, th, fd,                   \
+#define READ_MORE_DATA_STR(cond, container, buf, timeout, fd)            \
+    _READ_MORE_DATA(cond, container, buf, timeout, fd,                   \
                     *(container ## _wloc(buf)) = 0)
 
-#define READ_MORE_DATA(cond, container, buf, th, fd)                \
-    _READ_MORE_DATA(cond, container, buf, th, fd, )
+#define READ_MORE_DATA(cond, container, buf, timeout, fd)                \
+    _READ_MORE_DATA(cond, container, buf, timeout, fd, )
 
 #ifndef RIBS2_SSL
-#define READ_DATA_STR(cond, container, buf, th, fd)                 \
+#define READ_DATA_STR(cond, container, buf, timeout, fd)                 \
     *res = container ## _read(buf, fd);                             \
-    READ_MORE_DATA_STR(cond, container, buf, th, fd)
+    READ_MORE_DATA_STR(cond, container, buf, timeout, fd)
 #else
-#define READ_DATA_STR(cond, container, buf, th, fd)                 \
+#define READ_DATA_STR(cond, container, buf, timeout, fd)                 \
     *res = 1, errno = 0;                                            \
-    READ_MORE_DATA_STR(cond, container, buf, th, fd)
+    READ_MORE_DATA_STR(cond, container, buf, timeout, fd)
 #endif
 
-static inline void http_client_yield(struct timeout_handler* timeout_handler, int fd) {
-    struct epoll_worker_fd_data *fd_data = epoll_worker_fd_map + fd;
-    timeout_handler_add_fd_data(timeout_handler, fd_data);
+/* the deadline restarts on every wakeup, it bounds the time without
+   progress. Without a deadline the connection is given up on */
+static inline int http_client_yield(time_t timeout, int fd) {
+    if (0 > epoll_worker_set_timeout(fd, timeout))
+        return LOGGER_ERROR("failed to arm the connection timeout"), -1;
     yield();
-    TIMEOUT_HANDLER_REMOVE_FD_DATA(fd_data);
+    epoll_worker_clear_timeout(fd);
+    return 0;
+}
+
+static inline int http_client_yield_write(time_t timeout, int fd) {
+    if (0 > epoll_worker_arm_write(fd))
+        return -1;
+    return http_client_yield(timeout, fd);
 }
 
-static inline void http_client_yield_ignore_epollout(struct timeout_handler* timeout_handler, int fd) {
-    struct epoll_worker_fd_data *fd_data = epoll_worker_fd_map + fd;
-    timeout_handler_add_fd_data(timeout_handler, fd_data);
+static inline int http_client_yield_ignore_epollout(time_t timeout, int fd) {
+    if (0 > epoll_worker_set_timeout(fd, timeout))
+        return LOGGER_ERROR("failed to arm the connection timeout"), -1;
     do
         yield();
     while (EPOLLOUT == last_epollev.events);
-    TIMEOUT_HANDLER_REMOVE_FD_DATA(fd_data);
+    epoll_worker_clear_timeout(fd);
+    return 0;
+}
+
+static inline int http_client_write_request_uring(struct http_client_context *cctx, time_t timeout)
+{
+    size_t rav;
+    while ((rav = vmbuf_ravail(&cctx->request)) > 0) {
+        /* send waits for the connection to be established */
+        if (0 > epoll_worker_set_timeout(cctx->fd, timeout))
+            return LOGGER_ERROR("failed to arm the connection timeout"), -1;
+        ssize_t res = ribs_uring_send(cctx->fd, vmbuf_rloc(&cctx->request), rav, MSG_NOSIGNAL);
+        epoll_worker_clear_timeout(cctx->fd);
+        if (0 < res) {
+            vmbuf_rseek(&cctx->request, res);
+            continue;
+        }
+        if (0 > res && EAGAIN == errno && 0 <= ribs_uring_poll(cctx->fd, POLLOUT))
+            continue;
+        if (0 == res)
+            errno = ENODATA;
+        return LOGGER_PERROR("send %s:%hu",inet_ntoa(cctx->key.addr), cctx->key.port), -1;
+    }
+    return 0;
 }
 
-static inline int http_client_write_request(struct http_client_context *cctx, struct timeout_handler* th)
+static inline int http_client_write_request(struct http_client_context *cctx, time_t timeout)
 {
     int res;
 #ifdef RIBS2_SSL
     SSL *ssl = ribs_ssl_get(cctx->fd);
     if (!ssl) {
 #endif
-        for (;
-             (res = vmbuf_write(&cctx->request, cctx->fd)) == 0;
-             http_client_yield(th, cctx->fd));
+        if (EPOLL_WORKER_BACKEND_URING == epoll_worker_get_backend())
+            return http_client_write_request_uring(cctx, timeout);
+        /* waits for the connection to be established as well */
+        while ((res = vmbuf_write(&cctx->request, cctx->fd)) == 0) {
+            if (0 > http_client_yield_write(timeout, cctx->fd)) {
+                res = -1;
+                break;
+            }
+        }
         if (0 > res)
             return LOGGER_PERROR("write %s:%hu",inet_ntoa(cctx->key.addr), cctx->key.port), -1;
+        epoll_worker_disarm_write(cctx->fd);
 #ifdef RIBS2_SSL
     } else {
         size_t rav;
@@ -270,7 +319,8 @@ static inline int http_client_write_request(struct http_client_context *cctx, st
                 continue;
             }
             if (ribs_ssl_want_io(ssl, res)) {
-                http_client_yield(th, cctx->fd);
+                if (0 > http_client_yield(timeout, cctx->fd))
+                    return -1;
                 continue;
             }
             LOGGER_PERROR("SSL_write %s:%hu %s",inet_ntoa(cctx->key.addr), cctx->key.port, ERR_reason_error_string(ERR_get_error()));
@@ -281,11 +331,11 @@ static inline int http_client_write_request(struct http_client_context *cctx, st
     return 0;
 }
 
-static inline int http_client_read_headers(struct http_client_context *cctx, int *code, uint32_t *eoh_ofs, int *res, char **data, struct timeout_handler *th)
+static inline int http_client_read_headers(struct http_client_context *cctx, int *code, uint32_t *eoh_ofs, int *res, char **data, time_t timeout)
 {
     char *eoh;
     READ_DATA_STR(NULL == (eoh = strstr(*data = vmbuf_data(&cctx->response), CRLFCRLF)),
-                  vmbuf, &cctx->response, th, cctx->fd)
+                  vmbuf, &cctx->response, timeout, cctx->fd)
     *eoh_ofs = eoh - *data + SSTRLEN(CRLFCRLF);
     *eoh = 0;
     cctx->persistent = 1;
@@ -306,7 +356,7 @@ static inline int http_client_read_headers(struct http_client_context *cctx, int
     return 0;
 }
 
-static inline int http_client_read_body(struct http_client_context *cctx, int *code, struct vmfile *infile, uint32_t *eoh_ofs, int *res, char **data, struct timeout_handler *th)
+static inline int http_client_read_body(struct http_client_context *cctx, int *code, struct vmfile *infile, uint32_t *eoh_ofs, int *res, char **data, time_t timeout)
 {
     struct vmbuf *response = &cctx->response;
     do {
@@ -332,10 +382,10 @@ static inline int http_client_read_body(struct http_client_context *cctx, int *c
                 return -1;
             size_t content_end = *eoh_ofs + content_len;
             if (infile) {
-                READ_MORE_DATA(vmfile_wlocpos(infile) < content_end, vmfile, infile, th, cctx->fd);
+                READ_MORE_DATA(vmfile_wlocpos(infile) < content_end, vmfile, infile, timeout, cctx->fd);
             }
             else {
-                READ_MORE_DATA(vmbuf_wlocpos(response) < content_end, vmbuf, response, th, cctx->fd);
+                READ_MORE_DATA(vmbuf_wlocpos(response) < content_end, vmbuf, response, timeout, cctx->fd);
             }
             break;
         }
@@ -350,10 +400,10 @@ static inline int http_client_read_body(struct http_client_context *cctx, int *c
             size_t data_start = *eoh_ofs;
             for (;;) {
                 if (infile) {
-                    READ_MORE_DATA_STR(*(p = strchrnul((*data = vmfile_data(infile)) + chunk_start, '\r')) == 0, vmfile, infile, th, cctx->fd);
+                    READ_MORE_DATA_STR(*(p = strchrnul((*data = vmfile_data(infile)) + chunk_start, '\r')) == 0, vmfile, infile, timeout, cctx->fd);
                 }
                 else {
-                    READ_MORE_DATA_STR(*(p = strchrnul((*data = vmbuf_data(response)) + chunk_start, '\r')) == 0, vmbuf, response, th, cctx->fd);
+                    READ_MORE_DATA_STR(*(p = strchrnul((*data = vmbuf_data(response)) + chunk_start, '\r')) == 0, vmbuf, response, timeout, cctx->fd);
                 }
                 if (0 != SSTRNCMP(CRLF, p))
                     return -1;
@@ -368,10 +418,10 @@ static inline int http_client_read_body(struct http_client_context *cctx, int *c
                 chunk_start = p - *data + SSTRLEN(CRLF);
                 size_t chunk_end = chunk_start + s + SSTRLEN(CRLF);
                 if (infile) {
-                    READ_MORE_DATA(vmfile_wlocpos(infile) < chunk_end, vmfile, infile, th, cctx->fd);
+                    READ_MORE_DATA(vmfile_wlocpos(infile) < chunk_end, vmfile, infile, timeout, cctx->fd);
                     memmove(vmfile_data(infile) + data_start, vmfile_data(infile) + chunk_start, s);
                  } else {
-                    READ_MORE_DATA(vmbuf_wlocpos(response) < chunk_end, vmbuf, response, th, cctx->fd);
+                    READ_MORE_DATA(vmbuf_wlocpos(response) < chunk_end, vmbuf, response, timeout, cctx->fd);
                     memmove(vmbuf_data(response) + data_start, vmbuf_data(response) + chunk_start, s);
                  }
                 data_start += s;
@@ -383,7 +433,7 @@ static inline int http_client_read_body(struct http_client_context *cctx, int *c
          * determine content length by server closing connection
          */
         int read_until_close() {
-            READ_MORE_DATA(1, vmbuf, response, th, cctx->fd);
+            READ_MORE_DATA(1, vmbuf, response, timeout, cctx->fd);
             return 0;
         }
         if (read_until_close() < 0 && *res != 0)
@@ -395,21 +445,22 @@ static inline int http_client_read_body(struct http_client_context *cctx, int *c
 void http_client_fiber_main(void) {
     struct http_client_context *ctx = (struct http_client_context *)current_ctx->reserved;
     int fd = ctx->fd;
-    struct timeout_handler *th = &ctx->pool->timeout_handler;
-    struct epoll_worker_fd_data *fd_data = epoll_worker_fd_map + fd;
-    TIMEOUT_HANDLER_REMOVE_FD_DATA(fd_data);
+    epoll_worker_clear_timeout(fd);
 
     epoll_worker_set_last_fd(fd); /* needed in the case where epoll_wait never occured */
 
 #ifdef RIBS2_SSL
     SSL *ssl = ribs_ssl_get(fd);
     if (ssl && !ctx->ssl_connected) {
-        for (;;http_client_yield(th, fd)) {
+        for (;;) {
             int res = SSL_connect(ssl);
             if (1 == res)
                 break;
-            if (ribs_ssl_want_io(ssl, res))
+            if (ribs_ssl_want_io(ssl, res)) {
+                if (0 > http_client_yield(ctx->pool->connect_timeout, fd))
+                    CLIENT_ERROR();
                 continue;
+            }
             LOGGER_PERROR("SSL_connect %s:%hu %s",inet_ntoa(ctx->key.addr), ctx->key.port, ERR_reason_error_string(ERR_get_error()));
             CLIENT_ERROR();
         }
@@ -474,7 +525,7 @@ void http_client_fiber_main(void) {
 #endif
 
     //write_request
-    if ( 0 > http_client_write_request(ctx, th))
+    if ( 0 > http_client_write_request(ctx, ctx->pool->write_timeout))
         CLIENT_ERROR();
 
     //read headers
@@ -482,10 +533,10 @@ void http_client_fiber_main(void) {
     int code;
     char *data;
     int res;
-    if ( 0 > http_client_read_headers(ctx, &code, &eoh_ofs, &res, &data, th))
+    if ( 0 > http_client_read_headers(ctx, &code, &eoh_ofs, &res, &data, ctx->pool->read_timeout))
         CLIENT_ERROR();
 
-    if ( 0 > http_client_read_body(ctx, &code, NULL, &eoh_ofs, &res, &data, th))
+    if ( 0 > http_client_read_body(ctx, &code, NULL, &eoh_ofs, &res, &data, ctx->pool->read_timeout))
         CLIENT_ERROR();
 
     ctx->content = vmbuf_data_ofs(&ctx->response, eoh_ofs);
@@ -597,16 +648,15 @@ static inline struct http_client_context *_http_client_pool_create_client(struct
     struct ribs_context *new_ctx;
     struct epoll_worker_fd_data *fd_data;
     struct http_client_context *cctx;
-    const struct timeval epoch = {0,0};
 
     /* find matching client fd, if not found, creat one */
     if (ofs > 0 && !list_empty(head = client_heads + *(uint32_t *)hashtable_get_val(&ht_persistent_clients, ofs))) {
         struct list *client = list_pop_tail(head);
         cfd = client - client_chains;
         fd_data = epoll_worker_fd_map + cfd;
-        // do not use already shutdown()
-        if (timercmp(&fd_data->timestamp, &epoch, !=)) {
-            TIMEOUT_HANDLER_REMOVE_FD_DATA(fd_data);
+        // do not use already shutdown(), the idle deadline fired
+        if (epoll_worker_timeout_pending(cfd)) {
+            epoll_worker_clear_timeout(cfd);
             new_ctx = ctx_pool_get(&http_client_pool->ctx_pool);
             cctx = (struct http_client_context *)new_ctx->reserved;
 #ifdef RIBS2_SSL
@@ -629,7 +679,14 @@ static inline struct http_client_context *_http_client_pool_create_client(struct
     struct sockaddr_in saddr = { .sin_family = AF_INET, .sin_port = htons(port), .sin_addr = addr };
     if (0 > connect(cfd, (struct sockaddr *)&saddr, sizeof(saddr)) && EINPROGRESS != errno)
         return LOGGER_PERROR("connect %s:%hu",inet_ntoa(addr), port), ribs_close(cfd), NULL;
-    if (0 > ribs_epoll_add(cfd, EPOLLIN | EPOLLOUT | EPOLLET, event_loop_ctx))
+    /* EPOLLOUT is armed on demand (connect in progress, full socket
+       buffer), SSL needs it for the handshake */
+    uint32_t events = EPOLLIN | EPOLLET;
+#ifdef RIBS2_SSL
+    if (http_client_pool->ssl_ctx)
+        events |= EPOLLOUT;
+#endif
+    if (0 > ribs_epoll_add(cfd, events, event_loop_ctx))
         return ribs_close(cfd), NULL;
 
 #ifdef RIBS2_SSL
@@ -669,7 +726,8 @@ static inline struct http_client_context *_http_client_pool_create_client(struct
     cctx->content = NULL;
     cctx->content_length = 0;
     cctx->persistent = 0;
-    timeout_handler_add_fd_data(&http_client_pool->timeout_handler, fd_data);
+    if (0 > epoll_worker_set_timeout(cfd, http_client_pool->connect_timeout))
+        return LOGGER_ERROR("failed to arm the connection timeout"), ribs_close(cfd), http_client_free(cctx), NULL;
     return cctx;
 }
 
@@ -710,8 +768,7 @@ http_client_get_file(struct http_client_pool *http_client_pool, struct vmfile *i
         return -1;
 
     int cfd = cctx->fd;
-    struct epoll_worker_fd_data *fd_data = epoll_worker_fd_map + cfd;
-    TIMEOUT_HANDLER_REMOVE_FD_DATA(fd_data);
+    epoll_worker_clear_timeout(cfd);
 
     vmbuf_strcpy(&cctx->request, "GET ");
     va_list ap;
@@ -726,12 +783,15 @@ http_client_get_file(struct http_client_pool *http_client_pool, struct vmfile *i
 #ifdef RIBS2_SSL
     SSL *ssl = ribs_ssl_get(cfd);
     if (ssl && !cctx->ssl_connected) {
-        for (;;http_client_yield(&cctx->pool->timeout_handler, cfd)) {
+        for (;;) {
             int res = SSL_connect(ssl);
             if (1 == res)
                 break;
-            if (ribs_ssl_want_io(ssl, res))
+            if (ribs_ssl_want_io(ssl, res)) {
+                if (0 > http_client_yield(cctx->pool->connect_timeout, cfd))
+                    return http_client_close_free(cctx), -1;
                 continue;
+            }
             LOGGER_PERROR("SSL_connect %s:%hu %s",inet_ntoa(cctx->key.addr), cctx->key.port, ERR_reason_error_string(ERR_get_error()));
             return http_client_close_free(cctx), -1;
         }
@@ -740,7 +800,7 @@ http_client_get_file(struct http_client_pool *http_client_pool, struct vmfile *i
 #endif
 
     // send request
-    if (0 > http_client_write_request(cctx, &cctx->pool->timeout_handler))
+    if (0 > http_client_write_request(cctx, cctx->pool->write_timeout))
         return http_client_close_free(cctx), -1;
 
     uint32_t eoh_ofs;
@@ -749,7 +809,7 @@ http_client_get_file(struct http_client_pool *http_client_pool, struct vmfile *i
     char *data;
 
     // read headers
-    if ( 0 > http_client_read_headers(cctx, &code, &eoh_ofs, &res, &data, &cctx->pool->timeout_handler))
+    if ( 0 > http_client_read_headers(cctx, &code, &eoh_ofs, &res, &data, cctx->pool->read_timeout))
         return http_client_close_free(cctx), -1;
 
     vmbuf_rlocset(&cctx->response, eoh_ofs);
@@ -760,7 +820,7 @@ http_client_get_file(struct http_client_pool *http_client_pool, struct vmfile *i
         *file_compressed = 1;
 
     // read into file
-    if ( 0 > http_client_read_body(cctx, &code, infile, &eoh_ofs, &res, &data, &cctx->pool->timeout_handler))
+    if ( 0 > http_client_read_body(cctx, &code, infile, &eoh_ofs, &res, &data, cctx->pool->read_timeout))
         return http_client_close_free(cctx), -1;
 
     if (!cctx->persistent)
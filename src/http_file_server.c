@@ -19,12 +19,11 @@
 */
 #include "http_file_server.h"
 #include "http_defs.h"
+#include "ribs_clock.h"
 #include "mime_types.h"
 #include "file_mapper.h"
+#include "ribs_offload.h"
 #include <limits.h>
-#include <sys/socket.h>
-#include <arpa/inet.h>
-#include <netinet/in.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <dirent.h>
@@ -37,15 +36,81 @@
 
 SSTRL(RIBS_GZ_EXT, "._ribs_gz_");
 
-const char *_peer_addr_str(int fd, char *buf) {
-    struct sockaddr_in addr;
-    socklen_t len = sizeof(addr);
-    if (0 == getpeername(fd, (struct sockaddr*)&addr, &len) &&
-        NULL != inet_ntop(AF_INET, &addr.sin_addr, buf, INET_ADDRSTRLEN))
-        return buf;
-    return "0.0.0.0";
+/*
+ * blocking file system calls, offloaded
+ */
+struct open_file_args {
+    const char *filename;
+    struct stat *st;
+    int fd;
+};
+
+static long _open_file(void *arg) {
+    struct open_file_args *args = (struct open_file_args *)arg;
+    args->fd = open(args->filename, O_RDONLY);
+    if (0 > args->fd)
+        return -1;
+    return fstat(args->fd, args->st);
 }
 
+/* -1: open failed, -2: fstat failed (fd is closed) */
+static int open_file(const char *filename, struct stat *st) {
+    struct open_file_args args = { filename, st, -1 };
+    if (0 > ribs_offload(_open_file, &args)) {
+        if (0 > args.fd)
+            return -1;
+        close(args.fd);
+        return -2;
+    }
+    return args.fd;
+}
+
+struct stat_args {
+    const char *filename;
+    struct stat *st;
+};
+
+static long _stat(void *arg) {
+    struct stat_args *args = (struct stat_args *)arg;
+    return stat(args->filename, args->st);
+}
+
+#ifdef HAVE_ZLIB
+struct gzip_file_args {
+    const char *src;
+    const char *dst;
+};
+
+/* -1: failed to compress, -2: failed to read the source.
+   other requests run meanwhile, the file is written under a unique
+   name and renamed into place once complete */
+static long _gzip_file(void *arg) {
+    struct gzip_file_args *args = (struct gzip_file_args *)arg;
+    char tmpname[PATH_MAX];
+    if (PATH_MAX <= snprintf(tmpname, PATH_MAX, "%s.XXXXXX", args->dst))
+        return -1;
+    int fd = mkstemp(tmpname);
+    if (0 > fd)
+        return LOGGER_PERROR("mkstemp [%s]", tmpname), -1;
+    fchmod(fd, 0644);
+    gzFile file = gzdopen(fd, "wb");
+    if (NULL == file)
+        return close(fd), unlink(tmpname), -1;
+    LOGGER_INFO("compressing [%s] to [%s]", args->src, args->dst);
+    struct file_mapper fm = FILE_MAPPER_INITIALIZER;
+    if (0 > file_mapper_init(&fm, args->src))
+        return gzclose(file), unlink(tmpname), -2;
+    ssize_t file_size = file_mapper_size(&fm);
+    ssize_t size = gzwrite(file, file_mapper_data(&fm), file_size);
+    if (Z_OK != gzclose(file))
+        size = -1;
+    file_mapper_free(&fm);
+    if (size != file_size || 0 > rename(tmpname, args->dst))
+        return unlink(tmpname), -1;
+    return 0;
+}
+#endif
+
 int http_file_server_list_dir(struct http_file_server *fs, const char *realname) {
     struct http_server_context *ctx = http_server_get_context();
     struct vmbuf *payload = &ctx->payload;
@@ -119,7 +184,7 @@ static inline int32_t find_max_age(struct http_file_server *fs, const char *ext)
 int http_file_server_run(struct http_file_server *fs) {
     struct http_server_context *ctx = http_server_get_context();
     struct http_headers headers;
-    http_headers_parse(ctx->headers, &headers);
+    http_server_parse_headers(&headers);
     if (0 == *ctx->uri)
         return HTTP_FILE_SERVER_ERROR(403), -1;
     http_server_decode_uri(ctx->uri);
@@ -133,18 +198,18 @@ int http_file_server_run2(struct http_file_server *fs, struct http_headers *head
         ++ext;
     else
         ext = "";
-    static struct vmbuf tmp = VMBUF_INITIALIZER;
-    vmbuf_init(&tmp, 4096);
-    vmbuf_sprintf(&tmp, "%s/%s", fs->base_dir, file);
+    /* on the stack, other ribbons run while realpath is offloaded */
+    char filename[PATH_MAX];
+    if (PATH_MAX <= snprintf(filename, PATH_MAX, "%s/%s", fs->base_dir, file))
+        return HTTP_FILE_SERVER_ERROR(404), -1;
 
     char realname[PATH_MAX];
-    char addr_str[INET_ADDRSTRLEN];
-    if (NULL == realpath(vmbuf_data(&tmp), realname)) {
-        LOGGER_PERROR("[%s / %s] realpath (404): [%s]", _peer_addr_str(ctx->fd, addr_str), headers->x_forwarded_for, vmbuf_data(&tmp));
+    if (NULL == ribs_offload_realpath(filename, realname)) {
+        LOGGER_PERROR("[%s / %s] realpath (404): [%s]", headers->peer_ip_addr, headers->x_forwarded_for, filename);
         return HTTP_FILE_SERVER_ERROR(404), -1;
     }
     if (0 != strncmp(realname, fs->base_dir, fs->base_dir_len)) {
-        LOGGER_ERROR("[%s / %s] rejecting (403): [%s]",  _peer_addr_str(ctx->fd, addr_str), headers->x_forwarded_for, realname);
+        LOGGER_ERROR("[%s / %s] rejecting (403): [%s]",  headers->peer_ip_addr, headers->x_forwarded_for, realname);
         return HTTP_FILE_SERVER_ERROR(403), -1;
     }
     int ffd;
@@ -152,7 +217,8 @@ int http_file_server_run2(struct http_file_server *fs, struct http_headers *head
     struct stat st, orig_st;
 #ifdef HAVE_ZLIB
     if (0 != (headers->accept_encoding_mask & HTTP_AE_GZIP) && hashtable_lookup(&fs->ht_ext_whitelist, ext, strlen(ext))) {
-        if (0 > stat(realname, &orig_st))
+        struct stat_args stat_args = { realname, &orig_st };
+        if (0 > ribs_offload(_stat, &stat_args))
             return HTTP_FILE_SERVER_ERROR(404), -1;
         if (S_ISDIR(orig_st.st_mode)) {
             if (fs->allow_list)
@@ -168,31 +234,23 @@ int http_file_server_run2(struct http_file_server *fs, struct http_headers *head
             if (PATH_MAX <= snprintf(realname_compressed, PATH_MAX, "%s.%s", RIBS_GZ_EXT, realname))
                 return HTTP_FILE_SERVER_ERROR(403), -1;
         }
-        ffd = open(realname_compressed, O_RDONLY);
+        ffd = open_file(realname_compressed, &st);
         for (;;) {
+            if (unlikely(-2 == ffd))
+                return HTTP_FILE_SERVER_ERROR(500), -1;
             if (unlikely(0 > ffd)) {
-                gzFile file = gzopen(realname_compressed, "wb");
-                if (NULL == file)
-                    return HTTP_FILE_SERVER_ERROR(500), -1;
-                LOGGER_INFO("compressing [%s] to [%s]", realname, realname_compressed);
-                struct file_mapper fm = FILE_MAPPER_INITIALIZER;
-                if (0 > file_mapper_init(&fm, realname))
-                    return HTTP_FILE_SERVER_ERROR(404), gzclose(file), -1;
-                ssize_t file_size = file_mapper_size(&fm);
-                ssize_t size = gzwrite(file, file_mapper_data(&fm), file_size);
-                if (Z_OK != gzclose(file))
-                    size = -1;
-                file_mapper_free(&fm);
-                if (size != file_size)
+                struct gzip_file_args gzip_args = { realname, realname_compressed };
+                long res = ribs_offload(_gzip_file, &gzip_args);
+                if (-2 == res)
+                    return HTTP_FILE_SERVER_ERROR(404), -1;
+                if (0 > res)
                     return HTTP_FILE_SERVER_ERROR(500), -1;
-                ffd = open(realname_compressed, O_RDONLY);
-                if (0 > ffd)
+                ffd = open_file(realname_compressed, &st);
+                if (-1 == ffd)
                     return HTTP_FILE_SERVER_ERROR(404), -1;
-                if (0 > fstat(ffd, &st))
-                    return HTTP_FILE_SERVER_ERROR(500), close(ffd), -1;
+                if (0 > ffd)
+                    return HTTP_FILE_SERVER_ERROR(500), -1;
             } else {
-                if (0 > fstat(ffd, &st))
-                    return HTTP_FILE_SERVER_ERROR(500), close(ffd), -1;
                 if (st.st_mtime < orig_st.st_mtime) {
                     close(ffd);
                     ffd = -1;
@@ -206,11 +264,11 @@ int http_file_server_run2(struct http_file_server *fs, struct http_headers *head
 #endif
     {
         compressed = 0;
-        ffd = open(realname, O_RDONLY);
-        if (0 > ffd)
+        ffd = open_file(realname, &st);
+        if (-1 == ffd)
             return HTTP_FILE_SERVER_ERROR(404), -1;
-        if (0 > fstat(ffd, &st))
-            return HTTP_FILE_SERVER_ERROR(500), close(ffd), -1;
+        if (0 > ffd)
+            return HTTP_FILE_SERVER_ERROR(500), -1;
         orig_st = st;
     }
 
@@ -239,10 +297,8 @@ int http_file_server_run2(struct http_file_server *fs, struct http_headers *head
     if (compressed && include_payload)
         vmbuf_strcpy(&ctx->header, "\r\nContent-Encoding: gzip");
     vmbuf_sprintf(&ctx->header, "\r\nCache-Control: max-age=%d", max_age);
-    time_t t = time(NULL);
-    gmtime_r(&t, &tm);
-    vmbuf_strftime(&ctx->header, "\r\nDate: %a, %d %b %Y %H:%M:%S GMT", &tm);
-    t += max_age;
+    /* Date is added by http_server_header_start() */
+    time_t t = ribs_clock_time() + max_age;
     gmtime_r(&t, &tm);
     vmbuf_strftime(&ctx->header, "\r\nExpires: %a, %d %b %Y %H:%M:%S GMT", &tm);
     gmtime_r(&orig_st.st_mtime, &tm);
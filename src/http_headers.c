@@ -103,7 +103,7 @@ static void http_header_decode_accept_encoding(struct http_headers *h) {
     }
 }
 
-void http_headers_parse(char *headers, struct http_headers *h) {
+static void http_headers_reset(struct http_headers *h) {
     static char no_value[] = { '-', 0 };
     *h = (struct http_headers) {
         no_value,
@@ -120,6 +120,10 @@ void http_headers_parse(char *headers, struct http_headers *h) {
         HTTP_AE_IDENTITY,
         { '-', 0 }
     };
+}
+
+void http_headers_parse(char *headers, struct http_headers *h) {
+    http_headers_reset(h);
     while (*headers) {
         char *p = strchrnul(headers, '\r'); // find the end
         if (*p) *p++ = 0;
@@ -132,3 +136,23 @@ void http_headers_parse(char *headers, struct http_headers *h) {
     }
     http_header_decode_accept_encoding(h);
 }
+
+void http_headers_parse_spans(char *buf, const struct http_parser *parser, struct http_headers *h) {
+    http_headers_reset(h);
+    char name[32];
+    const struct http_parser_header *ph = parser->headers, *ph_end = ph + parser->num_headers;
+    for (; ph != ph_end; ++ph) {
+        /* terminate the value in place, the byte after it is whitespace or CR/LF */
+        char *value = buf + ph->value.ofs;
+        value[ph->value.len] = 0;
+        if (ph->name.len >= sizeof(name))
+            continue; /* longer than any of ours */
+        uint32_t i;
+        for (i = 0; i < ph->name.len; ++i)
+            name[i] = tolower(buf[ph->name.ofs + i]);
+        uint32_t ofs = hashtable_lookup(&ht_request_headers, name, ph->name.len);
+        if (ofs)
+            *(char **)((char *)h + *(uint32_t *)hashtable_get_val(&ht_request_headers, ofs)) = value;
+    }
+    http_header_decode_accept_encoding(h);
+}
@@ -0,0 +1,396 @@
+/*
+    This file is part of RIBS2.0 (Robust Infrastructure for Backend Systems).
+    RIBS is an infrastructure for building great SaaS applications (but not
+    limited to).
+
+    Copyright (C) 2015 TrueSkills, Inc.
+
+    RIBS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, version 2.1 of the License.
+
+    RIBS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with RIBS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "http_parser.h"
+#include "sstr.h"
+#include <string.h>
+#include <strings.h>
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+enum {
+    HTTP_PARSER_STATE_REQUEST_LINE,
+    HTTP_PARSER_STATE_HEADERS,
+    HTTP_PARSER_STATE_DONE
+};
+
+struct http_parser_method {
+    const char *name;
+    uint32_t len;
+    int method;
+};
+
+static const struct http_parser_method methods[] = {
+    { "GET",     3, HTTP_METHOD_GET     },
+    { "HEAD",    4, HTTP_METHOD_HEAD    },
+    { "POST",    4, HTTP_METHOD_POST    },
+    { "PUT",     3, HTTP_METHOD_PUT     },
+    { "DELETE",  6, HTTP_METHOD_DELETE  },
+    { "OPTIONS", 7, HTTP_METHOD_OPTIONS },
+    { "PATCH",   5, HTTP_METHOD_PATCH   },
+    { "CONNECT", 7, HTTP_METHOD_CONNECT },
+    { "TRACE",   5, HTTP_METHOD_TRACE   },
+    /* terminate the list */
+    { NULL, 0, 0 }
+};
+
+/*
+ * first control character (< 0x20 or DEL) in [p, end), end if none.
+ * lines are made of printable characters, this finds the CR/LF and
+ * rejects garbage in a single pass.
+ */
+static const char *find_ctl_scalar(const char *p, const char *end) {
+    for (; p < end; ++p) {
+        unsigned char c = *p;
+        if (c < 0x20 || c == 0x7f)
+            break;
+    }
+    return p;
+}
+
+#ifdef __x86_64__
+static const char *find_ctl_sse2(const char *p, const char *end) {
+    const __m128i ctl = _mm_set1_epi8(0x1f), del = _mm_set1_epi8(0x7f);
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        /* unsigned v <= 0x1f or v == 0x7f */
+        __m128i m = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(v, ctl), v), _mm_cmpeq_epi8(v, del));
+        int mask = _mm_movemask_epi8(m);
+        if (mask)
+            return p + __builtin_ctz(mask);
+    }
+    return find_ctl_scalar(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char *find_ctl_avx2(const char *p, const char *end) {
+    const __m256i ctl = _mm256_set1_epi8(0x1f), del = _mm256_set1_epi8(0x7f);
+    for (; end - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        __m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(v, ctl), v), _mm256_cmpeq_epi8(v, del));
+        uint32_t mask = _mm256_movemask_epi8(m);
+        if (mask)
+            return p + __builtin_ctz(mask);
+    }
+    return find_ctl_sse2(p, end);
+}
+#endif
+
+static const char *(*find_ctl)(const char *p, const char *end) = NULL;
+
+static inline void select_find_ctl(void) {
+#ifdef __x86_64__
+    __builtin_cpu_init();
+    find_ctl = __builtin_cpu_supports("avx2") ? find_ctl_avx2 : find_ctl_sse2;
+#else
+    find_ctl = find_ctl_scalar;
+#endif
+}
+
+static inline int is_tchar(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+        (c && NULL != strchr("!#$%&'*+-.^_`|~", c));
+}
+
+static inline int is_ows(char c) {
+    return c == ' ' || c == '\t';
+}
+
+/* case insensitive match of a comma separated list element */
+static int has_token(const char *p, const char *end, const char *token, size_t token_len, int last_only) {
+    int found = 0;
+    while (p < end) {
+        const char *e = memchr(p, ',', end - p);
+        if (NULL == e)
+            e = end;
+        const char *s = p, *t = e;
+        for (; s < t && is_ows(*s); ++s);
+        for (; t > s && is_ows(t[-1]); --t);
+        found = ((size_t)(t - s) == token_len && 0 == strncasecmp(s, token, token_len));
+        if (found && !last_only)
+            return 1;
+        p = e + 1;
+    }
+    return found;
+}
+
+#define HEADER_IS(name, s, len) (SSTRLEN(name) == (len) && 0 == strncasecmp(name, s, len))
+
+static int parse_request_line(struct http_parser *parser, const char *buf, uint32_t eol) {
+    const char *line = buf + parser->line, *end = buf + eol;
+    const char *sp = memchr(line, ' ', end - line);
+    if (NULL == sp || sp == line)
+        return -1;
+    const struct http_parser_method *m;
+    parser->method = HTTP_METHOD_UNKNOWN;
+    for (m = methods; m->name; ++m) {
+        if (m->len == (uint32_t)(sp - line) && 0 == memcmp(m->name, line, m->len)) {
+            parser->method = m->method;
+            break;
+        }
+    }
+    parser->method_name = (struct http_parser_span){ parser->line, sp - line };
+    const char *uri = sp + 1;
+    sp = memchr(uri, ' ', end - uri);
+    if (NULL == sp)
+        sp = end; /* HTTP/1.0 clients used to omit the version */
+    if (sp == uri)
+        return -1;
+    parser->uri = (struct http_parser_span){ uri - buf, sp - uri };
+    if (sp == end) {
+        parser->version_minor = 0;
+        return 0;
+    }
+    static const char HTTP_1[] = "HTTP/1.";
+    const char *ver = sp + 1;
+    if ((size_t)(end - ver) != SSTRLEN(HTTP_1) + 1 || 0 != SSTRNCMP(HTTP_1, ver))
+        return -1;
+    char minor = ver[SSTRLEN(HTTP_1)];
+    if (minor < '0' || minor > '9')
+        return -1;
+    parser->version_minor = minor - '0';
+    return 0;
+}
+
+static int parse_header_line(struct http_parser *parser, const char *buf, uint32_t eol) {
+    const char *line = buf + parser->line, *end = buf + eol;
+    const char *p = line;
+    /* obsolete line folding is rejected (RFC 7230 3.2.4) */
+    for (; p < end && is_tchar(*p); ++p);
+    if (p == line || p == end || *p != ':')
+        return -1;
+    if (HTTP_PARSER_MAX_HEADERS == parser->num_headers)
+        return -1;
+    uint32_t name_len = p - line;
+    const char *v = p + 1, *ve = end;
+    for (; v < ve && is_ows(*v); ++v);
+    for (; ve > v && is_ows(ve[-1]); --ve);
+    uint32_t value_len = ve - v;
+    struct http_parser_header *h = parser->headers + parser->num_headers++;
+    h->name = (struct http_parser_span){ parser->line, name_len };
+    h->value = (struct http_parser_span){ v - buf, value_len };
+
+    if (HEADER_IS("content-length", line, name_len)) {
+        uint64_t n = 0;
+        if (v == ve)
+            return -1;
+        for (; v < ve; ++v) {
+            if (*v < '0' || *v > '9' || n > (UINT64_MAX - 9) / 10)
+                return -1;
+            n = n * 10 + (*v - '0');
+        }
+        /* repeated with a different value, RFC 7230 3.3.2 */
+        if ((parser->flags & HTTP_PARSER_CONTENT_LENGTH) && n != parser->content_length)
+            return -1;
+        parser->content_length = n;
+        parser->flags |= HTTP_PARSER_CONTENT_LENGTH;
+    } else if (HEADER_IS("transfer-encoding", line, name_len)) {
+        parser->flags |= HTTP_PARSER_TRANSFER_ENCODING;
+        /* the last one counts */
+        if (has_token(v, ve, "chunked", SSTRLEN("chunked"), 1))
+            parser->flags |= HTTP_PARSER_CHUNKED;
+        else
+            parser->flags &= ~HTTP_PARSER_CHUNKED;
+    } else if (HEADER_IS("connection", line, name_len)) {
+        if (has_token(v, ve, "close", SSTRLEN("close"), 0))
+            parser->flags |= HTTP_PARSER_CONNECTION_CLOSE;
+        if (has_token(v, ve, "keep-alive", SSTRLEN("keep-alive"), 0))
+            parser->flags |= HTTP_PARSER_KEEP_ALIVE;
+    } else if (HEADER_IS("expect", line, name_len)) {
+        if (HEADER_IS("100-continue", v, value_len))
+            parser->flags |= HTTP_PARSER_EXPECT_CONTINUE;
+    }
+    return 0;
+}
+
+void http_parser_init(struct http_parser *parser) {
+    if (NULL == find_ctl)
+        select_find_ctl();
+    parser->state = HTTP_PARSER_STATE_REQUEST_LINE;
+    parser->line = 0;
+    parser->pos = 0;
+    parser->method = HTTP_METHOD_UNKNOWN;
+    parser->version_minor = 0;
+    parser->method_name = parser->uri = (struct http_parser_span){ 0, 0 };
+    parser->headers_ofs = parser->headers_end = parser->header_len = 0;
+    parser->flags = 0;
+    parser->content_length = 0;
+    parser->num_headers = 0;
+}
+
+int http_parser_parse(struct http_parser *parser, const char *buf, size_t len) {
+    if (HTTP_PARSER_STATE_DONE == parser->state)
+        return HTTP_PARSER_DONE;
+    if (len > UINT32_MAX)
+        return HTTP_PARSER_ERROR;
+    const char *end = buf + len;
+    for (;;) {
+        const char *p = find_ctl(buf + parser->pos, end);
+        if (p == end) {
+            parser->pos = len;
+            return HTTP_PARSER_AGAIN;
+        }
+        if (*p == '\t') { /* allowed in header values */
+            parser->pos = p + 1 - buf;
+            continue;
+        }
+        uint32_t eol = p - buf;
+        uint32_t next;
+        if (*p == '\r') {
+            if (p + 1 == end) {
+                parser->pos = eol; /* wait for the LF */
+                return HTTP_PARSER_AGAIN;
+            }
+            if (p[1] != '\n')
+                return HTTP_PARSER_ERROR;
+            next = eol + 2;
+        } else if (*p == '\n')
+            next = eol + 1; /* tolerate a bare LF (RFC 7230 3.5) */
+        else
+            return HTTP_PARSER_ERROR;
+
+        if (HTTP_PARSER_STATE_REQUEST_LINE == parser->state) {
+            /* ignore empty lines before the request line (RFC 7230 3.5) */
+            if (eol != parser->line) {
+                if (0 > parse_request_line(parser, buf, eol))
+                    return HTTP_PARSER_ERROR;
+                parser->headers_ofs = next;
+                parser->headers_end = eol;
+                parser->state = HTTP_PARSER_STATE_HEADERS;
+            }
+        } else if (eol == parser->line) {
+            /* empty line, end of the header */
+            if ((parser->flags & HTTP_PARSER_TRANSFER_ENCODING) && (parser->flags & HTTP_PARSER_CONTENT_LENGTH))
+                return HTTP_PARSER_ERROR; /* ambiguous framing, RFC 7230 3.3.3 */
+            parser->header_len = next;
+            parser->line = parser->pos = next;
+            parser->state = HTTP_PARSER_STATE_DONE;
+            return HTTP_PARSER_DONE;
+        } else {
+            if (0 > parse_header_line(parser, buf, eol))
+                return HTTP_PARSER_ERROR;
+            parser->headers_end = eol;
+        }
+        parser->line = parser->pos = next;
+    }
+}
+
+#define HTTP_BODY_MAX_LINE 4096
+
+void http_body_decoder_init(struct http_body_decoder *decoder, const struct http_parser *parser) {
+    decoder->rpos = decoder->wpos = parser->header_len;
+    if (parser->flags & HTTP_PARSER_CHUNKED) {
+        decoder->state = HTTP_BODY_CHUNK_SIZE;
+        decoder->left = 0;
+    } else {
+        decoder->left = (parser->flags & HTTP_PARSER_CONTENT_LENGTH) ? parser->content_length : 0;
+        decoder->state = decoder->left ? HTTP_BODY_IDENTITY : HTTP_BODY_DONE;
+    }
+}
+
+/* end of the line starting at rpos, returns the offset past the LF,
+   0 when incomplete and -1 when too long */
+static inline int64_t body_line(struct http_body_decoder *decoder, const char *buf, size_t len, const char **eol) {
+    const char *p = buf + decoder->rpos;
+    const char *lf = memchr(p, '\n', len - decoder->rpos);
+    if (NULL == lf)
+        return len - decoder->rpos > HTTP_BODY_MAX_LINE ? -1 : 0;
+    *eol = (lf > p && lf[-1] == '\r') ? lf - 1 : lf;
+    return lf + 1 - buf;
+}
+
+int http_body_decode(struct http_body_decoder *decoder, char *buf, size_t len) {
+    const char *eol;
+    int64_t next;
+    while (decoder->rpos < len || HTTP_BODY_DONE == decoder->state) {
+        switch (decoder->state) {
+        case HTTP_BODY_IDENTITY:
+        case HTTP_BODY_CHUNK_DATA:
+            {
+                uint64_t n = len - decoder->rpos;
+                if (n > decoder->left)
+                    n = decoder->left;
+                if (decoder->wpos != decoder->rpos)
+                    memmove(buf + decoder->wpos, buf + decoder->rpos, n);
+                decoder->rpos += n;
+                decoder->wpos += n;
+                decoder->left -= n;
+                if (0 < decoder->left)
+                    return HTTP_PARSER_AGAIN;
+                decoder->state = HTTP_BODY_IDENTITY == decoder->state ? HTTP_BODY_DONE : HTTP_BODY_CHUNK_END;
+            }
+            break;
+        case HTTP_BODY_CHUNK_SIZE:
+            if (0 >= (next = body_line(decoder, buf, len, &eol)))
+                return next ? HTTP_PARSER_ERROR : HTTP_PARSER_AGAIN;
+            {
+                const char *p = buf + decoder->rpos;
+                uint64_t size = 0;
+                for (; p < eol; ++p) {
+                    int d;
+                    if (*p >= '0' && *p <= '9')
+                        d = *p - '0';
+                    else if ((*p | 0x20) >= 'a' && (*p | 0x20) <= 'f')
+                        d = (*p | 0x20) - 'a' + 10;
+                    else
+                        break;
+                    if (size >> 59)
+                        return HTTP_PARSER_ERROR;
+                    size = (size << 4) | d;
+                }
+                /* at least one digit, then optional extensions */
+                if (p == buf + decoder->rpos || (p < eol && *p != ';' && !is_ows(*p)))
+                    return HTTP_PARSER_ERROR;
+                decoder->left = size;
+                decoder->rpos = next;
+                decoder->state = size ? HTTP_BODY_CHUNK_DATA : HTTP_BODY_TRAILER;
+            }
+            break;
+        case HTTP_BODY_CHUNK_END:
+            if (0 >= (next = body_line(decoder, buf, len, &eol)))
+                return next ? HTTP_PARSER_ERROR : HTTP_PARSER_AGAIN;
+            if (eol != buf + decoder->rpos)
+                return HTTP_PARSER_ERROR; /* data past the chunk size */
+            decoder->rpos = next;
+            decoder->state = HTTP_BODY_CHUNK_SIZE;
+            break;
+        case HTTP_BODY_TRAILER:
+            /* trailer fields are ignored, up to the empty line */
+            if (0 >= (next = body_line(decoder, buf, len, &eol)))
+                return next ? HTTP_PARSER_ERROR : HTTP_PARSER_AGAIN;
+            if (eol == buf + decoder->rpos)
+                decoder->state = HTTP_BODY_DONE;
+            decoder->rpos = next;
+            break;
+        case HTTP_BODY_DONE:
+            return HTTP_PARSER_DONE;
+        }
+    }
+    return HTTP_PARSER_AGAIN;
+}
+
+const struct http_parser_span *http_parser_find_header(const struct http_parser *parser, const char *buf, const char *name) {
+    size_t len = strlen(name);
+    const struct http_parser_header *h = parser->headers, *h_end = h + parser->num_headers;
+    for (; h != h_end; ++h)
+        if (h->name.len == len && 0 == strncasecmp(buf + h->name.ofs, name, len))
+            return &h->value;
+    return NULL;
+}
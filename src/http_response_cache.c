@@ -0,0 +1,401 @@
+/*
+    This file is part of RIBS2.0 (Robust Infrastructure for Backend Systems).
+    RIBS is an infrastructure for building great SaaS applications (but not
+    limited to).
+
+    Copyright (C) 2015 TrueSkills, Inc.
+
+    RIBS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, version 2.1 of the License.
+
+    RIBS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with RIBS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "http_response_cache.h"
+#include "http_server.h"
+#include "ribs_clock.h"
+#include "logger.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <sys/uio.h>
+
+#define MAX_KEY_SIZE 4096
+#define MAX_VARY_SIZE 256
+#define MAX_URI_RECORDS 4096 /* Vary and not stored, forgotten all at once past that */
+#define DEFAULT_COALESCE_TIMEOUT 10000
+
+struct http_response_cache_entry {
+    struct list lru;
+    uint32_t refs; /* the cache and the ribbons sending it */
+    uint64_t created; /* msec, ribs_clock_msec() */
+    uint64_t expires;
+    uint32_t key_len;
+    uint32_t head_len; /* status line and headers, without the final CRLF */
+    uint32_t body_len;
+    char data[]; /* key, head, body */
+};
+
+/* request being generated, identical ones wait for it */
+struct http_response_cache_pending {
+    struct ribs_cond cond;
+    int waiters;
+    int done;
+};
+
+static inline size_t entry_size(struct http_response_cache_entry *e) {
+    return sizeof(struct http_response_cache_entry) + e->key_len + e->head_len + e->body_len;
+}
+
+static void entry_put(struct http_response_cache_entry *e) {
+    if (0 == --e->refs)
+        free(e);
+}
+
+static void entry_remove(struct http_response_cache *cache, struct http_response_cache_entry *e) {
+    hashtable_remove(&cache->ht_entries, e->data, e->key_len);
+    list_remove(&e->lru);
+    cache->bytes -= entry_size(e);
+    entry_put(e);
+}
+
+int http_response_cache_init(struct http_response_cache *cache, size_t max_bytes, time_t default_ttl) {
+    memset(cache, 0, sizeof(struct http_response_cache));
+    cache->max_bytes = max_bytes;
+    cache->default_ttl = default_ttl;
+    cache->coalesce_timeout = DEFAULT_COALESCE_TIMEOUT;
+    list_init(&cache->lru);
+    ribs_mutex_init(&cache->mutex);
+    if (0 > hashtable_init(&cache->ht_entries, 0) ||
+        0 > hashtable_init(&cache->ht_vary, 0) ||
+        0 > hashtable_init(&cache->ht_not_stored, 0) ||
+        0 > hashtable_init(&cache->ht_pending, 0))
+        return LOGGER_ERROR("failed to initialize response cache"), -1;
+    return 0;
+}
+
+void http_response_cache_purge(struct http_response_cache *cache) {
+    while (!list_empty(&cache->lru))
+        entry_remove(cache, LIST_ENTRY(list_tail(&cache->lru), struct http_response_cache_entry, lru));
+}
+
+void http_response_cache_free(struct http_response_cache *cache) {
+    http_response_cache_purge(cache);
+    hashtable_free(&cache->ht_entries);
+    hashtable_free(&cache->ht_vary);
+    hashtable_free(&cache->ht_not_stored);
+    hashtable_free(&cache->ht_pending);
+    vmbuf_free(&cache->scratch);
+}
+
+/*
+ * keys
+ */
+static size_t key_base(struct http_server_context *ctx, char *key) {
+    const struct http_parser_span *m = &ctx->parser.method_name;
+    int n = snprintf(key, MAX_KEY_SIZE, "%.*s %s%s%s", (int)m->len, vmbuf_data(&ctx->request) + m->ofs,
+                     ctx->uri, *ctx->query ? "?" : "", ctx->query);
+    return MAX_KEY_SIZE > n ? (size_t)n : 0;
+}
+
+/* the request's values of the comma separated header names */
+static size_t key_add_vary(struct http_server_context *ctx, char *key, size_t len, const char *vary) {
+    const char *data = vmbuf_data(&ctx->request);
+    char name[MAX_VARY_SIZE];
+    while (*vary) {
+        const char *p = strchrnul(vary, ',');
+        memcpy(name, vary, p - vary);
+        name[p - vary] = 0;
+        vary = *p ? p + 1 : p;
+        const struct http_parser_span *v = http_parser_find_header(&ctx->parser, data, name);
+        if (NULL == v) {
+            if (len + 1 >= MAX_KEY_SIZE)
+                return 0;
+            key[len++] = '\r'; /* absent, not the same as empty */
+            continue;
+        }
+        if (len + 1 + v->len >= MAX_KEY_SIZE)
+            return 0;
+        key[len++] = '\n';
+        memcpy(key + len, data + v->ofs, v->len);
+        len += v->len;
+    }
+    return len;
+}
+
+/* the full key, as of what is known about the URI's Vary */
+static size_t key_make(struct http_response_cache *cache, struct http_server_context *ctx, char *key, size_t base_len) {
+    uint32_t ofs = hashtable_lookup(&cache->ht_vary, key, base_len);
+    if (0 == ofs)
+        return base_len;
+    return key_add_vary(ctx, key, base_len, hashtable_get_val(&cache->ht_vary, ofs));
+}
+
+/*
+ * responses
+ */
+static int cacheable_status(const char *status) {
+    static const char *statuses[] = { "200", "203", "204", "300", "301", "308", "404", "405", "410", "414", "501" };
+    size_t i;
+    for (i = 0; i < sizeof(statuses) / sizeof(statuses[0]); ++i)
+        if (0 == memcmp(status, statuses[i], 3))
+            return 1;
+    return 0;
+}
+
+static inline int header_is(const char *line, size_t name_len, const char *name) {
+    return strlen(name) == name_len && 0 == strncasecmp(line, name, name_len);
+}
+
+static const char *skip_ows(const char *p, const char *end) {
+    for (; p < end && (' ' == *p || '\t' == *p); ++p);
+    return p;
+}
+
+/* msec, 0 when it must not be stored */
+static time_t response_ttl(const char *p, const char *end, time_t ttl) {
+    time_t max_age = -1, s_maxage = -1;
+    while (p < end) {
+        p = skip_ows(p, end);
+        const char *e = p;
+        for (; e < end && ',' != *e; ++e);
+        size_t len = e - p;
+        if ((8 == len && 0 == strncasecmp(p, "no-store", 8)) ||
+            (8 == len && 0 == strncasecmp(p, "no-cache", 8)) ||
+            (7 == len && 0 == strncasecmp(p, "private", 7)))
+            return 0;
+        if (8 < len && 0 == strncasecmp(p, "max-age=", 8))
+            max_age = strtol(p + 8, NULL, 10);
+        else if (9 < len && 0 == strncasecmp(p, "s-maxage=", 9))
+            s_maxage = strtol(p + 9, NULL, 10);
+        p = e + 1;
+    }
+    if (0 <= s_maxage)
+        return s_maxage * 1000;
+    if (0 <= max_age)
+        return max_age * 1000;
+    return ttl;
+}
+
+/* lower case, no whitespace */
+static int add_vary(char *vary, size_t *vary_len, const char *p, const char *end) {
+    while (p < end) {
+        p = skip_ows(p, end);
+        const char *e = p;
+        for (; e < end && ',' != *e; ++e);
+        const char *t = e;
+        for (; t > p && (' ' == t[-1] || '\t' == t[-1]); --t);
+        if (1 == t - p && '*' == *p)
+            return -1;
+        if (t > p) {
+            if (*vary_len + (t - p) + 2 > MAX_VARY_SIZE)
+                return -1;
+            if (*vary_len)
+                vary[(*vary_len)++] = ',';
+            for (; p < t; ++p)
+                vary[(*vary_len)++] = tolower(*p);
+        }
+        p = e + 1;
+    }
+    vary[*vary_len] = 0;
+    return 0;
+}
+
+/* 0 when stored */
+static int store(struct http_response_cache *cache, struct http_server_context *ctx, char *key, size_t base_len) {
+    /* streamed, sent with sendfile or already sent */
+    size_t header_len = vmbuf_wlocpos(&ctx->header);
+    if (ctx->stream || 16 > header_len)
+        return -1;
+    const char *header = vmbuf_data(&ctx->header);
+    const char *header_end = header + header_len - 4;
+    if (0 != memcmp(header_end, "\r\n\r\n", 4) || ' ' != header[8] || !cacheable_status(header + 9))
+        return -1;
+    time_t ttl = cache->default_ttl;
+    char vary[MAX_VARY_SIZE];
+    size_t vary_len = 0;
+    vary[0] = 0;
+    /* the head without Connection, it is per request. Not on the
+       stack, the handler decides how large it is */
+    if (0 > vmbuf_init(&cache->scratch, header_len) || (size_t)-1 == vmbuf_alloc(&cache->scratch, header_len))
+        return -1;
+    char *head = vmbuf_data(&cache->scratch);
+    const char *line = memchr(header, '\n', header_len) + 1;
+    size_t head_len = line - 2 - header;
+    memcpy(head, header, head_len);
+    while (line < header_end + 2) {
+        const char *eol = memmem(line, header_end + 2 - line, "\r\n", 2);
+        const char *colon = memchr(line, ':', eol - line);
+        if (NULL != colon) {
+            size_t name_len = colon - line;
+            const char *value = colon + 1;
+            if (header_is(line, name_len, "connection"))
+                goto next;
+            if (header_is(line, name_len, "set-cookie"))
+                return -1;
+            if (header_is(line, name_len, "cache-control") && 0 == (ttl = response_ttl(value, eol, ttl)))
+                return -1;
+            if (header_is(line, name_len, "vary") && 0 > add_vary(vary, &vary_len, value, eol))
+                return -1;
+        }
+        memcpy(head + head_len, line - 2, eol - line + 2);
+        head_len += eol - line + 2;
+    next:
+        line = eol + 2;
+    }
+    if (0 >= ttl)
+        return -1;
+    /* remember how this URI varies */
+    uint32_t ofs = hashtable_lookup(&cache->ht_vary, key, base_len);
+    if (0 == ofs || 0 != strcmp(hashtable_get_val(&cache->ht_vary, ofs), vary)) {
+        if (0 < ofs)
+            hashtable_remove(&cache->ht_vary, key, base_len);
+        if (MAX_URI_RECORDS <= hashtable_get_size(&cache->ht_vary)) {
+            hashtable_free(&cache->ht_vary);
+            hashtable_init(&cache->ht_vary, 0);
+        }
+        if (vary_len)
+            hashtable_insert(&cache->ht_vary, key, base_len, vary, vary_len + 1);
+    }
+    size_t key_len = key_add_vary(ctx, key, base_len, vary);
+    if (0 == key_len)
+        return -1;
+    size_t body_len = vmbuf_wlocpos(&ctx->payload);
+    size_t size = sizeof(struct http_response_cache_entry) + key_len + head_len + body_len;
+    if (size > cache->max_bytes)
+        return -1;
+    ofs = hashtable_lookup(&cache->ht_entries, key, key_len);
+    if (0 < ofs)
+        entry_remove(cache, *(struct http_response_cache_entry **)hashtable_get_val(&cache->ht_entries, ofs));
+    while (cache->bytes + size > cache->max_bytes) {
+        entry_remove(cache, LIST_ENTRY(list_tail(&cache->lru), struct http_response_cache_entry, lru));
+        ++cache->stats.evictions;
+    }
+    struct http_response_cache_entry *e = malloc(size);
+    if (NULL == e) {
+        LOGGER_PERROR("malloc");
+        return -1;
+    }
+    e->refs = 1;
+    e->created = ribs_clock_msec();
+    e->expires = e->created + ttl;
+    e->key_len = key_len;
+    e->head_len = head_len;
+    e->body_len = body_len;
+    memcpy(e->data, key, key_len);
+    memcpy(e->data + key_len, head, head_len);
+    memcpy(e->data + key_len + head_len, vmbuf_data(&ctx->payload), body_len);
+    hashtable_insert(&cache->ht_entries, key, key_len, &e, sizeof(e));
+    list_insert_head(&cache->lru, &e->lru);
+    cache->bytes += size;
+    ++cache->stats.stores;
+    return 0;
+}
+
+static void send_entry(struct http_server_context *ctx, struct http_response_cache_entry *e) {
+    char tail[64];
+    int n = snprintf(tail, sizeof(tail), "\r\nAge: %jd\r\nConnection: %s\r\n\r\n",
+                     (intmax_t)(ribs_clock_msec() - e->created) / 1000, ctx->persistent ? "Keep-Alive" : "close");
+    struct iovec iov[3] = {
+        { e->data + e->key_len, e->head_len },
+        { tail, n },
+        { e->data + e->key_len + e->head_len, e->body_len }
+    };
+    /* may yield, the entry can be evicted meanwhile */
+    ++e->refs;
+    http_server_writev(iov, 3);
+    entry_put(e);
+}
+
+/* requests which the response doesn't depend on only */
+static int bypass(struct http_server_context *ctx) {
+    if (HTTP_METHOD_GET != ctx->parser.method && HTTP_METHOD_HEAD != ctx->parser.method)
+        return 1;
+    return NULL != http_parser_find_header(&ctx->parser, vmbuf_data(&ctx->request), "authorization");
+}
+
+/* such URIs are not coalesced, the wait would be for nothing */
+static void set_not_stored(struct http_response_cache *cache, const char *key, size_t base_len, int not_stored) {
+    uint32_t ofs = hashtable_lookup(&cache->ht_not_stored, key, base_len);
+    if (!not_stored) {
+        if (0 < ofs)
+            hashtable_remove(&cache->ht_not_stored, key, base_len);
+        return;
+    }
+    if (0 < ofs)
+        return;
+    if (MAX_URI_RECORDS <= hashtable_get_size(&cache->ht_not_stored)) {
+        hashtable_free(&cache->ht_not_stored);
+        hashtable_init(&cache->ht_not_stored, 0);
+    }
+    hashtable_insert(&cache->ht_not_stored, key, base_len, "", 1);
+}
+
+static void wait_pending(struct http_response_cache *cache, struct http_response_cache_pending *p) {
+    ++p->waiters;
+    ribs_mutex_lock(&cache->mutex, -1);
+    ribs_cond_wait(&p->cond, &cache->mutex, cache->coalesce_timeout);
+    ribs_mutex_unlock(&cache->mutex);
+    if (0 == --p->waiters && p->done)
+        free(p);
+}
+
+void http_response_cache_serve(struct http_response_cache *cache, void (*handler)(void)) {
+    struct http_server_context *ctx = http_server_get_context();
+    if (bypass(ctx))
+        return handler();
+    char key[MAX_KEY_SIZE];
+    size_t base_len = key_base(ctx, key);
+    if (0 == base_len)
+        return handler();
+    size_t key_len;
+    int not_stored = 0 < hashtable_lookup(&cache->ht_not_stored, key, base_len);
+    int waited = 0;
+    for (;;) {
+        /* the Vary may be known by now */
+        if (0 == (key_len = key_make(cache, ctx, key, base_len)))
+            return handler();
+        uint32_t ofs = hashtable_lookup(&cache->ht_entries, key, key_len);
+        if (0 < ofs) {
+            struct http_response_cache_entry *e = *(struct http_response_cache_entry **)hashtable_get_val(&cache->ht_entries, ofs);
+            if (e->expires > ribs_clock_msec()) {
+                ++cache->stats.hits;
+                list_make_first(&cache->lru, &e->lru);
+                return send_entry(ctx, e);
+            }
+            entry_remove(cache, e);
+        }
+        ofs = hashtable_lookup(&cache->ht_pending, key, key_len);
+        /* waited already and it didn't match, generate our own */
+        if (0 == ofs || waited || not_stored)
+            break;
+        ++cache->stats.coalesced;
+        wait_pending(cache, *(struct http_response_cache_pending **)hashtable_get_val(&cache->ht_pending, ofs));
+        waited = 1;
+    }
+    ++cache->stats.misses;
+    struct http_response_cache_pending *p = NULL;
+    if (!not_stored && 0 == hashtable_lookup(&cache->ht_pending, key, key_len) &&
+        NULL != (p = calloc(1, sizeof(struct http_response_cache_pending)))) {
+        ribs_cond_init(&p->cond);
+        hashtable_insert(&cache->ht_pending, key, key_len, &p, sizeof(p));
+    }
+    char pending_key[key_len];
+    memcpy(pending_key, key, key_len);
+    handler();
+    set_not_stored(cache, key, base_len, 0 > store(cache, ctx, key, base_len));
+    if (NULL == p)
+        return;
+    hashtable_remove(&cache->ht_pending, pending_key, key_len);
+    p->done = 1;
+    ribs_cond_broadcast(&p->cond);
+    if (0 == p->waiters)
+        free(p);
+}
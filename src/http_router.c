@@ -0,0 +1,260 @@
+/*
+    This file is part of RIBS2.0 (Robust Infrastructure for Backend Systems).
+    RIBS is an infrastructure for building great SaaS applications (but not
+    limited to).
+
+    Copyright (C) 2015 TrueSkills, Inc.
+
+    RIBS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, version 2.1 of the License.
+
+    RIBS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with RIBS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "http_router.h"
+#include "http_server.h"
+#include "http_defs.h"
+#include "logger.h"
+
+/* nodes are addressed by index, the root is node 0 which is never a
+   child, so 0 also means none */
+struct http_router_node {
+    uint32_t prefix_ofs; /* static text, in strings */
+    uint32_t prefix_len;
+    uint32_t name_ofs; /* :name and *name nodes */
+    uint32_t name_len;
+    uint32_t child; /* static children, distinct first chars */
+    uint32_t next;
+    uint32_t param_child;
+    uint32_t wildcard_child;
+    void (*handlers[HTTP_ROUTER_NUM_METHODS])(void);
+};
+
+#define NODE(router, idx) ((struct http_router_node *)(router)->nodes.mem + (idx))
+#define STR(router, ofs) ((const char *)(router)->strings.mem + (ofs))
+
+static int64_t node_new(struct http_router *router) {
+    size_t ofs = vmbuf_alloczero(&router->nodes, sizeof(struct http_router_node));
+    if ((size_t)-1 == ofs)
+        return LOGGER_ERROR("failed to allocate router node"), -1;
+    return ofs / sizeof(struct http_router_node);
+}
+
+static int64_t string_add(struct http_router *router, const char *s, size_t len) {
+    size_t ofs = vmbuf_alloc(&router->strings, len);
+    if ((size_t)-1 == ofs)
+        return LOGGER_ERROR("failed to allocate router string"), -1;
+    memcpy(vmbuf_data_ofs(&router->strings, ofs), s, len);
+    return ofs;
+}
+
+int http_router_init(struct http_router *router) {
+    if (0 > vmbuf_init(&router->nodes, 64 * sizeof(struct http_router_node)) ||
+        0 > vmbuf_init(&router->strings, 4096) ||
+        0 > node_new(router))
+        return -1;
+    return 0;
+}
+
+void http_router_free(struct http_router *router) {
+    vmbuf_free(&router->nodes);
+    vmbuf_free(&router->strings);
+}
+
+/* split node idx after k chars of its prefix, the tail keeps the
+   children and handlers */
+static int64_t node_split(struct http_router *router, uint32_t idx, uint32_t k) {
+    int64_t tail = node_new(router);
+    if (0 > tail)
+        return -1;
+    struct http_router_node *n = NODE(router, idx), *t = NODE(router, tail);
+    *t = *n;
+    t->prefix_ofs += k;
+    t->prefix_len -= k;
+    t->next = 0;
+    n->prefix_len = k;
+    n->child = tail;
+    n->param_child = n->wildcard_child = 0;
+    memset(n->handlers, 0, sizeof(n->handlers));
+    return 0;
+}
+
+/* walk/extend the static path s below idx, returns the node where it ends */
+static int64_t insert_static(struct http_router *router, uint32_t idx, const char *s, size_t len) {
+    while (len > 0) {
+        uint32_t c = NODE(router, idx)->child;
+        while (c && *STR(router, NODE(router, c)->prefix_ofs) != *s)
+            c = NODE(router, c)->next;
+        if (0 == c) {
+            int64_t str = string_add(router, s, len);
+            int64_t n = str < 0 ? -1 : node_new(router);
+            if (0 > n)
+                return -1;
+            NODE(router, n)->prefix_ofs = str;
+            NODE(router, n)->prefix_len = len;
+            NODE(router, n)->next = NODE(router, idx)->child;
+            NODE(router, idx)->child = n;
+            return n;
+        }
+        const char *prefix = STR(router, NODE(router, c)->prefix_ofs);
+        uint32_t prefix_len = NODE(router, c)->prefix_len, k = 1;
+        while (k < prefix_len && k < len && prefix[k] == s[k])
+            ++k;
+        if (k < prefix_len && 0 > node_split(router, c, k))
+            return -1;
+        s += k;
+        len -= k;
+        idx = c;
+    }
+    return idx;
+}
+
+static int64_t insert_var(struct http_router *router, uint32_t idx, int wildcard, const char *name, size_t len, const char *pattern) {
+    uint32_t child = wildcard ? NODE(router, idx)->wildcard_child : NODE(router, idx)->param_child;
+    if (child) {
+        struct http_router_node *n = NODE(router, child);
+        if (n->name_len != len || 0 != memcmp(STR(router, n->name_ofs), name, len))
+            return LOGGER_ERROR("%s: conflicting parameter name '%.*s'", pattern, (int)len, name), -1;
+        return child;
+    }
+    int64_t str = string_add(router, name, len);
+    int64_t n = str < 0 ? -1 : node_new(router);
+    if (0 > n)
+        return -1;
+    NODE(router, n)->name_ofs = str;
+    NODE(router, n)->name_len = len;
+    if (wildcard)
+        NODE(router, idx)->wildcard_child = n;
+    else
+        NODE(router, idx)->param_child = n;
+    return n;
+}
+
+int http_router_add(struct http_router *router, int method, const char *pattern, void (*handler)(void)) {
+    if (0 > method || HTTP_ROUTER_NUM_METHODS <= method || '/' != *pattern)
+        return LOGGER_ERROR("%s: invalid route", pattern), -1;
+    int64_t idx = 0;
+    int num_params = 0;
+    const char *p = pattern;
+    while (*p) {
+        const char *end;
+        /* :name and *name only at the start of a segment */
+        if ((':' == *p || '*' == *p) && '/' == p[-1]) {
+            int wildcard = '*' == *p;
+            end = strchrnul(p + 1, '/');
+            if (end == p + 1 || (wildcard && *end))
+                return LOGGER_ERROR("%s: invalid parameter", pattern), -1;
+            if (HTTP_ROUTER_MAX_PARAMS < ++num_params)
+                return LOGGER_ERROR("%s: more than %d parameters", pattern, HTTP_ROUTER_MAX_PARAMS), -1;
+            idx = insert_var(router, idx, wildcard, p + 1, end - p - 1, pattern);
+        } else {
+            for (end = p + 1; *end && !((':' == *end || '*' == *end) && '/' == end[-1]); ++end);
+            idx = insert_static(router, idx, p, end - p);
+        }
+        if (0 > idx)
+            return -1;
+        p = end;
+    }
+    struct http_router_node *n = NODE(router, idx);
+    if (n->handlers[method])
+        return LOGGER_ERROR("%s: route already exists", pattern), -1;
+    n->handlers[method] = handler;
+    return 0;
+}
+
+static void (*node_handler(const struct http_router_node *n, int method, int *path_found))(void) {
+    void (*h)(void) = n->handlers[method];
+    if (!h && HTTP_METHOD_HEAD == method)
+        h = n->handlers[HTTP_METHOD_GET];
+    if (!h)
+        h = n->handlers[HTTP_ROUTER_ANY_METHOD];
+    if (!h) {
+        int i;
+        for (i = 0; i < HTTP_ROUTER_NUM_METHODS && !*path_found; ++i)
+            *path_found = NULL != n->handlers[i];
+    }
+    return h;
+}
+
+static void (*match_node(const struct http_router *router, uint32_t idx, int method, const char *path, size_t len, struct http_router_match *match, int *path_found))(void) {
+    const struct http_router_node *n = NODE(router, idx);
+    void (*h)(void);
+    if (0 == len && NULL != (h = node_handler(n, method, path_found)))
+        return h;
+    if (len > 0) {
+        uint32_t c;
+        for (c = n->child; c; c = NODE(router, c)->next) {
+            const struct http_router_node *cn = NODE(router, c);
+            const char *prefix = STR(router, cn->prefix_ofs);
+            if (*prefix != *path)
+                continue;
+            if (cn->prefix_len <= len && 0 == memcmp(prefix, path, cn->prefix_len) &&
+                NULL != (h = match_node(router, c, method, path + cn->prefix_len, len - cn->prefix_len, match, path_found)))
+                return h;
+            break;
+        }
+    }
+    if (match->num_params == HTTP_ROUTER_MAX_PARAMS)
+        return NULL;
+    struct http_router_param *param = match->params + match->num_params;
+    if (n->param_child && len > 0 && '/' != *path) {
+        const struct http_router_node *pn = NODE(router, n->param_child);
+        const char *end = memchr(path, '/', len);
+        size_t value_len = end ? (size_t)(end - path) : len;
+        *param = (struct http_router_param){ STR(router, pn->name_ofs), pn->name_len, path, value_len };
+        ++match->num_params;
+        if (NULL != (h = match_node(router, n->param_child, method, path + value_len, len - value_len, match, path_found)))
+            return h;
+        --match->num_params;
+    }
+    if (n->wildcard_child) {
+        const struct http_router_node *wn = NODE(router, n->wildcard_child);
+        if (NULL != (h = node_handler(wn, method, path_found))) {
+            *param = (struct http_router_param){ STR(router, wn->name_ofs), wn->name_len, path, len };
+            ++match->num_params;
+            return h;
+        }
+    }
+    return NULL;
+}
+
+int http_router_match(const struct http_router *router, int method, const char *path, size_t len, struct http_router_match *match) {
+    int path_found = 0;
+    if (0 > method || HTTP_ROUTER_NUM_METHODS <= method)
+        method = HTTP_METHOD_UNKNOWN;
+    match->num_params = 0;
+    match->handler = match_node(router, 0, method, path, len, match, &path_found);
+    if (match->handler)
+        return HTTP_ROUTER_MATCH;
+    match->num_params = 0;
+    return path_found ? HTTP_ROUTER_METHOD_NOT_ALLOWED : HTTP_ROUTER_NOT_FOUND;
+}
+
+const struct http_router_param *http_router_get_param(const struct http_router_match *match, const char *name) {
+    size_t len = strlen(name);
+    uint32_t i;
+    for (i = 0; i < match->num_params; ++i) {
+        const struct http_router_param *param = match->params + i;
+        if (param->name_len == len && 0 == memcmp(param->name, name, len))
+            return param;
+    }
+    return NULL;
+}
+
+void http_router_run(struct http_router *router) {
+    struct http_server_context *ctx = http_server_get_context();
+    switch (http_router_match(router, ctx->parser.method, ctx->uri, strlen(ctx->uri), &ctx->route)) {
+    case HTTP_ROUTER_MATCH:
+        return ctx->route.handler();
+    case HTTP_ROUTER_METHOD_NOT_ALLOWED:
+        return http_server_response_sprintf(HTTP_STATUS_405, HTTP_CONTENT_TYPE_TEXT_PLAIN, "%s\n", HTTP_STATUS_405);
+    default:
+        return http_server_response_sprintf(HTTP_STATUS_404, HTTP_CONTENT_TYPE_TEXT_PLAIN, "%s\n", HTTP_STATUS_404);
+    }
+}
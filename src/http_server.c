@@ -22,6 +22,9 @@
 #include <dirent.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <sys/un.h>
+#include <linux/filter.h>
+#include <sched.h>
 #include <arpa/inet.h>
 #include <netinet/tcp.h>
 #include <fcntl.h>
@@ -36,8 +39,14 @@
 #include <sys/resource.h>
 #include <sys/uio.h>
 #include <sys/sendfile.h>
+#include <poll.h>
 #include "mime_types.h"
 #include "logger.h"
+#include "ribs_uring.h"
+#include "timer_worker.h"
+#include "ribs_clock.h"
+#include "daemonize.h"
+#include "http_response_cache.h"
 #define HTTP_DEF_STR(var,str)                   \
     const char var[]=str
 #include "http_defs.h"
@@ -47,15 +56,21 @@
 #endif
 
 #define ACCEPTOR_STACK_SIZE 8192
-#define MIN_HTTP_REQ_SIZE 5 // method(3) + space(1) + URI(1) + optional VER...
+#define STACK_TRIM_STACK_SIZE (64*1024)
 #define DEFAULT_MAX_REQ_SIZE 1024*1024*1024
 #define DEFAULT_NUM_STACKS 64
+#define DEFAULT_ACCEPT_BUDGET 64
+#define STREAM_FLUSH_SIZE (16*1024)
+#define LISTEN_BACKLOG 32768
+#define HTTP_SERVER_ADDRSTRLEN 128 /* "unix:" + sun_path, "[ipv6]:port" */
+
+/* ctx->stream */
+#define STREAM_ACTIVE      0x01
+#define STREAM_CHUNKED     0x02
+#define STREAM_NO_BODY     0x04 /* HEAD */
+#define STREAM_HEADER_SENT 0x08
+#define STREAM_FAILED      0x10
 
-/* methods */
-SSTRL(HEAD, "HEAD " );
-SSTRL(GET,  "GET "  );
-SSTRL(POST, "POST " );
-SSTRL(PUT,  "PUT "  );
 /* misc */
 SSTRL(HTTP_SERVER_VER, "HTTP/1.1");
 SSTRL(HTTP_SERVER_NAME, "ribs2.0");
@@ -65,6 +80,8 @@ SSTRL(CONNECTION, "\r\nConnection: ");
 SSTRL(CONNECTION_CLOSE, "close");
 SSTRL(CONNECTION_KEEPALIVE, "Keep-Alive");
 SSTRL(CONTENT_LENGTH, "\r\nContent-Length: ");
+SSTRL(TRANSFER_ENCODING_CHUNKED, "\r\nTransfer-Encoding: chunked");
+SSTRL(LAST_CHUNK, "0\r\n\r\n");
 SSTRL(SET_COOKIE, "\r\nSet-Cookie: ");
 SSTRL(COOKIE_VERSION, "Version=\"1\"");
 SSTRL(HTTP_LOCATION, "\r\nLocation: ");
@@ -73,10 +90,11 @@ SSTR(PRAGMA, "\r\nPragma: ");
 SSTR(EXPIRES, "\r\nExpires: ");
 /* 1xx */
 SSTRL(HTTP_STATUS_100, "100 Continue");
-SSTRL(EXPECT_100, "\r\nExpect: 100");
 
-static int accept_reserved_fd = -1;
+static _RIBS_THREAD_LOCAL_ int accept_reserved_fd = -1;
 static inline void http_server_yield(void);
+static inline int http_server_yield_write_timeout(void);
+static inline int http_server_yield_write(void);
 
 static int _http_server_read(struct http_server_context *ctx) {
     ssize_t res;
@@ -98,12 +116,10 @@ static int _http_server_write(struct http_server_context *ctx) {
         { vmbuf_data(&ctx->payload), vmbuf_wlocpos(&ctx->payload)}
     };
     ssize_t num_write;
-    for (;;http_server_yield()) {
+    for (;;) {
         num_write = writev(ctx->fd, iovec, iovec[1].iov_len ? 2 : 1);
         if (0 > num_write) {
-            if (EAGAIN == errno) {
-                continue;
-            } else {
+            if (EAGAIN != errno) {
                 ctx->persistent = 0;
                 return -1;
             }
@@ -120,17 +136,83 @@ static int _http_server_write(struct http_server_context *ctx) {
                 iovec[0].iov_base += num_write;
             }
         }
+        if (0 > http_server_yield_write())
+            return -1;
     }
-    return 0;
+    return epoll_worker_disarm_write(ctx->fd), 0;
 }
 
 static int _http_server_sendfile(struct http_server_context *ctx, int ffd, ssize_t size) {
     off_t ofs = 0;
     int fd = ctx->fd;
-    for (;;http_server_yield()) {
+    for (;;) {
         if (0 > sendfile(fd, ffd, &ofs, size - ofs) && EAGAIN != errno)
             return ctx->persistent = 0, -1;
         if (ofs >= size) break;
+        if (0 > http_server_yield_write())
+            return -1;
+    }
+    return epoll_worker_disarm_write(fd), 0;
+}
+
+/*
+ * io_uring backend: the ribbon is resumed when the operation
+ * completes, no need to wait for readiness first
+ */
+static int _http_server_read_uring(struct http_server_context *ctx) {
+    ssize_t res;
+    for (;;) {
+        /* covered by the header or body deadline */
+        res = ribs_uring_recv(ctx->fd, vmbuf_wloc(&ctx->request), vmbuf_wavail(&ctx->request), 0);
+        if (0 > res && EAGAIN == errno && 0 <= ribs_uring_poll(ctx->fd, POLLIN))
+            continue;
+        break;
+    }
+    if (0 < res)
+        return 0 > vmbuf_wseek(&ctx->request, res) ? -1 : 1;
+    return res; // remote side closed connection or error
+}
+
+static int _http_server_write_uring(struct http_server_context *ctx) {
+    struct iovec iovec[2] = {
+        { vmbuf_data(&ctx->header), vmbuf_wlocpos(&ctx->header)},
+        { vmbuf_data(&ctx->payload), vmbuf_wlocpos(&ctx->payload)}
+    };
+    struct iovec *iov = iovec;
+    int iovcnt = iovec[1].iov_len ? 2 : 1;
+    while (0 < iovcnt) {
+        if (0 > epoll_worker_set_timeout(ctx->fd, ctx->server->write_timeout))
+            return ctx->persistent = 0, -1;
+        ssize_t num_write = ribs_uring_writev(ctx->fd, iov, iovcnt);
+        epoll_worker_clear_timeout(ctx->fd);
+        if (0 > num_write) {
+            if (EAGAIN == errno && 0 <= ribs_uring_poll(ctx->fd, POLLOUT))
+                continue;
+            ctx->persistent = 0;
+            return -1;
+        }
+        for (; 0 < iovcnt && (size_t)num_write >= iov->iov_len; ++iov, --iovcnt)
+            num_write -= iov->iov_len;
+        if (0 < iovcnt) {
+            iov->iov_base += num_write;
+            iov->iov_len -= num_write;
+        }
+    }
+    return 0;
+}
+
+static int _http_server_sendfile_uring(struct http_server_context *ctx, int ffd, ssize_t size) {
+    off_t ofs = 0;
+    while (ofs < size) {
+        /* re-arm the timeout for every chunk, like the epoll version
+           does for every wakeup */
+        size_t chunk = size - ofs < 1024*1024 ? size - ofs : 1024*1024;
+        if (0 > epoll_worker_set_timeout(ctx->fd, ctx->server->write_timeout))
+            return ctx->persistent = 0, -1;
+        ssize_t res = ribs_uring_sendfile(ctx->fd, ffd, &ofs, chunk);
+        epoll_worker_clear_timeout(ctx->fd);
+        if (0 >= res)
+            return ctx->persistent = 0, -1;
     }
     return 0;
 }
@@ -162,10 +244,8 @@ static int _http_server_write_ssl(struct http_server_context *ctx) {
                 vmbuf_rseek(vmb, res);
                 continue;
             }
-            if (ribs_ssl_want_io(ssl, res)) {
-                http_server_yield();
+            if (ribs_ssl_want_io(ssl, res) && 0 == http_server_yield_write_timeout())
                 continue;
-            }
             ctx->persistent = 0;
             return errno = ENODATA, -1; // error, can not be zero
         }
@@ -187,21 +267,19 @@ static int _http_server_sendfile_ssl(struct http_server_context *ctx, int ffd, s
         if (ofs + chunk_size > size)
             chunk_size = size - ofs;
         void *mem = mmap(NULL, 1024*1024, PROT_READ, MAP_SHARED, ffd, ofs);
-        for (;;http_server_yield()) {
+        for (;;) {
             int res = SSL_write(ssl, mem + chunk_ofs, chunk_size - chunk_ofs);
             if (res > 0) {
                 chunk_ofs += res;
                 if (chunk_ofs == chunk_size)
                     break;
-            } else {
-                if (res < 0) {
-                    if (ribs_ssl_want_io(ssl, res))
-                                       continue;
-                }
-                ctx->persistent = 0;
-                munmap(mem, 1024*1024);
-                return errno = ENODATA, -1;
             }
+            if ((res > 0 || (res < 0 && ribs_ssl_want_io(ssl, res))) &&
+                0 == http_server_yield_write_timeout())
+                continue;
+            ctx->persistent = 0;
+            munmap(mem, 1024*1024);
+            return errno = ENODATA, -1;
         }
         ofs += chunk_size;
         munmap(mem, 1024*1024);
@@ -212,13 +290,35 @@ static int _http_server_sendfile_ssl(struct http_server_context *ctx, int ffd, s
 
 static void http_server_process_request(char *uri, char *headers);
 static void http_server_accept_connections(void);
+static void http_server_accept_connections_uring(void);
+static int http_server_init_contexts(struct http_server *server);
+static const char *http_server_addr_str(const struct http_server *server, char buf[HTTP_SERVER_ADDRSTRLEN]);
+
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE (1U << 28)
+#endif
 
 static void http_server_fiber_main_wrapper(void) {
     http_server_fiber_main();
     struct http_server_context *ctx = http_server_get_context();
+    /* closed or idle, the next request starts with fresh buffers */
+    if (ctx->server->slab_buffers) {
+        vmbuf_free(&ctx->request);
+        vmbuf_free(&ctx->header);
+        vmbuf_free(&ctx->payload);
+    }
     ctx_pool_put(&ctx->server->ctx_pool, current_ctx);
 }
 
+static struct ribs_context *http_server_new_fiber(struct http_server *server, int fd) {
+    struct ribs_context *new_ctx = ctx_pool_get(&server->ctx_pool);
+    ribs_makecontext(new_ctx, event_loop_ctx, http_server_fiber_main_wrapper);
+    struct http_server_context *ctx = (struct http_server_context *)new_ctx->reserved;
+    ctx->fd = fd;
+    ctx->server = server;
+    return new_ctx;
+}
+
 static void http_server_idle_handler(void) {
     struct http_server **server_ref = (struct http_server **)current_ctx->reserved;
     struct http_server *server = *server_ref;
@@ -226,20 +326,121 @@ static void http_server_idle_handler(void) {
         if (last_epollev.events == EPOLLOUT)
             yield();
         else {
-            struct ribs_context *new_ctx = ctx_pool_get(&server->ctx_pool);
-            ribs_makecontext(new_ctx, event_loop_ctx, http_server_fiber_main_wrapper);
             int fd = last_epollev.data.fd;
-            struct epoll_worker_fd_data *fd_data = epoll_worker_fd_map + fd;
-            fd_data->ctx = new_ctx;
-            struct http_server_context *ctx = (struct http_server_context *)new_ctx->reserved;
-            ctx->fd = fd;
-            ctx->server = server;
-            TIMEOUT_HANDLER_REMOVE_FD_DATA(fd_data);
+            struct ribs_context *new_ctx = http_server_new_fiber(server, fd);
+            epoll_worker_fd_map[fd].ctx = new_ctx;
             ribs_swapcurcontext(new_ctx);
         }
     }
 }
 
+static int http_server_listen(struct http_server *server, int reuseport) {
+    int lfd = socket(server->family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (0 > lfd)
+        return LOGGER_PERROR("socket"), -1;
+
+    int rc;
+    const int option = 1;
+    rc = setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &option, sizeof(option));
+    if (0 > rc)
+        return close(lfd), LOGGER_PERROR("setsockopt, SO_REUSEADDR"), rc;
+
+    if (reuseport) {
+        rc = setsockopt(lfd, SOL_SOCKET, SO_REUSEPORT, &option, sizeof(option));
+        if (0 > rc)
+            return close(lfd), LOGGER_PERROR("setsockopt, SO_REUSEPORT"), rc;
+    }
+
+    if (AF_UNIX != server->family) {
+        rc = setsockopt(lfd, IPPROTO_TCP, TCP_NODELAY, &option, sizeof(option));
+        if (0 > rc)
+            return close(lfd), LOGGER_PERROR("setsockopt, TCP_NODELAY"), rc;
+        if (0 < server->defer_accept) {
+            rc = setsockopt(lfd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &server->defer_accept, sizeof(server->defer_accept));
+            if (0 > rc)
+                return close(lfd), LOGGER_PERROR("setsockopt, TCP_DEFER_ACCEPT"), rc;
+        }
+        if (0 < server->fastopen_qlen) {
+            rc = setsockopt(lfd, IPPROTO_TCP, TCP_FASTOPEN, &server->fastopen_qlen, sizeof(server->fastopen_qlen));
+            if (0 > rc)
+                return close(lfd), LOGGER_PERROR("setsockopt, TCP_FASTOPEN"), rc;
+        }
+    }
+
+    struct linger ls;
+    ls.l_onoff = 0;
+    ls.l_linger = 0;
+    rc = setsockopt(lfd, SOL_SOCKET, SO_LINGER, (void *)&ls, sizeof(ls));
+    if (0 > rc)
+        return close(lfd), LOGGER_PERROR("setsockopt, SO_LINGER"), rc;
+
+    union {
+        struct sockaddr sa;
+        struct sockaddr_in in;
+        struct sockaddr_in6 in6;
+        struct sockaddr_un un;
+    } addr;
+    socklen_t addrlen;
+    memset(&addr, 0, sizeof(addr));
+    switch (server->family) {
+    case AF_INET:
+        addr.in.sin_family = AF_INET;
+        addr.in.sin_port = htons(server->port);
+        addr.in.sin_addr.s_addr = server->bind_addr;
+        addrlen = sizeof(addr.in);
+        break;
+    case AF_INET6:
+        /* dual stack, IPv4 peers show up as ::ffff:a.b.c.d */
+        rc = 0;
+        if (0 > setsockopt(lfd, IPPROTO_IPV6, IPV6_V6ONLY, &rc, sizeof(rc)))
+            return close(lfd), LOGGER_PERROR("setsockopt, IPV6_V6ONLY"), -1;
+        addr.in6.sin6_family = AF_INET6;
+        addr.in6.sin6_port = htons(server->port);
+        addr.in6.sin6_addr = server->bind_addr6;
+        addrlen = sizeof(addr.in6);
+        break;
+    case AF_UNIX:
+        if (NULL == server->unix_path || strlen(server->unix_path) >= sizeof(addr.un.sun_path))
+            return close(lfd), LOGGER_ERROR("invalid unix socket path: %s", server->unix_path ? server->unix_path : "(null)"), -1;
+        addr.un.sun_family = AF_UNIX;
+        strcpy(addr.un.sun_path, server->unix_path);
+        addrlen = sizeof(addr.un);
+        /* left behind by a previous run */
+        struct stat st;
+        if (0 == stat(server->unix_path, &st) && S_ISSOCK(st.st_mode) && 0 > unlink(server->unix_path))
+            return close(lfd), LOGGER_PERROR("unlink: %s", server->unix_path), -1;
+        break;
+    default:
+        return close(lfd), LOGGER_ERROR("unsupported address family: %d", server->family), -1;
+    }
+    if (0 > bind(lfd, &addr.sa, addrlen))
+        return close(lfd), LOGGER_PERROR("bind"), -1;
+
+    if (0 == server->port && AF_UNIX != server->family) {
+        addrlen = sizeof(addr);
+        if (0 > getsockname(lfd, &addr.sa, &addrlen))
+            return close(lfd), LOGGER_PERROR("getsockname"), -1;
+        server->port = ntohs(AF_INET6 == server->family ? addr.in6.sin6_port : addr.in.sin_port);
+    }
+    if (0 > listen(lfd, LISTEN_BACKLOG))
+        return close(lfd), LOGGER_PERROR("listen"), -1;
+    return lfd;
+}
+
+/* SO_ATTACH_REUSEPORT_CBPF: pick the socket by the CPU which received
+   the connection, socket i is served by the instance pinned to CPU i */
+static int http_server_attach_cpu_steering(struct http_server *server) {
+    struct sock_filter code[] = {
+        { BPF_LD | BPF_W | BPF_ABS, 0, 0, SKF_AD_OFF + SKF_AD_CPU },
+        { BPF_ALU | BPF_MOD | BPF_K, 0, 0, server->num_listeners },
+        { BPF_RET | BPF_A, 0, 0, 0 },
+    };
+    struct sock_fprog prog = { sizeof(code) / sizeof(code[0]), code };
+    if (0 > setsockopt(server->listen_fds[0], SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)))
+        return LOGGER_PERROR("setsockopt, SO_ATTACH_REUSEPORT_CBPF"), -1;
+    return 0;
+}
+
 int http_server_init(struct http_server *server) {
     server->bind_addr = htonl(INADDR_ANY);
 #ifdef RIBS2_SSL
@@ -265,12 +466,6 @@ int http_server_init2(struct http_server *server) {
     if (0 > http_headers_init())
         return LOGGER_ERROR("failed to initialize http headers"), -1;
 
-    if (-1 == accept_reserved_fd) {
-        accept_reserved_fd = open("/dev/null", 0);
-        if (0 > accept_reserved_fd)
-            return LOGGER_PERROR("open"), -1;
-    }
-
 #ifdef RIBS2_SSL
     if (server->use_ssl) {
 
@@ -299,154 +494,314 @@ int http_server_init2(struct http_server *server) {
         server->http_server_write = _http_server_write;
         server->http_server_sendfile = _http_server_sendfile;
     }
-    /*
-     * idle connection handler
-     */
-    server->idle_ctx = ribs_context_create(SMALL_STACK_SIZE, sizeof(struct http_server *), http_server_idle_handler);
-    struct http_server **server_ref = (struct http_server **)server->idle_ctx->reserved;
-    *server_ref = server;
-    /*
-     * context pool
-     */
     if (0 == server->num_stacks)
         server->num_stacks = DEFAULT_NUM_STACKS;
+    if (0 >= server->accept_budget)
+        server->accept_budget = DEFAULT_ACCEPT_BUDGET;
+    time_t *timeouts[] = { &server->header_timeout, &server->body_timeout, &server->write_timeout, &server->keepalive_timeout };
+    size_t i;
+    for (i = 0; i < sizeof(timeouts) / sizeof(timeouts[0]); ++i) {
+        if (0 == *timeouts[i])
+            *timeouts[i] = server->timeout_handler.timeout;
+    }
     struct rlimit rlim;
     if (0 > getrlimit(RLIMIT_STACK, &rlim))
         return LOGGER_PERROR("getrlimit(RLIMIT_STACK)"), -1;
     server->stack_size = server->stack_size > rlim.rlim_cur ? server->stack_size : rlim.rlim_cur;
-    LOGGER_INFO("http server pool: initial=%zu, grow=%zu, stack_size=%zu", server->num_stacks, server->num_stacks, server->stack_size);
-    ctx_pool_init(&server->ctx_pool, server->num_stacks, server->num_stacks, server->stack_size, sizeof(struct http_server_context) + server->context_size);
+    if (0 > http_server_init_contexts(server))
+        return -1;
     /*
      * listen socket
      */
-    const int LISTEN_BACKLOG = 32768;
-    int lfd = socket(PF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
-    if (0 > lfd)
-        return -1;
-
-    int rc;
-    const int option = 1;
-    rc = setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &option, sizeof(option));
-    if (0 > rc)
-        return LOGGER_PERROR("setsockopt, SO_REUSEADDR"), rc;
-
-    rc = setsockopt(lfd, IPPROTO_TCP, TCP_NODELAY, &option, sizeof(option));
-    if (0 > rc)
-        return LOGGER_PERROR("setsockopt, TCP_NODELAY"), rc;
-
-    struct linger ls;
-    ls.l_onoff = 0;
-    ls.l_linger = 0;
-    rc = setsockopt(lfd, SOL_SOCKET, SO_LINGER, (void *)&ls, sizeof(ls));
-    if (0 > rc)
-        return LOGGER_PERROR("setsockopt, SO_LINGER"), rc;
-
-    struct sockaddr_in addr;
-    memset(&addr, 0, sizeof(struct sockaddr_in));
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(server->port);
-    addr.sin_addr.s_addr = server->bind_addr;
-    if (0 > bind(lfd, (struct sockaddr *)&addr, sizeof(addr)))
-        return close(lfd), LOGGER_PERROR("bind"), -1;
-
-    if (0 == server->port) {
-        struct sockaddr_in addr;
-        socklen_t addrlen = sizeof(addr);
-        if (0 > getsockname(lfd, &addr, &addrlen))
-            return close(lfd), LOGGER_PERROR("getsockname"), -1;
-        server->port = ntohs(addr.sin_port);
+    if (0 == server->family)
+        server->family = AF_INET;
+    if (0 < server->reuseport && AF_UNIX == server->family)
+        return LOGGER_ERROR("SO_REUSEPORT is not supported on unix sockets"), -1;
+    int lfd;
+    if (0 < server->reuseport) {
+        /* one socket per instance, bound before forking so all of
+           them are inherited and the group is complete up front */
+        /* has to match the instances, a socket without an acceptor
+           still gets its share of the connections */
+        if (0 >= server->num_listeners)
+            return LOGGER_ERROR("SO_REUSEPORT needs num_listeners (forks * threads), got: %d", server->num_listeners), -1;
+        server->listen_fds = calloc(server->num_listeners, sizeof(int));
+        if (NULL == server->listen_fds)
+            return LOGGER_PERROR("calloc"), -1;
+        int i;
+        for (i = 0; i < server->num_listeners; ++i) {
+            /* port 0: the first bind picks it, the rest follow */
+            if (0 > (server->listen_fds[i] = http_server_listen(server, 1)))
+                return -1;
+        }
+        if (server->reuseport_cpu && 0 > http_server_attach_cpu_steering(server))
+            return -1;
+        lfd = server->listen_fds[0];
+    } else {
+        server->num_listeners = 1;
+        if (0 > (lfd = http_server_listen(server, 0)))
+            return -1;
     }
-    LOGGER_INFO("listening on port: %d, backlog: %d, protocol: http%s", server->port, LISTEN_BACKLOG,
+    char addr_str[HTTP_SERVER_ADDRSTRLEN];
+    LOGGER_INFO("listening on %s, sockets: %d, backlog: %d, protocol: http%s", http_server_addr_str(server, addr_str), server->num_listeners, LISTEN_BACKLOG,
 #ifdef RIBS2_SSL
                 server->use_ssl ? "s" :
 #endif
                 "");
 
-    if (0 > listen(lfd, LISTEN_BACKLOG))
-        return LOGGER_PERROR("listen"), -1;
+    server->fd = lfd;
+
+    if (server->max_req_size == 0)
+        server->max_req_size = DEFAULT_MAX_REQ_SIZE;
+    return 0;
+}
+
+int http_server_init_clone(struct http_server *server, const struct http_server *parent) {
+    *server = *parent;
+    /* all the clones are woken up by the same listen socket, unless
+       each has its own (reuseport) */
+    server->accept_exclusive = 1;
+    memset(&server->accept_stats, 0, sizeof(server->accept_stats));
+    return http_server_init_contexts(server);
+}
 
+static const char *http_server_addr_str(const struct http_server *server, char buf[HTTP_SERVER_ADDRSTRLEN]) {
+    char ip[INET6_ADDRSTRLEN];
+    switch (server->family) {
+    case AF_UNIX:
+        snprintf(buf, HTTP_SERVER_ADDRSTRLEN, "unix:%s", server->unix_path);
+        break;
+    case AF_INET6:
+        snprintf(buf, HTTP_SERVER_ADDRSTRLEN, "[%s]:%hu", inet_ntop(AF_INET6, &server->bind_addr6, ip, sizeof(ip)), server->port);
+        break;
+    default:
+        snprintf(buf, HTTP_SERVER_ADDRSTRLEN, "%s:%hu", inet_ntop(AF_INET, &server->bind_addr, ip, sizeof(ip)), server->port);
+    }
+    return buf;
+}
+
+static int http_server_init_contexts(struct http_server *server) {
+    /*
+     * idle connection handler
+     */
+    server->idle_ctx = ribs_context_create(SMALL_STACK_SIZE, sizeof(struct http_server *), http_server_idle_handler);
+    struct http_server **server_ref = (struct http_server **)server->idle_ctx->reserved;
+    *server_ref = server;
+    /*
+     * context pool
+     */
+    LOGGER_INFO("http server pool: initial=%zu, grow=%zu, stack_size=%zu", server->num_stacks, server->num_stacks, server->stack_size);
+    if (0 > ctx_pool_init(&server->ctx_pool, server->num_stacks, server->num_stacks, server->stack_size, sizeof(struct http_server_context) + server->context_size))
+        return LOGGER_ERROR("failed to initialize context pool"), -1;
+    /*
+     * acceptor
+     */
     server->accept_ctx = ribs_context_create(ACCEPTOR_STACK_SIZE, sizeof(struct http_server *), http_server_accept_connections);
-    server->fd = lfd;
     server_ref = (struct http_server **)server->accept_ctx->reserved;
     *server_ref = server;
+    return 0;
+}
 
-    if (server->max_req_size == 0)
-        server->max_req_size = DEFAULT_MAX_REQ_SIZE;
+static void http_server_trim_stacks(void) {
+    struct http_server *server = *(struct http_server **)timer_worker_get_user_data();
+    ctx_pool_trim(&server->ctx_pool);
+    timer_worker_schedule_next(server->stack_trim_msec * 1000);
+}
+
+static int http_server_pin_cpu(int instance) {
+    long num_cpus = sysconf(_SC_NPROCESSORS_CONF);
+    if (0 >= num_cpus)
+        return LOGGER_PERROR("sysconf"), -1;
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(instance % num_cpus, &cpus);
+    if (0 > sched_setaffinity(0, sizeof(cpus), &cpus))
+        return LOGGER_PERROR("sched_setaffinity, cpu %ld", instance % num_cpus), -1;
     return 0;
 }
 
 int http_server_init_acceptor(struct http_server *server) {
-    if (0 > ribs_epoll_add(server->fd, EPOLLIN, server->accept_ctx))
+    /* reserved per event loop, released when running out of fds */
+    if (-1 == accept_reserved_fd) {
+        accept_reserved_fd = open("/dev/null", 0);
+        if (0 > accept_reserved_fd)
+            return LOGGER_PERROR("open"), -1;
+    }
+    server->instance = ribs_get_daemon_instance() * epoll_worker_get_num_threads() + epoll_worker_get_thread_id();
+    if (0 < server->reuseport) {
+        int num_forks = ribs_get_num_instances();
+        int num_instances = (0 < num_forks ? num_forks : 1) * epoll_worker_get_num_threads();
+        if (num_instances < server->num_listeners)
+            return LOGGER_ERROR("%d listen sockets but only %d instances, connections would be left unaccepted",
+                                server->num_listeners, num_instances), -1;
+        server->fd = server->listen_fds[server->instance % server->num_listeners];
+        server->accept_exclusive = 0;
+        if (server->reuseport_cpu && 0 > http_server_pin_cpu(server->instance))
+            return -1;
+    }
+    if (EPOLL_WORKER_BACKEND_URING == epoll_worker_get_backend()
+#ifdef RIBS2_SSL
+        && !server->use_ssl
+#endif
+        ) {
+        server->use_uring = 1;
+        server->http_server_read = _http_server_read_uring;
+        server->http_server_write = _http_server_write_uring;
+        server->http_server_sendfile = _http_server_sendfile_uring;
+        /* the acceptor waits for accept completions instead of
+           EPOLLIN on the listen socket, kick it off */
+        ribs_makecontext(server->accept_ctx, event_loop_ctx, http_server_accept_connections_uring);
+        epoll_worker_queue_ctx(server->accept_ctx);
+    } else if (0 > ribs_epoll_add(server->fd, EPOLLIN | (server->accept_exclusive ? EPOLLEXCLUSIVE : 0), server->accept_ctx))
         return -1;
+    if (0 < server->stack_trim_msec) {
+        struct http_server **server_ref = (struct http_server **)timer_worker_init(STACK_TRIM_STACK_SIZE, sizeof(struct http_server *), server->stack_trim_msec * 1000, http_server_trim_stacks);
+        if (NULL == server_ref)
+            return -1;
+        *server_ref = server;
+    }
+    if (0 < server->response_cache_size) {
+        /* one per event loop, clones start without */
+        server->response_cache = malloc(sizeof(struct http_response_cache));
+        if (NULL == server->response_cache)
+            return LOGGER_PERROR("malloc"), -1;
+        if (0 > http_response_cache_init(server->response_cache, server->response_cache_size, server->response_cache_ttl))
+            return -1;
+    }
     return timeout_handler_init(&server->timeout_handler);
 }
 
-static void http_server_accept_connections(void) {
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69
+#endif
+
+static void http_server_set_busy_poll(struct http_server *server, int fd) {
+    if (0 >= server->busy_poll_usec)
+        return;
+    const int option = 1;
+    if (0 > setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &server->busy_poll_usec, sizeof(server->busy_poll_usec))) {
+        /* EPERM above net.core.busy_read without CAP_NET_ADMIN */
+        LOGGER_PERROR("setsockopt, SO_BUSY_POLL, disabling busy poll");
+        server->busy_poll_usec = 0;
+        return;
+    }
+    /* kernels older than 5.11 don't support it, not fatal */
+    setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &option, sizeof(option));
+}
+
+/* with TCP_DEFER_ACCEPT the request is most likely in already, run the
+   fiber from the run queue instead of waiting for the next epoll_wait.
+   events are ignored until then, the fiber reads before it yields */
+static int http_server_add_connection(struct http_server *server, int fd, uint32_t events) {
+    if (0 > ribs_epoll_add(fd, events, 0 < server->defer_accept ? event_loop_ctx : server->idle_ctx))
+        return -1;
+    if (0 > epoll_worker_set_timeout(fd, server->header_timeout))
+        return LOGGER_ERROR("failed to arm the connection timeout"), -1;
+    if (0 < server->defer_accept)
+        epoll_worker_queue_ctx(http_server_new_fiber(server, fd));
+    return 0;
+}
+
+static void http_server_accept_connections_uring(void) {
     struct http_server **server_ref = (struct http_server **)current_ctx->reserved;
     struct http_server *server = *server_ref;
-    for (;; yield()) {
-        struct sockaddr_in new_addr;
-        socklen_t new_addr_size = sizeof(struct sockaddr_in);
-        int fd = accept4(server->fd, (struct sockaddr *)&new_addr, &new_addr_size, SOCK_CLOEXEC | SOCK_NONBLOCK);
+    for (;;) {
+        struct sockaddr_storage new_addr;
+        socklen_t new_addr_size = sizeof(new_addr);
+        int fd = ribs_uring_accept(server->fd, (struct sockaddr *)&new_addr, &new_addr_size, SOCK_CLOEXEC | SOCK_NONBLOCK);
         if (0 > fd) {
-            if (EAGAIN == errno)
+            if (EAGAIN == errno) {
+                ribs_uring_poll(server->fd, POLLIN);
+                ++server->accept_stats.wakeups;
                 continue;
+            }
+            char addr_str[HTTP_SERVER_ADDRSTRLEN];
+            LOGGER_PERROR("Accept on %s", http_server_addr_str(server, addr_str));
+            ++server->accept_stats.errors;
             if (EMFILE == errno || ENFILE == errno) {
-                /*
-                 * If we run out of fds then we must be swamped with requests. So any new connections won't be serviced
-                 * in a timely manner. By the time we service them, they'll probably time out anyways. So instead of making
-                 * them wait to find out that we're overloaded, let them know immediately.
-                 */
-                LOGGER_PERROR("Not accepting connection on %s:%hu", inet_ntoa((struct in_addr){server->bind_addr}), server->port);
+                /* see http_server_accept_connections */
                 close(accept_reserved_fd);
                 fd = accept4(server->fd, (struct sockaddr *)&new_addr, &new_addr_size, SOCK_CLOEXEC | SOCK_NONBLOCK);
-                if (0 > fd) {
-                    if (EAGAIN != errno)
-                        LOGGER_PERROR("Accept on %s:%hu", inet_ntoa((struct in_addr){server->bind_addr}), server->port);
-                }
-                else
-                    close(fd);
+                if (0 <= fd)
+                    close(fd), ++server->accept_stats.rejected;
                 accept_reserved_fd = open("/dev/null", 0);
                 if (0 > accept_reserved_fd)
                     LOGGER_PERROR("open");
-            } else {
-                LOGGER_PERROR("Accept on %s:%hu", inet_ntoa((struct in_addr){server->bind_addr}), server->port);
             }
             continue;
         }
-        if (0 > ribs_epoll_add(fd, EPOLLIN | EPOLLOUT | EPOLLET, server->idle_ctx)) {
+        ++server->accept_stats.accepted;
+        http_server_set_busy_poll(server, fd);
+        if (0 > http_server_add_connection(server, fd, EPOLLIN | EPOLLET))
             ribs_close(fd);
-            continue;
-        }
-        timeout_handler_add_fd_data(&server->timeout_handler, epoll_worker_fd_map + fd);
     }
 }
 
-static int check_persistent(char *p) {
-    char *conn = strstr(p, CONNECTION);
-    char *h1_1 = strstr(p, " HTTP/1.1");
-    // HTTP/1.1
-    if ((NULL != h1_1 &&
-         (NULL == conn ||
-          0 != SSTRNCMPI(CONNECTION_CLOSE, conn + SSTRLEN(CONNECTION)))) ||
-        // HTTP/1.0
-        (NULL == h1_1 &&
-         NULL != conn &&
-         0 == SSTRNCMPI(CONNECTION_KEEPALIVE, conn + SSTRLEN(CONNECTION))))
-        return 1;
-    else
-        return 0;
+static void http_server_accept_connections(void) {
+    struct http_server **server_ref = (struct http_server **)current_ctx->reserved;
+    struct http_server *server = *server_ref;
+    for (;; yield()) {
+        ++server->accept_stats.wakeups;
+        /* drain the backlog, up to the budget. the listen socket is
+           level triggered, whatever is left wakes us up again */
+        int budget;
+        for (budget = server->accept_budget; 0 < budget; --budget) {
+            struct sockaddr_storage new_addr;
+            socklen_t new_addr_size = sizeof(new_addr);
+            int fd = accept4(server->fd, (struct sockaddr *)&new_addr, &new_addr_size, SOCK_CLOEXEC | SOCK_NONBLOCK);
+            if (0 > fd) {
+                if (EAGAIN == errno)
+                    break;
+                char addr_str[HTTP_SERVER_ADDRSTRLEN];
+                if (EMFILE == errno || ENFILE == errno) {
+                    /*
+                     * If we run out of fds then we must be swamped with requests. So any new connections won't be serviced
+                     * in a timely manner. By the time we service them, they'll probably time out anyways. So instead of making
+                     * them wait to find out that we're overloaded, let them know immediately.
+                     */
+                    LOGGER_PERROR("Not accepting connection on %s", http_server_addr_str(server, addr_str));
+                    close(accept_reserved_fd);
+                    fd = accept4(server->fd, (struct sockaddr *)&new_addr, &new_addr_size, SOCK_CLOEXEC | SOCK_NONBLOCK);
+                    if (0 > fd) {
+                        if (EAGAIN != errno)
+                            LOGGER_PERROR("Accept on %s", http_server_addr_str(server, addr_str));
+                    }
+                    else
+                        close(fd), ++server->accept_stats.rejected;
+                    accept_reserved_fd = open("/dev/null", 0);
+                    if (0 > accept_reserved_fd)
+                        LOGGER_PERROR("open");
+                } else {
+                    LOGGER_PERROR("Accept on %s", http_server_addr_str(server, addr_str));
+                }
+                ++server->accept_stats.errors;
+                break;
+            }
+            ++server->accept_stats.accepted;
+            http_server_set_busy_poll(server, fd);
+            /* EPOLLOUT is armed on demand, SSL needs it for renegotiation */
+            uint32_t events = EPOLLIN | EPOLLET;
+#ifdef RIBS2_SSL
+            if (server->use_ssl)
+                events |= EPOLLOUT;
+#endif
+            if (0 > http_server_add_connection(server, fd, events))
+                ribs_close(fd);
+        }
+        if (0 == budget)
+            ++server->accept_stats.budget_exhausted;
+    }
 }
 
 
 void http_server_header_start(const char *status, const char *content_type) {
     struct http_server_context *ctx = http_server_get_context();
-    vmbuf_sprintf(&ctx->header, "%s %s\r\nServer: %s\r\nContent-Type: %s%s%s", HTTP_SERVER_VER, status, HTTP_SERVER_NAME, content_type, CONNECTION, ctx->persistent ? CONNECTION_KEEPALIVE : CONNECTION_CLOSE);
+    vmbuf_sprintf(&ctx->header, "%s %s\r\nServer: %s\r\nDate: %s\r\nContent-Type: %s%s%s", HTTP_SERVER_VER, status, HTTP_SERVER_NAME, ribs_clock_http_date(), content_type, CONNECTION, ctx->persistent ? CONNECTION_KEEPALIVE : CONNECTION_CLOSE);
 }
 
 void http_server_header_start_no_body(const char *status) {
     struct http_server_context *ctx = http_server_get_context();
-    vmbuf_sprintf(&ctx->header, "%s %s\r\nServer: %s%s%s", HTTP_SERVER_VER, status, HTTP_SERVER_NAME, CONNECTION, ctx->persistent ? CONNECTION_KEEPALIVE : CONNECTION_CLOSE);
+    vmbuf_sprintf(&ctx->header, "%s %s\r\nServer: %s\r\nDate: %s%s%s", HTTP_SERVER_VER, status, HTTP_SERVER_NAME, ribs_clock_http_date(), CONNECTION, ctx->persistent ? CONNECTION_KEEPALIVE : CONNECTION_CLOSE);
 }
 
 void http_server_header_close(void) {
@@ -544,6 +899,277 @@ void http_server_vredirect(const char *status, const char *content_type, const c
     http_server_header_close();
 }
 
+int http_server_stream_begin(const char *status, const char *content_type) {
+    struct http_server_context *ctx = http_server_get_context();
+    ctx->stream = STREAM_ACTIVE;
+    if (0 < ctx->parser.version_minor)
+        ctx->stream |= STREAM_CHUNKED;
+    else
+        ctx->persistent = 0; /* the end of the body is the end of the connection */
+    if (HTTP_METHOD_HEAD == ctx->parser.method)
+        ctx->stream |= STREAM_NO_BODY;
+    vmbuf_reset(&ctx->header);
+    vmbuf_reset(&ctx->payload);
+    http_server_header_start(status, content_type);
+    if (ctx->stream & STREAM_CHUNKED)
+        vmbuf_strcpy(&ctx->header, TRANSFER_ENCODING_CHUNKED);
+    return 0;
+}
+
+static int http_server_stream_send(int last) {
+    struct http_server_context *ctx = http_server_get_context();
+    if (!(ctx->stream & STREAM_ACTIVE) || (ctx->stream & STREAM_FAILED))
+        return -1;
+    if (!(ctx->stream & STREAM_HEADER_SENT))
+        http_server_header_close();
+    size_t size = vmbuf_wlocpos(&ctx->payload);
+    if (ctx->stream & STREAM_CHUNKED) {
+        /* the chunk size goes after the header, both are sent with the data */
+        if (0 < size) {
+            vmbuf_sprintf(&ctx->header, "%zx\r\n", size);
+            vmbuf_strcpy(&ctx->payload, CRLF);
+        }
+        if (last)
+            vmbuf_strcpy(&ctx->payload, LAST_CHUNK);
+    }
+    if (0 == vmbuf_wlocpos(&ctx->header) && 0 == vmbuf_wlocpos(&ctx->payload))
+        return 0;
+    /* the handler runs with events ignored, take them while writing */
+    epoll_worker_resume_events(ctx->fd);
+    int res = ctx->server->http_server_write(ctx);
+    epoll_worker_ignore_events(ctx->fd);
+    vmbuf_reset(&ctx->header);
+    vmbuf_reset(&ctx->payload);
+    ctx->stream |= STREAM_HEADER_SENT;
+    if (0 > res)
+        return ctx->stream |= STREAM_FAILED, -1;
+    return 0;
+}
+
+int http_server_stream_write(const void *data, size_t size) {
+    struct http_server_context *ctx = http_server_get_context();
+    if (ctx->stream & STREAM_NO_BODY)
+        return 0;
+    if (ctx->stream & STREAM_FAILED)
+        return -1;
+    vmbuf_memcpy(&ctx->payload, data, size);
+    if (STREAM_FLUSH_SIZE <= vmbuf_wlocpos(&ctx->payload))
+        return http_server_stream_send(0);
+    return 0;
+}
+
+int http_server_stream_printf(const char *format, ...) {
+    va_list ap;
+    va_start(ap, format);
+    int res = http_server_stream_vprintf(format, ap);
+    va_end(ap);
+    return res;
+}
+
+int http_server_stream_vprintf(const char *format, va_list ap) {
+    struct http_server_context *ctx = http_server_get_context();
+    if (ctx->stream & STREAM_NO_BODY)
+        return 0;
+    if (ctx->stream & STREAM_FAILED)
+        return -1;
+    vmbuf_vsprintf(&ctx->payload, format, ap);
+    if (STREAM_FLUSH_SIZE <= vmbuf_wlocpos(&ctx->payload))
+        return http_server_stream_send(0);
+    return 0;
+}
+
+int http_server_writev(struct iovec *iov, int iovcnt) {
+    struct http_server_context *ctx = http_server_get_context();
+    int fd = ctx->fd;
+    int res = 0;
+    /* the handler runs with events ignored, take them while writing */
+    epoll_worker_resume_events(fd);
+    if (_http_server_write != ctx->server->http_server_write) {
+        /* SSL, io_uring: through the transport, as header */
+        vmbuf_reset(&ctx->header);
+        vmbuf_reset(&ctx->payload);
+        int i;
+        for (i = 0; i < iovcnt; ++i)
+            vmbuf_memcpy(&ctx->header, iov[i].iov_base, iov[i].iov_len);
+        res = ctx->server->http_server_write(ctx);
+    } else {
+        while (0 < iovcnt) {
+            ssize_t num_write = writev(fd, iov, iovcnt);
+            if (0 > num_write) {
+                if (EAGAIN == errno && 0 <= http_server_yield_write())
+                    continue;
+                ctx->persistent = 0;
+                res = -1;
+                break;
+            }
+            for (; 0 < iovcnt && (size_t)num_write >= iov->iov_len; ++iov, --iovcnt)
+                num_write -= iov->iov_len;
+            if (0 < iovcnt) {
+                iov->iov_base += num_write;
+                iov->iov_len -= num_write;
+            }
+        }
+        epoll_worker_disarm_write(fd);
+    }
+    epoll_worker_ignore_events(fd);
+    vmbuf_reset(&ctx->header);
+    vmbuf_reset(&ctx->payload);
+    return res;
+}
+
+int http_server_stream_flush(void) {
+    return http_server_stream_send(0);
+}
+
+int http_server_stream_end(void) {
+    struct http_server_context *ctx = http_server_get_context();
+    if (ctx->stream & STREAM_NO_BODY)
+        vmbuf_reset(&ctx->payload);
+    int res = http_server_stream_send(!(ctx->stream & STREAM_NO_BODY));
+    ctx->stream &= ~STREAM_ACTIVE;
+    return res;
+}
+
+/* wait for the socket while the handler runs (events are ignored) */
+static int http_server_body_wait(struct http_server_context *ctx) {
+    if (0 > epoll_worker_set_timeout(ctx->fd, ctx->server->body_timeout))
+        return ctx->persistent = 0, -1;
+    epoll_worker_resume_events(ctx->fd);
+    http_server_yield();
+    epoll_worker_clear_timeout(ctx->fd);
+    epoll_worker_ignore_events(ctx->fd);
+    return 0;
+}
+
+/* more of the body into ctx->request */
+static int http_server_body_fill(struct http_server_context *ctx) {
+    size_t wlocpos = vmbuf_wlocpos(&ctx->request);
+    /* read first, an edge may have been missed while events were ignored */
+    int res = ctx->server->http_server_read(ctx);
+    if (0 < res && wlocpos == vmbuf_wlocpos(&ctx->request)) {
+        if (0 > http_server_body_wait(ctx))
+            return -1;
+        res = ctx->server->http_server_read(ctx);
+    }
+    if (0 >= res)
+        return ctx->persistent = 0, -1;
+    return 0;
+}
+
+ssize_t http_server_body_read(void *buf, size_t size) {
+    struct http_server_context *ctx = http_server_get_context();
+    struct http_body_decoder *body = &ctx->body;
+    for (;;) {
+        size_t avail = body->wpos - ctx->body_ofs;
+        if (0 < avail) {
+            if (avail > size)
+                avail = size;
+            memcpy(buf, vmbuf_data_ofs(&ctx->request, ctx->body_ofs), avail);
+            ctx->body_ofs += avail;
+            return avail;
+        }
+        if (http_body_decoder_done(body))
+            return 0;
+        /* everything decoded was handed out, reuse the space */
+        uint32_t start = ctx->parser.header_len;
+        if (body->wpos > start) {
+            char *data = vmbuf_data(&ctx->request);
+            size_t raw = vmbuf_wlocpos(&ctx->request) - body->rpos;
+            memmove(data + start, data + body->rpos, raw);
+            vmbuf_wrewind(&ctx->request, body->rpos - start);
+            body->rpos = body->wpos = ctx->body_ofs = start;
+        }
+        int res = http_body_decode(body, vmbuf_data(&ctx->request), vmbuf_wlocpos(&ctx->request));
+        if (HTTP_PARSER_ERROR == res)
+            return ctx->persistent = 0, -1;
+        if (HTTP_PARSER_AGAIN == res && body->wpos == ctx->body_ofs && 0 > http_server_body_fill(ctx))
+            return -1;
+    }
+}
+
+static int http_server_write_all(int fd, const char *buf, size_t size) {
+    while (0 < size) {
+        ssize_t res = write(fd, buf, size);
+        if (0 > res)
+            return -1;
+        buf += res;
+        size -= res;
+    }
+    return 0;
+}
+
+static _RIBS_THREAD_LOCAL_ int splice_pipe[2] = { -1, -1 };
+
+static void http_server_splice_pipe_close(void) {
+    close(splice_pipe[0]);
+    close(splice_pipe[1]);
+    splice_pipe[0] = splice_pipe[1] = -1;
+}
+
+ssize_t http_server_body_splice(int fd) {
+    struct http_server_context *ctx = http_server_get_context();
+    struct http_body_decoder *body = &ctx->body;
+    /* written with blocking calls, they must not wait (EAGAIN, slow
+       consumers) */
+    struct stat st;
+    if (0 > fstat(fd, &st))
+        return LOGGER_PERROR("fstat"), -1;
+    if (!S_ISREG(st.st_mode))
+        return LOGGER_ERROR("http_server_body_splice: fd %d is not a regular file", fd), errno = EINVAL, -1;
+    ssize_t total = 0;
+    char buf[16*1024];
+    ssize_t res = 0;
+    /* what is buffered, then the rest straight from the socket when
+       there is no framing (chunked) or transport (SSL, io_uring) in
+       the way */
+    int can_splice = HTTP_BODY_IDENTITY == body->state && !ctx->server->use_uring;
+#ifdef RIBS2_SSL
+    if (ribs_ssl_get(ctx->fd))
+        can_splice = 0;
+#endif
+    for (;;) {
+        /* the buffer is drained, the rest is still on the socket */
+        if (can_splice && body->wpos == ctx->body_ofs && body->rpos == vmbuf_wlocpos(&ctx->request))
+            break;
+        if (0 >= (res = http_server_body_read(buf, sizeof(buf))))
+            break;
+        if (0 > http_server_write_all(fd, buf, res))
+            return LOGGER_PERROR("write body"), ctx->persistent = 0, -1;
+        total += res;
+    }
+    if (0 > res)
+        return -1;
+    if (!can_splice || http_body_decoder_done(body))
+        return total;
+    if (0 > splice_pipe[0] && 0 > pipe2(splice_pipe, O_CLOEXEC | O_NONBLOCK))
+        return LOGGER_PERROR("pipe2"), ctx->persistent = 0, -1;
+    while (0 < body->left) {
+        size_t n = body->left < sizeof(buf) * 4 ? body->left : sizeof(buf) * 4;
+        res = splice(ctx->fd, NULL, splice_pipe[1], NULL, n, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (0 > res && EAGAIN == errno) {
+            if (0 > http_server_body_wait(ctx))
+                return -1;
+            continue;
+        }
+        if (0 >= res)
+            return ctx->persistent = 0, -1;
+        body->left -= res;
+        while (0 < res) {
+            ssize_t m = splice(splice_pipe[0], NULL, fd, NULL, res, SPLICE_F_MOVE);
+            if (0 >= m) {
+                /* the pipe is left with data in it */
+                LOGGER_PERROR("splice body");
+                http_server_splice_pipe_close();
+                return ctx->persistent = 0, -1;
+            }
+            res -= m;
+            total += m;
+        }
+    }
+    body->state = HTTP_BODY_DONE;
+    return total;
+}
+
 void http_server_header_content_length(void) {
     struct http_server_context *ctx = http_server_get_context();
     vmbuf_sprintf(&ctx->header, "%s%zu", CONTENT_LENGTH, vmbuf_wlocpos(&ctx->payload));
@@ -564,12 +1190,34 @@ void http_server_header_content_length(void) {
     }
 
 
+/* reading is covered by the header or body deadline, armed once for
+   the whole phase */
 static inline void http_server_yield(void) {
     struct http_server_context *ctx = http_server_get_context();
-    struct epoll_worker_fd_data *fd_data = epoll_worker_fd_map + ctx->fd;
-    timeout_handler_add_fd_data(&ctx->server->timeout_handler, fd_data);
+    if (ctx->server->use_uring)
+        return; /* read/write completions resume the ribbon */
     yield();
-    TIMEOUT_HANDLER_REMOVE_FD_DATA(fd_data);
+}
+
+/* writing times out when no progress is made, re-armed every wakeup */
+static inline int http_server_yield_write_timeout(void) {
+    struct http_server_context *ctx = http_server_get_context();
+    if (ctx->server->use_uring)
+        return 0;
+    if (0 > epoll_worker_set_timeout(ctx->fd, ctx->server->write_timeout))
+        return ctx->persistent = 0, -1;
+    yield();
+    epoll_worker_clear_timeout(ctx->fd);
+    return 0;
+}
+
+/* the socket buffer is full, wait for EPOLLOUT. The connection can't
+   be written to anymore when EPOLLOUT can't be armed */
+static inline int http_server_yield_write(void) {
+    struct http_server_context *ctx = http_server_get_context();
+    if (0 > epoll_worker_arm_write(ctx->fd))
+        return ctx->persistent = 0, -1;
+    return http_server_yield_write_timeout();
 }
 
 void http_server_fiber_main(void) {
@@ -579,15 +1227,21 @@ void http_server_fiber_main(void) {
 
     char *URI;
     char *headers;
-    char *content;
     size_t content_length;
     int res;
     ctx->persistent = 0;
 
-    vmbuf_init(&ctx->request, server->init_request_size);
-    vmbuf_init(&ctx->header, server->init_header_size);
-    vmbuf_init(&ctx->payload, server->init_payload_size);
+    int (*buf_init)(struct vmbuf *, size_t) = server->slab_buffers ? vmbuf_init_slab : vmbuf_init;
+    buf_init(&ctx->request, server->init_request_size);
+    buf_init(&ctx->header, server->init_header_size);
+    buf_init(&ctx->payload, server->init_payload_size);
     size_t max_req_size = server->max_req_size;
+    /* started from the run queue, see http_server_add_connection() */
+    epoll_worker_resume_events(fd);
+    if (0 > epoll_worker_set_timeout(fd, server->header_timeout)) {
+        ribs_close(fd);
+        return;
+    }
 
 #ifdef RIBS2_SSL
     if (server->use_ssl && NULL == ribs_ssl_get(fd)) {
@@ -613,54 +1267,57 @@ void http_server_fiber_main(void) {
     }
 #endif
 
-    for (;; http_server_yield()) {
-        READ_FROM_SOCKET();
-        if (vmbuf_wlocpos(&ctx->request) > MIN_HTTP_REQ_SIZE)
-            break;
-    }
-    do {
-        if (0 == SSTRNCMP(GET, vmbuf_data(&ctx->request)) || 0 == SSTRNCMP(HEAD, vmbuf_data(&ctx->request))) {
-            /* GET or HEAD */
-            while (0 != SSTRNCMP(CRLFCRLF,  vmbuf_wloc(&ctx->request) - SSTRLEN(CRLFCRLF))) {
+    struct http_parser *parser = &ctx->parser;
+    for (;;) {
+        http_parser_init(parser);
+        ctx->stream = 0;
+        /* a pipelined request may be complete already, read before
+           yielding, events are ignored while the handler runs */
+        res = http_parser_parse(parser, vmbuf_data(&ctx->request), vmbuf_wlocpos(&ctx->request));
+        while (HTTP_PARSER_AGAIN == res) {
+            READ_FROM_SOCKET();
+            res = http_parser_parse(parser, vmbuf_data(&ctx->request), vmbuf_wlocpos(&ctx->request));
+            if (HTTP_PARSER_AGAIN == res)
                 http_server_yield();
-                READ_FROM_SOCKET();
+        }
+        char saved = 0;
+        http_body_decoder_init(&ctx->body, parser);
+        ctx->body_ofs = ctx->body.rpos;
+        do {
+            if (HTTP_PARSER_ERROR == res) {
+                ctx->persistent = 0;
+                http_server_response(HTTP_STATUS_400, HTTP_CONTENT_TYPE_TEXT_PLAIN);
+                break;
             }
-            /* make sure the string is \0 terminated */
-            /* this will overwrite the first CR */
-            *(vmbuf_wloc(&ctx->request) - SSTRLEN(CRLFCRLF)) = 0;
-            char *p = vmbuf_data(&ctx->request);
-            ctx->persistent = check_persistent(p);
-            URI = strchrnul(p, ' '); /* can't be NULL GET and HEAD constants have space at the end */
-            *URI = 0;
-            ++URI; // skip the space
-            p = strchrnul(URI, '\r'); /* HTTP/1.0 */
-            headers = p;
-            if (0 != *headers) /* are headers present? */
-                headers += SSTRLEN(CRLF); /* skip the new line */
-            *p = 0;
-            p = strchrnul(URI, ' '); /* truncate the version part */
-            *p = 0; /* \0 at the end of URI */
-
+            ctx->persistent = 0; /* until the body is consumed */
             ctx->content = NULL;
             ctx->content_len = 0;
-
-            /* minimal parsing and call user function */
-            http_server_process_request(URI, headers);
-        } else if (0 == SSTRNCMP(POST, vmbuf_data(&ctx->request)) || 0 == SSTRNCMP(PUT, vmbuf_data(&ctx->request))) {
-            /* POST or PUT */
-            for (;;) {
-                *vmbuf_wloc(&ctx->request) = 0;
-                /* wait until we have the header */
-                if (NULL != (content = strstr(vmbuf_data(&ctx->request), CRLFCRLF)))
-                    break;
-                http_server_yield();
-                READ_FROM_SOCKET();
+            /* the known methods are up to user_func (ctx->parser.method) */
+            if (HTTP_METHOD_UNKNOWN == parser->method) {
+                http_server_response(HTTP_STATUS_501, HTTP_CONTENT_TYPE_TEXT_PLAIN);
+                break;
             }
-            *content = 0; /* terminate at the first CR like in GET */
-            content += SSTRLEN(CRLFCRLF);
-            size_t content_ofs = content - vmbuf_data(&ctx->request);
-
-            if (strstr(vmbuf_data(&ctx->request), EXPECT_100)) {
+            if ((parser->flags & HTTP_PARSER_TRANSFER_ENCODING) && !(parser->flags & HTTP_PARSER_CHUNKED)) {
+                /* the length can't be determined, RFC 7230 3.3.3 */
+                http_server_response(HTTP_STATUS_400, HTTP_CONTENT_TYPE_TEXT_PLAIN);
+                break;
+            }
+            if (!(parser->flags & (HTTP_PARSER_CONTENT_LENGTH | HTTP_PARSER_CHUNKED)) &&
+                (HTTP_METHOD_POST == parser->method || HTTP_METHOD_PUT == parser->method ||
+                 HTTP_METHOD_PATCH == parser->method)) {
+                http_server_response(HTTP_STATUS_411, HTTP_CONTENT_TYPE_TEXT_PLAIN);
+                break;
+            }
+            content_length = parser->content_length;
+            if (!server->stream_body && content_length > max_req_size - parser->header_len) {
+                http_server_response(HTTP_STATUS_413, HTTP_CONTENT_TYPE_TEXT_PLAIN);
+                break;
+            }
+            /* the body is consumed from here, the connection can be reused */
+            ctx->persistent = http_parser_keep_alive(parser);
+            struct http_body_decoder *body = &ctx->body;
+            res = http_body_decode(body, vmbuf_data(&ctx->request), vmbuf_wlocpos(&ctx->request));
+            if (HTTP_PARSER_AGAIN == res && (parser->flags & HTTP_PARSER_EXPECT_CONTINUE)) {
                 vmbuf_sprintf(&ctx->header, "%s %s\r\n\r\n", HTTP_SERVER_VER, HTTP_STATUS_100);
                 if (0 > server->http_server_write(ctx)) {
                     ribs_close(fd);
@@ -668,59 +1325,121 @@ void http_server_fiber_main(void) {
                 }
                 vmbuf_reset(&ctx->header);
             }
-            ctx->persistent = check_persistent(vmbuf_data(&ctx->request));
-
-            /* parse the content length */
-            char *p = strcasestr(vmbuf_data(&ctx->request), CONTENT_LENGTH);
-            if (NULL == p) {
-                http_server_response(HTTP_STATUS_411, HTTP_CONTENT_TYPE_TEXT_PLAIN);
-                break;
-            }
-
-            p += SSTRLEN(CONTENT_LENGTH);
-            content_length = atoi(p);
-            for (;;) {
-                if (content_ofs + content_length <= vmbuf_wlocpos(&ctx->request))
+            if (!server->stream_body) {
+                /* the whole body in ctx->content, decoded in place */
+                if (0 > epoll_worker_set_timeout(fd, server->body_timeout)) {
+                    ribs_close(fd);
+                    return;
+                }
+                while (HTTP_PARSER_AGAIN == res) {
+                    http_server_yield();
+                    READ_FROM_SOCKET();
+                    res = http_body_decode(body, vmbuf_data(&ctx->request), vmbuf_wlocpos(&ctx->request));
+                }
+                if (HTTP_PARSER_ERROR == res) {
+                    ctx->persistent = 0;
+                    http_server_response(HTTP_STATUS_400, HTTP_CONTENT_TYPE_TEXT_PLAIN);
                     break;
-                http_server_yield();
-                READ_FROM_SOCKET();
+                }
+                if (parser->flags & (HTTP_PARSER_CONTENT_LENGTH | HTTP_PARSER_CHUNKED)) {
+                    ctx->content = vmbuf_data_ofs(&ctx->request, parser->header_len);
+                    ctx->content_len = body->wpos - parser->header_len;
+                    /* may be the first byte of a pipelined request */
+                    saved = ctx->content[ctx->content_len];
+                    ctx->content[ctx->content_len] = 0;
+                }
             }
-            p = vmbuf_data(&ctx->request);
-            URI = strchrnul(p, ' '); /* can't be NULL PUT and POST constants have space at the end */
-            *URI = 0;
-            ++URI; /* skip the space */
-            p = strchrnul(URI, '\r'); /* HTTP/1.0 */
-            headers = p;
-            if (0 != *headers) /* are headers present? */
-                headers += SSTRLEN(CRLF); /* skip the new line */
-            *p = 0;
-            p = strchrnul(URI, ' '); /* truncate http version */
-            *p = 0; /* \0 at the end of URI */
-            ctx->content = vmbuf_data_ofs(&ctx->request, content_ofs);
-            *(ctx->content + content_length) = 0;
-            ctx->content_len = content_length;
+            /* \0 terminate the URI and the header block in place */
+            char *data = vmbuf_data(&ctx->request);
+            URI = data + parser->uri.ofs;
+            URI[parser->uri.len] = 0;
+            data[parser->headers_end] = 0;
+            headers = parser->num_headers ? data + parser->headers_ofs : data + parser->headers_end;
 
             /* minimal parsing and call user function */
             http_server_process_request(URI, headers);
+        } while(0);
+
+        if (ctx->stream & STREAM_ACTIVE)
+            http_server_stream_end(); /* the handler did not */
+        if (vmbuf_wlocpos(&ctx->header) > 0) {
+            epoll_worker_resume_events(fd);
+            server->http_server_write(ctx);
+        }
+        /* a streamed body the handler did not read to the end */
+        if (!http_body_decoder_done(&ctx->body))
+            ctx->persistent = 0;
+        if (!ctx->persistent) {
+            ribs_close(fd);
+            return;
+        }
+        /* keep what was received past this request */
+        size_t consumed = ctx->body.rpos;
+        size_t leftover = vmbuf_wlocpos(&ctx->request) - consumed;
+        if (0 == leftover) {
+            /* EPOLLIN which arrived while the handler ran was dropped,
+               check the socket before going idle (non-blocking read,
+               also for io_uring) */
+            vmbuf_reset(&ctx->request);
+            res = (server->use_uring ? _http_server_read : server->http_server_read)(ctx);
+            if (0 >= res) {
+                ribs_close(fd);
+                return;
+            }
+            if (0 == vmbuf_wlocpos(&ctx->request))
+                break;
         } else {
-            http_server_response(HTTP_STATUS_501, HTTP_CONTENT_TYPE_TEXT_PLAIN);
-            break;
+            char *data = vmbuf_data(&ctx->request);
+            if (ctx->content)
+                ctx->content[ctx->content_len] = saved;
+            memmove(data, data + consumed, leftover);
+            vmbuf_reset(&ctx->request);
+            vmbuf_wseek(&ctx->request, leftover);
         }
-    } while(0);
-
-    if (vmbuf_wlocpos(&ctx->header) > 0) {
+        vmbuf_reset(&ctx->header);
+        vmbuf_reset(&ctx->payload);
+        if (0 > epoll_worker_set_timeout(fd, server->header_timeout)) {
+            ribs_close(fd);
+            return;
+        }
+        /* let the other connections run between pipelined requests */
+        epoll_worker_ignore_events(fd);
+        courtesy_yield();
         epoll_worker_resume_events(fd);
-        server->http_server_write(ctx);
     }
-
-    if (ctx->persistent) {
-        struct epoll_worker_fd_data *fd_data = epoll_worker_fd_map + fd;
-        fd_data->ctx = server->idle_ctx;
-        timeout_handler_add_fd_data(&server->timeout_handler, fd_data);
-    } else
+    struct epoll_worker_fd_data *fd_data = epoll_worker_fd_map + fd;
+    fd_data->ctx = server->idle_ctx;
+    if (0 > epoll_worker_set_timeout(fd, server->keepalive_timeout))
         ribs_close(fd);
 }
 
+static void http_server_peer_addr(int fd, char *buf, size_t size) {
+    union {
+        struct sockaddr sa;
+        struct sockaddr_in in;
+        struct sockaddr_in6 in6;
+    } addr;
+    socklen_t addrlen = sizeof(addr);
+    if (0 > getpeername(fd, &addr.sa, &addrlen))
+        return;
+    if (AF_INET == addr.sa.sa_family)
+        inet_ntop(AF_INET, &addr.in.sin_addr, buf, size);
+    else if (AF_INET6 == addr.sa.sa_family) {
+        /* IPv4 peers of a dual stack listener, report them as such */
+        if (IN6_IS_ADDR_V4MAPPED(&addr.in6.sin6_addr))
+            inet_ntop(AF_INET, addr.in6.sin6_addr.s6_addr + 12, buf, size);
+        else
+            inet_ntop(AF_INET6, &addr.in6.sin6_addr, buf, size);
+    }
+    /* AF_UNIX peers have no address, keep the default */
+}
+
+void http_server_parse_headers(struct http_headers *h) {
+    struct http_server_context *ctx = http_server_get_context();
+    http_headers_parse_spans(vmbuf_data(&ctx->request), &ctx->parser, h);
+    http_server_peer_addr(ctx->fd, h->peer_ip_addr, sizeof(h->peer_ip_addr));
+}
+
 static void http_server_process_request(char *uri, char *headers) {
     struct http_server_context *ctx = http_server_get_context();
     ctx->headers = headers;
@@ -735,7 +1454,12 @@ static void http_server_process_request(char *uri, char *headers) {
     }
     ctx->uri = uri;
     epoll_worker_ignore_events(ctx->fd);
-    ctx->server->user_func();
+    /* the handler may take its time, writing has its own timeout */
+    epoll_worker_clear_timeout(ctx->fd);
+    if (ctx->server->response_cache)
+        http_response_cache_serve(ctx->server->response_cache, ctx->server->user_func);
+    else
+        ctx->server->user_func();
 }
 
 int http_server_sendfile(const char *filename) {
@@ -782,13 +1506,14 @@ int http_server_sendfile_payload(int ffd, off_t size) {
     struct http_server_context *ctx = http_server_get_context();
     int fd = ctx->fd;
     int option = 1;
-    if (0 > setsockopt(fd, IPPROTO_TCP, TCP_CORK, &option, sizeof(option)))
+    int cork = AF_UNIX != ctx->server->family;
+    if (cork && 0 > setsockopt(fd, IPPROTO_TCP, TCP_CORK, &option, sizeof(option)))
         LOGGER_PERROR("TCP_CORK set");
     epoll_worker_resume_events(ctx->fd);
     ctx->server->http_server_write(ctx);
     vmbuf_reset(&ctx->header);
     int res = ctx->server->http_server_sendfile(ctx, ffd, size);
-    if (0 == res) {
+    if (0 == res && cork) {
         option = 0;
         if (0 > setsockopt(fd, IPPROTO_TCP, TCP_CORK, &option, sizeof(option)))
             LOGGER_PERROR("TCP_CORK release");
@@ -41,7 +41,7 @@ void http_vhost_add(struct http_vhost *vh, const char *name, const char *url, vo
 void http_vhost_run(struct http_vhost *vh) {
     struct http_server_context *ctx = http_server_get_context();
     struct http_headers headers;
-    http_headers_parse(ctx->headers, &headers);
+    http_server_parse_headers(&headers);
     char *p = strchrnul(headers.host, ':');
     *p = 0;
     uint32_t ofs = hashtable_lookup(&vh->ht_vhosts, headers.host, strlen(headers.host));
@@ -226,7 +226,7 @@ static int _build_index(struct vmbuf *path_buf, struct json_dom_node *node, int
 }
 
 int json_dom_build_index(struct json_dom *js, int max_level, struct hashtable *ht) {
-    static struct vmbuf path_buf = VMBUF_INITIALIZER;
+    static _RIBS_THREAD_LOCAL_ struct vmbuf path_buf = VMBUF_INITIALIZER;
     vmbuf_init(&path_buf, 4096);
     return _build_index(&path_buf, js->node->first_child, max_level, 0, ht);
 }
@@ -20,6 +20,7 @@
 #include "logger.h"
 #include "vmbuf.h"
 #include "context.h"
+#include "ribs_clock.h"
 #include <string.h>
 #include <stdio.h>
 #include <sys/types.h>
@@ -30,17 +31,15 @@
 static const char *MC_INFO  = "INFO ";
 static const char *MC_ERROR = "ERROR";
 
-static struct vmbuf log_buf = VMBUF_INITIALIZER;
+static _RIBS_THREAD_LOCAL_ struct vmbuf log_buf = VMBUF_INITIALIZER;
 
 static void begin_log_line(const char *msg_class) {
-    struct tm tm, *tmp;
     struct timeval tv;
     intmax_t usec;
     gettimeofday(&tv, NULL);
-    tmp = localtime_r(&tv.tv_sec, &tm);
     usec = tv.tv_usec;
     vmbuf_init(&log_buf, 4096);
-    vmbuf_strftime(&log_buf, "%Y-%m-%d %H:%M:%S", tmp);
+    vmbuf_strcpy(&log_buf, ribs_clock_log_prefix(tv.tv_sec));
     vmbuf_sprintf(&log_buf, ".%03jd.%03jd %d %p %s ", usec / 1000, usec % 1000, getpid(), current_ctx, msg_class);
 }
 
@@ -38,7 +38,7 @@ struct memchunks {
     struct memchunk *head;
 };
 
-static struct memchunks memchunks[NUM_CHUNK_BUCKETS] = { [0 ... NUM_CHUNK_BUCKETS-1] = {0,0,NULL} };
+static _RIBS_THREAD_LOCAL_ struct memchunks memchunks[NUM_CHUNK_BUCKETS] = { [0 ... NUM_CHUNK_BUCKETS-1] = {0,0,NULL} };
 
 static inline int _mempool_alloc_validate_size(size_t s) {
     if (s > MAX_CHUNK_SIZE)
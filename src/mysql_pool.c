@@ -22,8 +22,8 @@
 #include "logger.h"
 #include "list.h"
 
-static struct hashtable ht_idle_connections;
-static struct vmbuf misc;
+static _RIBS_THREAD_LOCAL_ struct hashtable ht_idle_connections;
+static _RIBS_THREAD_LOCAL_ struct vmbuf misc;
 
 static int create_entry(struct list *l) {
     struct mysql_pool_entry *entry = (struct mysql_pool_entry *)calloc(1, sizeof(struct mysql_pool_entry));
@@ -171,11 +171,7 @@ int _ribified_pipe(int pipefd[2]) {
 }
 
 int _ribified_nanosleep(const struct timespec *req, struct timespec *rem) {
-    int tfd = ribs_sleep_init();
-    if (0 > tfd) return -1;
-    int res = ribs_nanosleep(tfd, req, rem);
-    ribs_close(tfd);
-    return res;
+    return ribs_nanosleep(0, req, rem);
 }
 
 unsigned int _ribified_sleep(unsigned int seconds) {
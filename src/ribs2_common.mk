@@ -1,3 +1,3 @@
-SRC=context.c epoll_worker.c ctx_pool.c http_server.c hashtable.c mime_types.c http_client_pool.c timeout_handler.c ribify.c logger.c daemonize.c http_headers.c http_cookies.c file_mapper.c ds_var_field.c file_utils.c lhashtable.c search.c json.c memalloc.c mempool.c sleep.c timer.c timer_worker.c ringbuf.c ringfile.c sendemail.c ds_loader.c heap.c vmallocator.c base64.c http_file_server.c http_vhost.c thashtable.c json_dom.c vmbuf.c hashtable_vect.c code_gen_ds_loader.c minunit.c kmeans.c
+SRC=context.c epoll_worker.c epoll_worker_threads.c epoll_worker_health.c epoll_worker_watchdog.c ribs_uring.c ribs_offload.c ribs_offload_pool.c ribs_task.c ribs_sync.c ctx_pool.c http_server.c hashtable.c mime_types.c http_client_pool.c timeout_handler.c ribify.c logger.c daemonize.c http_headers.c http_parser.c http_cookies.c file_mapper.c ds_var_field.c file_utils.c lhashtable.c search.c json.c memalloc.c mempool.c sleep.c timer.c timer_worker.c timer_wheel.c ribs_clock.c ringbuf.c ringfile.c sendemail.c ds_loader.c heap.c vmallocator.c base64.c http_file_server.c http_vhost.c http_response_cache.c http_router.c thashtable.c json_dom.c vmbuf.c hashtable_vect.c code_gen_ds_loader.c minunit.c kmeans.c
 ASM=context_asm.S
 CFLAGS+= -I ../include
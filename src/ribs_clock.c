@@ -0,0 +1,48 @@
+/*
+    This file is part of RIBS2.0 (Robust Infrastructure for Backend Systems).
+    RIBS is an infrastructure for building great SaaS applications (but not
+    limited to).
+
+    Copyright (C) 2015 TrueSkills, Inc.
+
+    RIBS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, version 2.1 of the License.
+
+    RIBS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with RIBS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "ribs_clock.h"
+
+_RIBS_THREAD_LOCAL_ struct ribs_clock ribs_clock;
+
+void ribs_clock_update(void) {
+    clock_gettime(CLOCK_MONOTONIC, &ribs_clock.monotonic);
+    clock_gettime(CLOCK_REALTIME_COARSE, &ribs_clock.realtime);
+}
+
+const char *ribs_clock_http_date(void) {
+    time_t t = ribs_clock_time();
+    if (t != ribs_clock.http_date_sec) {
+        struct tm tm;
+        gmtime_r(&t, &tm);
+        strftime(ribs_clock.http_date, sizeof(ribs_clock.http_date), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+        ribs_clock.http_date_sec = t;
+    }
+    return ribs_clock.http_date;
+}
+
+const char *ribs_clock_log_prefix(time_t t) {
+    if (t != ribs_clock.log_prefix_sec || 0 == *ribs_clock.log_prefix) {
+        struct tm tm;
+        localtime_r(&t, &tm);
+        strftime(ribs_clock.log_prefix, sizeof(ribs_clock.log_prefix), "%Y-%m-%d %H:%M:%S", &tm);
+        ribs_clock.log_prefix_sec = t;
+    }
+    return ribs_clock.log_prefix;
+}
@@ -0,0 +1,142 @@
+/*
+    This file is part of RIBS2.0 (Robust Infrastructure for Backend Systems).
+    RIBS is an infrastructure for building great SaaS applications (but not
+    limited to).
+
+    Copyright (C) 2015 TrueSkills, Inc.
+
+    RIBS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, version 2.1 of the License.
+
+    RIBS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with RIBS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "ribs_offload.h"
+#include "epoll_worker.h"
+#include "logger.h"
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+
+struct ribs_offload_loop {
+    int event_fd;
+    struct ribs_offload_job *completed; /* pushed by the pool threads */
+};
+
+void (*ribs_offload_submit)(struct ribs_offload_job *job) = NULL;
+static _RIBS_THREAD_LOCAL_ struct ribs_offload_loop *offload_loop = NULL;
+
+static void ribs_offload_completion_handler(void) {
+    struct ribs_offload_loop *loop = *(struct ribs_offload_loop **)current_ctx->reserved;
+    uint64_t n;
+    for (;;yield()) {
+        if (0 > read(loop->event_fd, &n, sizeof(n)) && EAGAIN != errno)
+            LOGGER_PERROR("read eventfd");
+        struct ribs_offload_job *job = __sync_lock_test_and_set(&loop->completed, NULL);
+        while (job) {
+            struct ribs_offload_job *next = job->next;
+            job->done = 1;
+            epoll_worker_queue_ctx(job->ctx);
+            job = next;
+        }
+    }
+}
+
+static struct ribs_offload_loop *get_loop(void) {
+    if (offload_loop)
+        return offload_loop;
+    struct ribs_offload_loop *loop = calloc(1, sizeof(struct ribs_offload_loop));
+    if (NULL == loop)
+        return LOGGER_PERROR("calloc"), NULL;
+    loop->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (0 > loop->event_fd)
+        return LOGGER_PERROR("eventfd"), free(loop), NULL;
+    struct ribs_context *ctx = small_ctx_for_fd(loop->event_fd, sizeof(struct ribs_offload_loop *), ribs_offload_completion_handler);
+    if (NULL == ctx)
+        return close(loop->event_fd), free(loop), NULL;
+    *(struct ribs_offload_loop **)ctx->reserved = loop;
+    return offload_loop = loop;
+}
+
+void ribs_offload_complete(struct ribs_offload_job *job) {
+    struct ribs_offload_loop *loop = job->loop;
+    struct ribs_offload_job *head;
+    do {
+        head = loop->completed;
+        job->next = head;
+    } while (!__sync_bool_compare_and_swap(&loop->completed, head, job));
+    uint64_t one = 1;
+    if (sizeof(one) != write(loop->event_fd, &one, sizeof(one)))
+        LOGGER_PERROR("write eventfd");
+}
+
+long ribs_offload(long (*func)(void *arg), void *arg) {
+    struct ribs_offload_loop *loop;
+    /* only ribbons have an entry function */
+    if (NULL == ribs_offload_submit || NULL == current_ctx->entry_func || current_ctx == event_loop_ctx ||
+        NULL == (loop = get_loop()))
+        return func(arg);
+    struct ribs_offload_job job = { func, arg, 0, 0, 0, current_ctx, loop, NULL };
+    ribs_offload_submit(&job);
+    while (!job.done)
+        yield();
+    errno = job.err;
+    return job.result;
+}
+
+struct ftruncate_args {
+    int fd;
+    off_t length;
+};
+
+static long _ftruncate(void *arg) {
+    struct ftruncate_args *args = (struct ftruncate_args *)arg;
+    return ftruncate(args->fd, args->length);
+}
+
+int ribs_offload_ftruncate(int fd, off_t length) {
+    struct ftruncate_args args = { fd, length };
+    return ribs_offload(_ftruncate, &args);
+}
+
+struct mmap_args {
+    void *addr;
+    size_t length;
+    int prot;
+    int flags;
+    int fd;
+    off_t offset;
+};
+
+static long _mmap(void *arg) {
+    struct mmap_args *args = (struct mmap_args *)arg;
+    return (long)mmap(args->addr, args->length, args->prot, args->flags, args->fd, args->offset);
+}
+
+void *ribs_offload_mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset) {
+    struct mmap_args args = { addr, length, prot, flags, fd, offset };
+    return (void *)ribs_offload(_mmap, &args);
+}
+
+struct realpath_args {
+    const char *path;
+    char *resolved_path;
+};
+
+static long _realpath(void *arg) {
+    struct realpath_args *args = (struct realpath_args *)arg;
+    return (long)realpath(args->path, args->resolved_path);
+}
+
+char *ribs_offload_realpath(const char *path, char *resolved_path) {
+    struct realpath_args args = { path, resolved_path };
+    return (char *)ribs_offload(_realpath, &args);
+}
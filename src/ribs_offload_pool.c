@@ -0,0 +1,78 @@
+/*
+    This file is part of RIBS2.0 (Robust Infrastructure for Backend Systems).
+    RIBS is an infrastructure for building great SaaS applications (but not
+    limited to).
+
+    Copyright (C) 2015 TrueSkills, Inc.
+
+    RIBS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, version 2.1 of the License.
+
+    RIBS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with RIBS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "ribs_offload.h"
+#include "logger.h"
+#include <pthread.h>
+#include <errno.h>
+
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static struct ribs_offload_job *queue_head = NULL, *queue_tail = NULL;
+
+static void pool_submit(struct ribs_offload_job *job) {
+    job->next = NULL;
+    pthread_mutex_lock(&queue_mutex);
+    if (queue_tail)
+        queue_tail->next = job;
+    else
+        queue_head = job;
+    queue_tail = job;
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_mutex);
+}
+
+static void *pool_thread(void *arg) {
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&queue_mutex);
+        while (NULL == queue_head)
+            pthread_cond_wait(&queue_cond, &queue_mutex);
+        struct ribs_offload_job *job = queue_head;
+        if (NULL == (queue_head = job->next))
+            queue_tail = NULL;
+        pthread_mutex_unlock(&queue_mutex);
+        errno = 0;
+        job->result = job->func(job->arg);
+        job->err = errno;
+        ribs_offload_complete(job);
+    }
+    return NULL;
+}
+
+int ribs_offload_init(int num_threads) {
+    if (ribs_offload_submit)
+        return 0;
+    if (0 >= num_threads)
+        return LOGGER_ERROR("invalid number of offload threads: %d", num_threads), -1;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int i, err = 0;
+    for (i = 0; i < num_threads && 0 == err; ++i) {
+        pthread_t t;
+        err = pthread_create(&t, &attr, pool_thread, NULL);
+    }
+    pthread_attr_destroy(&attr);
+    if (0 != err)
+        return errno = err, LOGGER_PERROR("pthread_create"), -1;
+    ribs_offload_submit = pool_submit;
+    LOGGER_INFO("offload threads: %d", num_threads);
+    return 0;
+}
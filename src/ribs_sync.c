@@ -0,0 +1,143 @@
+/*
+    This file is part of RIBS2.0 (Robust Infrastructure for Backend Systems).
+    RIBS is an infrastructure for building great SaaS applications (but not
+    limited to).
+
+    Copyright (C) 2015 TrueSkills, Inc.
+
+    RIBS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, version 2.1 of the License.
+
+    RIBS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with RIBS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "ribs_sync.h"
+#include "logger.h"
+#include <errno.h>
+
+/* returns 0 when woken up by the owner of the wait list */
+static int wait_on(struct list *wait_list, int timeout_ms, int cancellable) {
+    struct ribs_deadline deadline;
+    if (0 > ribs_deadline_arm(&deadline, timeout_ms))
+        return -1;
+    struct ribs_waiter waiter;
+    ribs_waiter_add(wait_list, &waiter);
+    int res = 0;
+    while (!ribs_waiter_woken(&waiter)) {
+        if (ribs_deadline_expired(&deadline)) {
+            errno = ETIMEDOUT;
+            res = -1;
+        } else if (cancellable && ribs_task_cancelled()) {
+            errno = ECANCELED;
+            res = -1;
+        } else {
+            yield();
+            continue;
+        }
+        ribs_waiter_remove(&waiter);
+        break;
+    }
+    ribs_deadline_disarm(&deadline);
+    return res;
+}
+
+/*
+ * semaphore
+ */
+void ribs_sem_init(struct ribs_sem *sem, int count) {
+    sem->count = count;
+    list_init(&sem->waiters);
+}
+
+int ribs_sem_trywait(struct ribs_sem *sem) {
+    if (0 >= sem->count)
+        return errno = EAGAIN, -1;
+    --sem->count;
+    return 0;
+}
+
+int ribs_sem_wait(struct ribs_sem *sem, int timeout_ms) {
+    if (0 == ribs_sem_trywait(sem))
+        return 0;
+    /* ribs_sem_post() hands over the unit */
+    return wait_on(&sem->waiters, timeout_ms, 1);
+}
+
+void ribs_sem_post(struct ribs_sem *sem) {
+    if (!ribs_wait_list_wake_one(&sem->waiters))
+        ++sem->count;
+}
+
+/*
+ * mutex
+ */
+void ribs_mutex_init(struct ribs_mutex *mutex) {
+    mutex->owner = NULL;
+    list_init(&mutex->waiters);
+}
+
+int ribs_mutex_trylock(struct ribs_mutex *mutex) {
+    if (NULL != mutex->owner)
+        return errno = EBUSY, -1;
+    mutex->owner = current_ctx;
+    return 0;
+}
+
+int ribs_mutex_lock(struct ribs_mutex *mutex, int timeout_ms) {
+    if (0 == ribs_mutex_trylock(mutex))
+        return 0;
+    if (current_ctx == mutex->owner)
+        return errno = EDEADLK, -1;
+    /* ribs_mutex_unlock() hands over the ownership */
+    return wait_on(&mutex->waiters, timeout_ms, 1);
+}
+
+/* not cancellable, ribs_cond_wait() must return with the mutex locked */
+static void mutex_relock(struct ribs_mutex *mutex) {
+    if (0 == ribs_mutex_trylock(mutex))
+        return;
+    wait_on(&mutex->waiters, -1, 0);
+}
+
+int ribs_mutex_unlock(struct ribs_mutex *mutex) {
+    if (current_ctx != mutex->owner)
+        return LOGGER_ERROR("mutex is not owned by the current ribbon"), errno = EPERM, -1;
+    if (list_empty(&mutex->waiters))
+        mutex->owner = NULL;
+    else {
+        mutex->owner = LIST_ENTRY(list_head(&mutex->waiters), struct ribs_waiter, list)->ctx;
+        ribs_wait_list_wake_one(&mutex->waiters);
+    }
+    return 0;
+}
+
+/*
+ * condition variable
+ */
+void ribs_cond_init(struct ribs_cond *cond) {
+    list_init(&cond->waiters);
+}
+
+int ribs_cond_wait(struct ribs_cond *cond, struct ribs_mutex *mutex, int timeout_ms) {
+    if (0 > ribs_mutex_unlock(mutex))
+        return -1;
+    int res = wait_on(&cond->waiters, timeout_ms, 1);
+    int err = errno;
+    mutex_relock(mutex);
+    errno = err;
+    return res;
+}
+
+void ribs_cond_signal(struct ribs_cond *cond) {
+    ribs_wait_list_wake_one(&cond->waiters);
+}
+
+void ribs_cond_broadcast(struct ribs_cond *cond) {
+    ribs_wait_list_wake_all(&cond->waiters);
+}
@@ -0,0 +1,253 @@
+/*
+    This file is part of RIBS2.0 (Robust Infrastructure for Backend Systems).
+    RIBS is an infrastructure for building great SaaS applications (but not
+    limited to).
+
+    Copyright (C) 2015 TrueSkills, Inc.
+
+    RIBS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, version 2.1 of the License.
+
+    RIBS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with RIBS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "ribs_task.h"
+#include "logger.h"
+#include <stdlib.h>
+#include <errno.h>
+
+static _RIBS_THREAD_LOCAL_ struct ctx_pool default_ctx_pool;
+static _RIBS_THREAD_LOCAL_ int default_ctx_pool_ready = 0;
+
+/*
+ * tasks
+ */
+static void ribs_task_main(void) {
+    struct ribs_task *task = *(struct ribs_task **)current_ctx->reserved;
+    struct ribs_group *group = task->group;
+    task->result = task->func(task->arg);
+    task->done = 1;
+    list_remove(&task->group_tasks);
+    if (0 > task->result) {
+        if (0 == group->error)
+            group->error = task->result;
+        if (group->cancel_on_error)
+            ribs_group_cancel(group);
+    }
+    if (task->joiner)
+        epoll_worker_queue_ctx(task->joiner);
+    if (0 == --group->num_running && group->waiter)
+        epoll_worker_queue_ctx(group->waiter);
+    /* woken up by a cancel but finished through another wakeup */
+    epoll_worker_dequeue_ctx(current_ctx);
+    ctx_pool_put(group->ctx_pool, current_ctx);
+}
+
+int ribs_group_init(struct ribs_group *group, struct ctx_pool *ctx_pool) {
+    if (NULL == ctx_pool) {
+        if (!default_ctx_pool_ready) {
+            if (0 > ctx_pool_init(&default_ctx_pool, 16, 16, RIBS_TASK_DEFAULT_STACK_SIZE, sizeof(struct ribs_task *)))
+                return -1;
+            default_ctx_pool_ready = 1;
+        }
+        ctx_pool = &default_ctx_pool;
+    } else if (ctx_pool->reserved_size < sizeof(struct ribs_task *))
+        return LOGGER_ERROR("ctx_pool reserved size is too small for tasks"), -1;
+    group->ctx_pool = ctx_pool;
+    list_init(&group->tasks);
+    group->num_running = 0;
+    group->cancelled = 0;
+    group->cancel_on_error = 0;
+    group->error = 0;
+    group->waiter = NULL;
+    return 0;
+}
+
+int ribs_task_spawn(struct ribs_group *group, struct ribs_task *task, int (*func)(void *arg), void *arg) {
+    struct ribs_context *ctx = ctx_pool_get(group->ctx_pool);
+    if (NULL == ctx)
+        return LOGGER_ERROR("failed to allocate task context"), -1;
+    ribs_makecontext(ctx, event_loop_ctx, ribs_task_main);
+    *(struct ribs_task **)ctx->reserved = task;
+    task->group = group;
+    task->func = func;
+    task->arg = arg;
+    task->result = 0;
+    task->done = 0;
+    task->ctx = ctx;
+    task->joiner = NULL;
+    list_insert_tail(&group->tasks, &task->group_tasks);
+    ++group->num_running;
+    epoll_worker_queue_ctx(ctx);
+    return 0;
+}
+
+int ribs_task_join(struct ribs_task *task) {
+    while (!task->done) {
+        task->joiner = current_ctx;
+        yield();
+    }
+    task->joiner = NULL;
+    return task->result;
+}
+
+int ribs_group_wait(struct ribs_group *group, int timeout_ms) {
+    if (0 == group->num_running)
+        return 0;
+    struct ribs_deadline deadline;
+    if (0 > ribs_deadline_arm(&deadline, timeout_ms))
+        return -1;
+    int res = 0;
+    group->waiter = current_ctx;
+    while (0 < group->num_running) {
+        yield();
+        if (ribs_deadline_expired(&deadline)) {
+            errno = ETIMEDOUT;
+            res = -1;
+            break;
+        }
+    }
+    group->waiter = NULL;
+    ribs_deadline_disarm(&deadline);
+    return res;
+}
+
+void ribs_group_cancel(struct ribs_group *group) {
+    group->cancelled = 1;
+    struct list *it;
+    /* wake them up so they can notice */
+    LIST_FOR_EACH(&group->tasks, it) {
+        struct ribs_task *task = LIST_ENTRY(it, struct ribs_task, group_tasks);
+        if (task->ctx != current_ctx)
+            epoll_worker_queue_ctx(task->ctx);
+    }
+}
+
+struct ribs_task *ribs_task_self(void) {
+    if (ribs_task_main != current_ctx->entry_func)
+        return NULL;
+    return *(struct ribs_task **)current_ctx->reserved;
+}
+
+int ribs_task_cancelled(void) {
+    struct ribs_task *task = ribs_task_self();
+    return task && task->group->cancelled;
+}
+
+/*
+ * channels
+ */
+int ribs_chan_init(struct ribs_chan *chan, uint32_t size) {
+    if (0 == size)
+        return LOGGER_ERROR("invalid channel size"), -1;
+    chan->buf = calloc(size, sizeof(void *));
+    if (NULL == chan->buf)
+        return LOGGER_PERROR("calloc"), -1;
+    chan->size = size;
+    chan->head = 0;
+    chan->count = 0;
+    chan->closed = 0;
+    list_init(&chan->senders);
+    list_init(&chan->receivers);
+    return 0;
+}
+
+void ribs_chan_free(struct ribs_chan *chan) {
+    free(chan->buf);
+    chan->buf = NULL;
+}
+
+int ribs_chan_try_send(struct ribs_chan *chan, void *item) {
+    if (chan->closed)
+        return errno = EPIPE, -1;
+    if (chan->count == chan->size)
+        return errno = EAGAIN, -1;
+    uint32_t tail = chan->head + chan->count;
+    if (tail >= chan->size)
+        tail -= chan->size;
+    chan->buf[tail] = item;
+    ++chan->count;
+    ribs_wait_list_wake_one(&chan->receivers);
+    return 0;
+}
+
+int ribs_chan_try_recv(struct ribs_chan *chan, void **item) {
+    if (0 == chan->count)
+        return errno = chan->closed ? EPIPE : EAGAIN, -1;
+    *item = chan->buf[chan->head];
+    if (++chan->head == chan->size)
+        chan->head = 0;
+    --chan->count;
+    ribs_wait_list_wake_one(&chan->senders);
+    return 0;
+}
+
+static int chan_wait(struct list *wait_list) {
+    if (ribs_task_cancelled())
+        return errno = ECANCELED, -1;
+    struct ribs_waiter waiter;
+    ribs_waiter_add(wait_list, &waiter);
+    yield();
+    int woken = ribs_waiter_woken(&waiter);
+    ribs_waiter_remove(&waiter);
+    if (ribs_task_cancelled()) {
+        /* pass it on */
+        if (woken)
+            ribs_wait_list_wake_one(wait_list);
+        return errno = ECANCELED, -1;
+    }
+    return 0;
+}
+
+int ribs_chan_send(struct ribs_chan *chan, void *item) {
+    while (0 > ribs_chan_try_send(chan, item)) {
+        if (EAGAIN != errno || 0 > chan_wait(&chan->senders))
+            return -1;
+    }
+    return 0;
+}
+
+int ribs_chan_recv(struct ribs_chan *chan, void **item) {
+    while (0 > ribs_chan_try_recv(chan, item)) {
+        if (EAGAIN != errno || 0 > chan_wait(&chan->receivers))
+            return -1;
+    }
+    return 0;
+}
+
+void ribs_chan_close(struct ribs_chan *chan) {
+    chan->closed = 1;
+    ribs_wait_list_wake_all(&chan->senders);
+    ribs_wait_list_wake_all(&chan->receivers);
+}
+
+/*
+ * deadlines
+ */
+int ribs_deadline_arm(struct ribs_deadline *deadline, int timeout_ms) {
+    deadline->armed = 0;
+    if (0 > timeout_ms)
+        return 0;
+    timer_wheel_entry_init(&deadline->timer, timer_wheel_wakeup, current_ctx);
+    if (0 > timer_wheel_add(&deadline->timer, timeout_ms))
+        return -1;
+    deadline->armed = 1;
+    return 0;
+}
+
+int ribs_deadline_expired(struct ribs_deadline *deadline) {
+    return deadline->armed && !timer_wheel_pending(&deadline->timer);
+}
+
+void ribs_deadline_disarm(struct ribs_deadline *deadline) {
+    if (!deadline->armed)
+        return;
+    deadline->armed = 0;
+    timer_wheel_cancel(&deadline->timer);
+}
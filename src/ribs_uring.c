@@ -0,0 +1,358 @@
+/*
+    This file is part of RIBS2.0 (Robust Infrastructure for Backend Systems).
+    RIBS is an infrastructure for building great SaaS applications (but not
+    limited to).
+
+    Copyright (C) 2015 TrueSkills, Inc.
+
+    RIBS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, version 2.1 of the License.
+
+    RIBS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with RIBS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "ribs_uring.h"
+#include "epoll_worker.h"
+#include "logger.h"
+#include <errno.h>
+
+_RIBS_THREAD_LOCAL_ unsigned ribs_uring_num_pending = 0;
+
+#ifdef HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/epoll.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <string.h>
+
+#define SENDFILE_CHUNK_SIZE (64*1024)
+#define MAX_CACHED_PIPES 64
+
+struct ribs_uring_req {
+    struct ribs_context *ctx;
+    int res;
+    int done;
+};
+
+static _RIBS_THREAD_LOCAL_ int ring_fd = -1;
+static _RIBS_THREAD_LOCAL_ int event_fd = -1;
+
+static _RIBS_THREAD_LOCAL_ struct {
+    unsigned *head;
+    unsigned *tail;
+    unsigned *ring_mask;
+    unsigned *array;
+    unsigned entries;
+    unsigned local_tail;
+    struct io_uring_sqe *sqes;
+} sq;
+
+static _RIBS_THREAD_LOCAL_ struct {
+    unsigned *head;
+    unsigned *tail;
+    unsigned *ring_mask;
+    struct io_uring_cqe *cqes;
+} cq;
+
+/* pipes used by ribs_uring_sendfile */
+static _RIBS_THREAD_LOCAL_ int cached_pipes[MAX_CACHED_PIPES][2];
+static _RIBS_THREAD_LOCAL_ int num_cached_pipes = 0;
+
+static void uring_completion_handler(void) {
+    uint64_t num;
+    for (;;yield()) {
+        if (0 > read(event_fd, &num, sizeof(num)) && EAGAIN != errno)
+            LOGGER_PERROR("read eventfd");
+        unsigned head = *cq.head;
+        unsigned tail = __atomic_load_n(cq.tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            struct io_uring_cqe *cqe = cq.cqes + (head & *cq.ring_mask);
+            struct ribs_uring_req *req = (struct ribs_uring_req *)(uintptr_t)cqe->user_data;
+            req->res = cqe->res;
+            req->done = 1;
+            epoll_worker_queue_ctx(req->ctx);
+        }
+        __atomic_store_n(cq.head, head, __ATOMIC_RELEASE);
+    }
+}
+
+static inline struct io_uring_sqe *_ribs_uring_get_sqe(uint8_t opcode, int fd) {
+    if (sq.local_tail - __atomic_load_n(sq.head, __ATOMIC_ACQUIRE) >= sq.entries)
+        ribs_uring_submit();
+    struct io_uring_sqe *sqe = sq.sqes + (sq.local_tail & *sq.ring_mask);
+    ++sq.local_tail;
+    ++ribs_uring_num_pending;
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    return sqe;
+}
+
+static inline int _ribs_uring_wait(struct io_uring_sqe *sqe) {
+    struct ribs_uring_req req = { .ctx = current_ctx, .res = 0, .done = 0 };
+    sqe->user_data = (uintptr_t)&req;
+    /* the fd may still be registered with epoll, ignore its events
+       until our completion arrives */
+    int fd = sqe->fd;
+    int ignore = 0 <= fd && epoll_worker_fd_map[fd].ctx == current_ctx;
+    if (ignore)
+        epoll_worker_ignore_events(fd);
+    while (!req.done)
+        yield();
+    if (ignore)
+        epoll_worker_resume_events(fd);
+    if (0 > req.res)
+        return errno = -req.res, -1;
+    return req.res;
+}
+
+int ribs_uring_init(unsigned entries) {
+    if (0 <= ring_fd)
+        return 0;
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring_fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (0 > ring_fd)
+        return LOGGER_PERROR("io_uring_setup"), -1;
+
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP && cq_size > sq_size)
+        sq_size = cq_size;
+    void *sq_ring = mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (MAP_FAILED == sq_ring)
+        return LOGGER_PERROR("mmap sq ring"), close(ring_fd), ring_fd = -1;
+    void *cq_ring = sq_ring;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        cq_ring = mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if (MAP_FAILED == cq_ring)
+            return LOGGER_PERROR("mmap cq ring"), close(ring_fd), ring_fd = -1;
+    }
+    sq.sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (MAP_FAILED == sq.sqes)
+        return LOGGER_PERROR("mmap sqes"), close(ring_fd), ring_fd = -1;
+
+    sq.head = sq_ring + params.sq_off.head;
+    sq.tail = sq_ring + params.sq_off.tail;
+    sq.ring_mask = sq_ring + params.sq_off.ring_mask;
+    sq.array = sq_ring + params.sq_off.array;
+    sq.entries = params.sq_entries;
+    sq.local_tail = *sq.tail;
+    unsigned i;
+    for (i = 0; i < sq.entries; ++i)
+        sq.array[i] = i;
+    cq.head = cq_ring + params.cq_off.head;
+    cq.tail = cq_ring + params.cq_off.tail;
+    cq.ring_mask = cq_ring + params.cq_off.ring_mask;
+    cq.cqes = cq_ring + params.cq_off.cqes;
+
+    /* completions are signaled through an eventfd watched by epoll */
+    event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (0 > event_fd)
+        return LOGGER_PERROR("eventfd"), close(ring_fd), ring_fd = -1;
+    if (0 > syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_EVENTFD, &event_fd, 1))
+        return LOGGER_PERROR("io_uring_register eventfd"), close(event_fd), close(ring_fd), ring_fd = -1;
+    if (NULL == small_ctx_for_fd(event_fd, 0, uring_completion_handler))
+        return close(event_fd), close(ring_fd), ring_fd = -1;
+    LOGGER_INFO("io_uring initialized: sq entries=%u, cq entries=%u", params.sq_entries, params.cq_entries);
+    return 0;
+}
+
+int ribs_uring_submit(void) {
+    unsigned n = ribs_uring_num_pending;
+    __atomic_store_n(sq.tail, sq.local_tail, __ATOMIC_RELEASE);
+    while (0 < n) {
+        int res = syscall(__NR_io_uring_enter, ring_fd, n, 0, 0, NULL, 0);
+        if (0 > res) {
+            if (EINTR == errno)
+                continue;
+            ribs_uring_num_pending = n;
+            return LOGGER_PERROR("io_uring_enter"), -1;
+        }
+        n -= res;
+    }
+    ribs_uring_num_pending = 0;
+    return 0;
+}
+
+ssize_t ribs_uring_recv(int fd, void *buf, size_t len, int flags) {
+    struct io_uring_sqe *sqe = _ribs_uring_get_sqe(IORING_OP_RECV, fd);
+    sqe->addr = (uintptr_t)buf;
+    sqe->len = len;
+    sqe->msg_flags = flags;
+    return _ribs_uring_wait(sqe);
+}
+
+ssize_t ribs_uring_send(int fd, const void *buf, size_t len, int flags) {
+    struct io_uring_sqe *sqe = _ribs_uring_get_sqe(IORING_OP_SEND, fd);
+    sqe->addr = (uintptr_t)buf;
+    sqe->len = len;
+    sqe->msg_flags = flags;
+    return _ribs_uring_wait(sqe);
+}
+
+ssize_t ribs_uring_writev(int fd, const struct iovec *iov, int iovcnt) {
+    struct io_uring_sqe *sqe = _ribs_uring_get_sqe(IORING_OP_WRITEV, fd);
+    sqe->addr = (uintptr_t)iov;
+    sqe->len = iovcnt;
+    sqe->off = (uint64_t)-1;
+    return _ribs_uring_wait(sqe);
+}
+
+int ribs_uring_accept(int fd, struct sockaddr *addr, socklen_t *addrlen, int flags) {
+    struct io_uring_sqe *sqe = _ribs_uring_get_sqe(IORING_OP_ACCEPT, fd);
+    sqe->addr = (uintptr_t)addr;
+    sqe->addr2 = (uintptr_t)addrlen;
+    sqe->accept_flags = flags;
+    return _ribs_uring_wait(sqe);
+}
+
+ssize_t ribs_uring_splice(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out, size_t len, unsigned int flags) {
+    struct io_uring_sqe *sqe = _ribs_uring_get_sqe(IORING_OP_SPLICE, fd_out);
+    sqe->splice_fd_in = fd_in;
+    sqe->splice_off_in = off_in ? (uint64_t)*off_in : (uint64_t)-1;
+    sqe->off = off_out ? (uint64_t)*off_out : (uint64_t)-1;
+    sqe->len = len;
+    sqe->splice_flags = flags;
+    ssize_t res = _ribs_uring_wait(sqe);
+    if (0 < res) {
+        if (off_in) *off_in += res;
+        if (off_out) *off_out += res;
+    }
+    return res;
+}
+
+int ribs_uring_poll(int fd, short events) {
+    struct io_uring_sqe *sqe = _ribs_uring_get_sqe(IORING_OP_POLL_ADD, fd);
+    sqe->poll32_events = events;
+    return _ribs_uring_wait(sqe);
+}
+
+static void ribs_uring_put_pipe(int pfd[2]) {
+    if (MAX_CACHED_PIPES > num_cached_pipes) {
+        cached_pipes[num_cached_pipes][0] = pfd[0];
+        cached_pipes[num_cached_pipes][1] = pfd[1];
+        ++num_cached_pipes;
+    } else {
+        close(pfd[0]);
+        close(pfd[1]);
+    }
+}
+
+ssize_t ribs_uring_sendfile(int out_fd, int in_fd, off_t *offset, size_t count) {
+    int pfd[2];
+    if (0 < num_cached_pipes) {
+        --num_cached_pipes;
+        pfd[0] = cached_pipes[num_cached_pipes][0];
+        pfd[1] = cached_pipes[num_cached_pipes][1];
+    } else if (0 > pipe2(pfd, O_CLOEXEC))
+        return LOGGER_PERROR("pipe2"), -1;
+
+    size_t total = 0;
+    while (total < count) {
+        size_t chunk = count - total < SENDFILE_CHUNK_SIZE ? count - total : SENDFILE_CHUNK_SIZE;
+        loff_t ofs = *offset;
+        ssize_t num_in = ribs_uring_splice(in_fd, &ofs, pfd[1], NULL, chunk, SPLICE_F_MOVE);
+        if (0 > num_in && 0 == total) {
+            /* nothing was moved, the pipe is still empty */
+            int err = errno;
+            ribs_uring_put_pipe(pfd);
+            return errno = err, -1;
+        }
+        if (0 >= num_in)
+            break; /* end of file, or an error to report next time */
+        ssize_t num_out = 0;
+        while (num_out < num_in) {
+            ssize_t res = ribs_uring_splice(pfd[0], NULL, out_fd, NULL, num_in - num_out, SPLICE_F_MOVE | SPLICE_F_MORE);
+            if (0 < res) {
+                num_out += res;
+                continue;
+            }
+            if (0 > res && EAGAIN == errno && 0 <= ribs_uring_poll(out_fd, POLLOUT))
+                continue;
+            /* data left in the pipe, don't reuse it */
+            int err = 0 == res ? EPIPE : errno;
+            close(pfd[0]);
+            close(pfd[1]);
+            *offset += num_out;
+            total += num_out;
+            return errno = err, -1;
+        }
+        *offset += num_out;
+        total += num_out;
+    }
+    ribs_uring_put_pipe(pfd);
+    return total;
+}
+
+int ribs_uring_timeout(const struct timespec *ts) {
+    struct __kernel_timespec kts = { .tv_sec = ts->tv_sec, .tv_nsec = ts->tv_nsec };
+    struct io_uring_sqe *sqe = _ribs_uring_get_sqe(IORING_OP_TIMEOUT, -1);
+    sqe->addr = (uintptr_t)&kts;
+    sqe->len = 1;
+    if (0 > _ribs_uring_wait(sqe) && ETIME != errno)
+        return -1;
+    return 0;
+}
+
+#else /* HAVE_IO_URING */
+
+int ribs_uring_init(unsigned entries) {
+    (void)entries;
+    return LOGGER_ERROR("io_uring support was not compiled in"), errno = ENOSYS, -1;
+}
+
+int ribs_uring_submit(void) {
+    return errno = ENOSYS, -1;
+}
+
+ssize_t ribs_uring_recv(int fd, void *buf, size_t len, int flags) {
+    (void)fd; (void)buf; (void)len; (void)flags;
+    return errno = ENOSYS, -1;
+}
+
+ssize_t ribs_uring_send(int fd, const void *buf, size_t len, int flags) {
+    (void)fd; (void)buf; (void)len; (void)flags;
+    return errno = ENOSYS, -1;
+}
+
+ssize_t ribs_uring_writev(int fd, const struct iovec *iov, int iovcnt) {
+    (void)fd; (void)iov; (void)iovcnt;
+    return errno = ENOSYS, -1;
+}
+
+int ribs_uring_accept(int fd, struct sockaddr *addr, socklen_t *addrlen, int flags) {
+    (void)fd; (void)addr; (void)addrlen; (void)flags;
+    return errno = ENOSYS, -1;
+}
+
+ssize_t ribs_uring_splice(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out, size_t len, unsigned int flags) {
+    (void)fd_in; (void)off_in; (void)fd_out; (void)off_out; (void)len; (void)flags;
+    return errno = ENOSYS, -1;
+}
+
+int ribs_uring_poll(int fd, short events) {
+    (void)fd; (void)events;
+    return errno = ENOSYS, -1;
+}
+
+ssize_t ribs_uring_sendfile(int out_fd, int in_fd, off_t *offset, size_t count) {
+    (void)out_fd; (void)in_fd; (void)offset; (void)count;
+    return errno = ENOSYS, -1;
+}
+
+int ribs_uring_timeout(const struct timespec *ts) {
+    (void)ts;
+    return errno = ENOSYS, -1;
+}
+
+#endif /* HAVE_IO_URING */
@@ -30,7 +30,7 @@ static void _zfree(void *_vmb UNUSED_ARG, void *ptr UNUSED_ARG) {
 }
 
 static inline void _init_alloc(z_stream *strm) {
-    static struct vmbuf zalloc_buf = VMBUF_INITIALIZER;
+    static _RIBS_THREAD_LOCAL_ struct vmbuf zalloc_buf = VMBUF_INITIALIZER;
     vmbuf_init(&zalloc_buf, 1024*1024*2);
     strm->zalloc = _zalloc;
     strm->zfree = _zfree;
@@ -42,7 +42,7 @@ int vmbuf_deflate(struct vmbuf *buf) {
 }
 
 int vmbuf_deflate3(struct vmbuf *buf, int level) {
-    static struct vmbuf outbuf = VMBUF_INITIALIZER;
+    static _RIBS_THREAD_LOCAL_ struct vmbuf outbuf = VMBUF_INITIALIZER;
     vmbuf_init(&outbuf, vmbuf_ravail(buf));
     if (0 > vmbuf_deflate4(buf, &outbuf, level))
         return -1;
@@ -105,7 +105,7 @@ int vmbuf_deflate_ptr2(const void *inbuf, size_t inbuf_size, struct vmbuf *outbu
 }
 
 int vmbuf_inflate(struct vmbuf *buf) {
-    static struct vmbuf outbuf = VMBUF_INITIALIZER;
+    static _RIBS_THREAD_LOCAL_ struct vmbuf outbuf = VMBUF_INITIALIZER;
     vmbuf_init(&outbuf, vmbuf_ravail(buf));
     if (0 > vmbuf_inflate2(buf, &outbuf))
         return -1;
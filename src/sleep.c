@@ -19,28 +19,26 @@
 */
 #include "logger.h"
 #include "epoll_worker.h"
-#include <sys/timerfd.h>
+#include "timer_wheel.h"
 
+/* sleeping is done on the event loop's timer wheel, no timerfd is
+   needed anymore. kept for compatibility, returns 0 */
 int ribs_sleep_init(void) {
-    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
-    if (0 > tfd)
-        return LOGGER_PERROR("ribs_sleep_init: timerfd_create"), -1;
-
-    if (0 > ribs_epoll_add(tfd, EPOLLIN, current_ctx))
-        return close(tfd), -1;
-    return tfd;
+    return 0;
 }
 
 int ribs_nanosleep(int tfd, const struct timespec *req, struct timespec *rem) {
-    struct itimerspec when = {{0,0},{req->tv_sec, req->tv_nsec}};
-    if (0 > timerfd_settime(tfd, 0, &when, NULL))
-        return LOGGER_PERROR("_ribified_nanosleep: timerfd_settime"), close(tfd), -1;
-    yield();
+    (void)tfd;
+    struct timer_wheel_entry entry;
+    timer_wheel_entry_init(&entry, timer_wheel_wakeup, current_ctx);
+    if (0 > timer_wheel_add(&entry, req->tv_sec * 1000ULL + (req->tv_nsec + 999999) / 1000000))
+        return -1;
+    while (timer_wheel_pending(&entry))
+        yield();
     if (NULL != rem)
         rem->tv_sec = 0, rem->tv_nsec = 0;
     return 0;
 }
-
 unsigned int ribs_sleep(int tfd, unsigned int seconds) {
     struct timespec req = {seconds, 0};
     ribs_nanosleep(tfd, &req, NULL);
@@ -20,52 +20,98 @@
 #include "timer.h"
 #include "context.h"
 #include "epoll_worker.h"
+#include "timer_wheel.h"
 #include "logger.h"
-#include <errno.h>
-#include <sys/timerfd.h>
+#include <stdlib.h>
 
 #define TIMER_STACK_SIZE 1024*1024
 
+struct ribs_timer {
+    struct timer_wheel_entry entry;
+    struct ribs_context *ctx;
+    void (*handler)(int);
+    time_t interval; /* 0 for one shot */
+    int id;
+    int fired;
+    int running;
+};
+
+static _RIBS_THREAD_LOCAL_ struct ribs_timer **timers = NULL;
+static _RIBS_THREAD_LOCAL_ int num_timers = 0;
+static _RIBS_THREAD_LOCAL_ int timers_capacity = 0;
+
 static void _ribs_timer_wrapper(void) {
-    void (**handler)(int) = (void (**)(int))current_ctx->reserved;
+    struct ribs_timer *timer = (struct ribs_timer *)current_ctx->reserved;
     for (;;yield()) {
-        uint64_t num_exp;
-        ssize_t res;
-        if (sizeof(num_exp) == (res = read(last_epollev.data.fd, &num_exp, sizeof(num_exp))))
-            (*handler)(last_epollev.data.fd);
-        if (0 > res) {
-            if (errno != EAGAIN)
-                LOGGER_PERROR("timerfd (%d)", last_epollev.data.fd);
-        } else
-            LOGGER_ERROR("size mismatch when reading from timerfd: %d", last_epollev.data.fd);
+        while (timer->fired) {
+            timer->fired = 0;
+            timer->running = 1;
+            timer->handler(timer->id);
+            timer->running = 0;
+        }
     }
 }
 
+static void _ribs_timer_expired(void *arg) {
+    struct ribs_timer *timer = (struct ribs_timer *)arg;
+    timer->fired = 1;
+    if (timer->interval)
+        timer_wheel_add(&timer->entry, timer->interval);
+    /* don't wake up a blocked handler, it will notice when done */
+    if (!timer->running)
+        epoll_worker_queue_ctx(timer->ctx);
+}
+
+static struct ribs_timer *_ribs_timer_get(int id) {
+    if (0 > id || id >= num_timers)
+        return LOGGER_ERROR("invalid timer id: %d", id), NULL;
+    return timers[id];
+}
+
 int ribs_timer(time_t msec, void (*handler)(int)) {
-    int tfd = ribs_timer_create(handler);
-    if (0 > tfd)
-        return LOGGER_PERROR("timerfd"), -1;
-    struct itimerspec timerspec = {{msec/1000,(msec % 1000)*1000000},{msec/1000,(msec % 1000)*1000000}};
-    if (0 > timerfd_settime(tfd, 0, &timerspec, NULL))
-        return LOGGER_PERROR("timerfd_settime: %d", tfd), close(tfd), -1;
-    return 0;
+    int id = ribs_timer_create(handler);
+    if (0 > id)
+        return -1;
+    timers[id]->interval = msec;
+    return timer_wheel_add(&timers[id]->entry, msec);
 }
 
 int ribs_timer_create(void (*handler)(int)) {
-    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
-    if (0 > tfd)
-        return LOGGER_PERROR("timerfd_create"), -1;
-    struct ribs_context *ctx = ribs_context_create(1024 * 1024, sizeof(void (*)(void)), _ribs_timer_wrapper);
-    void (**ref)(int) = (void (**)(int))ctx->reserved;
-    *ref = handler;
-    if (0 > ribs_epoll_add(tfd, EPOLLIN, ctx))
-        return LOGGER_PERROR("epoll_add"), close(tfd), -1;
-    return tfd;
+    if (num_timers == timers_capacity) {
+        int capacity = timers_capacity ? timers_capacity * 2 : 16;
+        struct ribs_timer **t = realloc(timers, capacity * sizeof(struct ribs_timer *));
+        if (NULL == t)
+            return LOGGER_PERROR("realloc"), -1;
+        timers = t;
+        timers_capacity = capacity;
+    }
+    struct ribs_context *ctx = ribs_context_create(TIMER_STACK_SIZE, sizeof(struct ribs_timer), _ribs_timer_wrapper);
+    if (NULL == ctx)
+        return -1;
+    struct ribs_timer *timer = (struct ribs_timer *)ctx->reserved;
+    timer_wheel_entry_init(&timer->entry, _ribs_timer_expired, timer);
+    timer->ctx = ctx;
+    timer->handler = handler;
+    timer->interval = 0;
+    timer->id = num_timers;
+    timer->fired = 0;
+    timer->running = 0;
+    timers[num_timers] = timer;
+    return num_timers++;
+}
+
+int ribs_timer_arm(int id, time_t msec) {
+    struct ribs_timer *timer = _ribs_timer_get(id);
+    if (NULL == timer)
+        return -1;
+    return timer_wheel_add(&timer->entry, msec);
 }
 
-int ribs_timer_arm(int tfd, time_t msec) {
-    struct itimerspec timerspec = {{0,0},{msec/1000,(msec % 1000)*1000000}};
-    if (0 > timerfd_settime(tfd, 0, &timerspec, NULL))
-        return LOGGER_PERROR("timerfd_settime: %d", tfd), close(tfd), -1;
+int ribs_timer_disarm(int id) {
+    struct ribs_timer *timer = _ribs_timer_get(id);
+    if (NULL == timer)
+        return -1;
+    timer->interval = 0;
+    timer_wheel_cancel(&timer->entry);
     return 0;
 }
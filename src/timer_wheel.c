@@ -0,0 +1,229 @@
+/*
+    This file is part of RIBS2.0 (Robust Infrastructure for Backend Systems).
+    RIBS is an infrastructure for building great SaaS applications (but not
+    limited to).
+
+    Copyright (C) 2015 TrueSkills, Inc.
+
+    RIBS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, version 2.1 of the License.
+
+    RIBS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with RIBS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "timer_wheel.h"
+#include "epoll_worker.h"
+#include "ribs_clock.h"
+#include "logger.h"
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define TIMER_WHEEL_STACK_SIZE (64*1024)
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_OVERFLOW (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS)
+#define TIMER_WHEEL_FIRING (TIMER_WHEEL_OVERFLOW + 1)
+#define TIMER_WHEEL_NEVER UINT64_MAX
+
+struct timer_wheel {
+    int tfd;
+    uint64_t cur; /* next tick to process */
+    uint64_t armed; /* tick the timerfd is armed for */
+    uint64_t occupied[TIMER_WHEEL_LEVELS]; /* non empty slots */
+    struct list slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    struct list overflow;
+};
+
+static _RIBS_THREAD_LOCAL_ struct timer_wheel wheel = { .tfd = -1 };
+
+uint64_t timer_wheel_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void timer_wheel_wakeup(void *ctx) {
+    epoll_worker_queue_ctx((struct ribs_context *)ctx);
+}
+
+static void place(struct timer_wheel_entry *entry) {
+    uint64_t expires = entry->expires;
+    if (expires < wheel.cur)
+        expires = wheel.cur;
+    uint64_t delta = expires - wheel.cur;
+    int level;
+    for (level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+        if (delta < (1ULL << ((level + 1) * TIMER_WHEEL_BITS))) {
+            uint32_t idx = (expires >> (level * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK;
+            entry->slot = level * TIMER_WHEEL_SLOTS + idx;
+            list_insert_tail(&wheel.slots[level][idx], &entry->list);
+            wheel.occupied[level] |= 1ULL << idx;
+            return;
+        }
+    }
+    entry->slot = TIMER_WHEEL_OVERFLOW;
+    list_insert_tail(&wheel.overflow, &entry->list);
+}
+
+/* next tick which needs processing, either expiring or cascading */
+static uint64_t next_tick(void) {
+    uint64_t next = TIMER_WHEEL_NEVER;
+    int level;
+    for (level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+        uint64_t occupied = wheel.occupied[level];
+        if (0 == occupied)
+            continue;
+        unsigned shift = level * TIMER_WHEEL_BITS;
+        /* first slot boundary at or after cur, slots are visited in order from there */
+        uint64_t boundary = (wheel.cur + (1ULL << shift) - 1) >> shift;
+        unsigned rot = boundary & TIMER_WHEEL_MASK;
+        if (rot)
+            occupied = (occupied >> rot) | (occupied << (TIMER_WHEEL_SLOTS - rot));
+        uint64_t tick = (boundary + __builtin_ctzll(occupied)) << shift;
+        if (tick < next)
+            next = tick;
+    }
+    if (!list_empty(&wheel.overflow)) {
+        unsigned shift = TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS;
+        uint64_t tick = ((wheel.cur + (1ULL << shift) - 1) >> shift) << shift;
+        if (tick < next)
+            next = tick;
+    }
+    return next;
+}
+
+static void detach(struct list *head, struct list *to) {
+    if (list_empty(head)) {
+        list_init(to);
+        return;
+    }
+    *to = *head;
+    to->next->prev = to;
+    to->prev->next = to;
+    list_init(head);
+}
+
+static void cascade(struct list *head) {
+    struct list entries;
+    detach(head, &entries);
+    while (!list_empty(&entries))
+        place(LIST_ENTRY(list_pop_head(&entries), struct timer_wheel_entry, list));
+}
+
+static void process(uint64_t tick) {
+    wheel.cur = tick;
+    /* higher levels first, they may cascade into the current slot of lower ones */
+    if (0 == (tick & ((1ULL << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS)) - 1)))
+        cascade(&wheel.overflow);
+    int level;
+    for (level = TIMER_WHEEL_LEVELS - 1; level > 0; --level) {
+        unsigned shift = level * TIMER_WHEEL_BITS;
+        if (0 != (tick & ((1ULL << shift) - 1)))
+            continue;
+        uint32_t idx = (tick >> shift) & TIMER_WHEEL_MASK;
+        wheel.occupied[level] &= ~(1ULL << idx);
+        cascade(&wheel.slots[level][idx]);
+    }
+    uint32_t idx = tick & TIMER_WHEEL_MASK;
+    struct list expired;
+    detach(&wheel.slots[0][idx], &expired);
+    wheel.occupied[0] &= ~(1ULL << idx);
+    struct list *it;
+    LIST_FOR_EACH(&expired, it) {
+        LIST_ENTRY(it, struct timer_wheel_entry, list)->slot = TIMER_WHEEL_FIRING;
+    }
+    /* callbacks may add entries, they belong to the next ticks */
+    wheel.cur = tick + 1;
+    while (!list_empty(&expired)) {
+        struct timer_wheel_entry *entry = LIST_ENTRY(list_pop_head(&expired), struct timer_wheel_entry, list);
+        list_set_null(&entry->list);
+        entry->func(entry->arg);
+    }
+}
+
+static int arm(uint64_t tick) {
+    wheel.armed = tick;
+    struct itimerspec when = { { 0, 0 }, { tick / 1000, (tick % 1000) * 1000000L } };
+    if (0 > timerfd_settime(wheel.tfd, TFD_TIMER_ABSTIME, &when, NULL))
+        return LOGGER_PERROR("timerfd_settime"), -1;
+    return 0;
+}
+
+static void timer_wheel_dispatcher(void) {
+    for (;;yield()) {
+        uint64_t num_exp;
+        if (sizeof(num_exp) != read(wheel.tfd, &num_exp, sizeof(num_exp))) {
+            if (EAGAIN != errno)
+                LOGGER_PERROR("read, timerfd");
+            continue;
+        }
+        wheel.armed = TIMER_WHEEL_NEVER;
+        /* refreshed by the harvest which delivered the timerfd */
+        uint64_t now = ribs_clock_msec();
+        uint64_t tick;
+        while ((tick = next_tick()) <= now)
+            process(tick);
+        if (wheel.cur <= now)
+            wheel.cur = now + 1;
+        if (TIMER_WHEEL_NEVER != tick && tick < wheel.armed)
+            arm(tick);
+    }
+}
+
+static int timer_wheel_init(void) {
+    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (0 > tfd)
+        return LOGGER_PERROR("timerfd_create"), -1;
+    struct ribs_context *ctx = ribs_context_create(TIMER_WHEEL_STACK_SIZE, 0, timer_wheel_dispatcher);
+    if (NULL == ctx)
+        return close(tfd), -1;
+    if (0 > ribs_epoll_add(tfd, EPOLLIN, ctx))
+        return close(tfd), -1;
+    int level, idx;
+    for (level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+        for (idx = 0; idx < TIMER_WHEEL_SLOTS; ++idx)
+            list_init(&wheel.slots[level][idx]);
+        wheel.occupied[level] = 0;
+    }
+    list_init(&wheel.overflow);
+    wheel.cur = ribs_clock_msec();
+    wheel.armed = TIMER_WHEEL_NEVER;
+    wheel.tfd = tfd;
+    return 0;
+}
+
+int timer_wheel_add(struct timer_wheel_entry *entry, uint64_t msec) {
+    if (0 > wheel.tfd && 0 > timer_wheel_init())
+        return -1;
+    timer_wheel_cancel(entry);
+    /* round up, never expire before msec from the last harvest */
+    uint64_t now = ribs_clock_msec() + 1;
+    /* nothing pending, catch up so it lands in the lowest possible level */
+    if (wheel.cur < now && TIMER_WHEEL_NEVER == next_tick())
+        wheel.cur = now;
+    entry->expires = now + msec;
+    if (entry->expires < wheel.cur)
+        entry->expires = wheel.cur;
+    place(entry);
+    if (entry->expires < wheel.armed)
+        return arm(entry->expires);
+    return 0;
+}
+
+void timer_wheel_cancel(struct timer_wheel_entry *entry) {
+    if (!timer_wheel_pending(entry))
+        return;
+    list_remove(&entry->list);
+    list_set_null(&entry->list);
+    if (entry->slot < TIMER_WHEEL_OVERFLOW) {
+        uint32_t level = entry->slot / TIMER_WHEEL_SLOTS, idx = entry->slot % TIMER_WHEEL_SLOTS;
+        if (list_empty(&wheel.slots[level][idx]))
+            wheel.occupied[level] &= ~(1ULL << idx);
+    }
+}
@@ -18,23 +18,18 @@
     along with RIBS.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "timer_worker.h"
-#include "errno.h"
 #include "epoll_worker.h"
-#include <sys/timerfd.h>
+#include "timer_wheel.h"
 
 struct timer_worker_context {
-    int tfd;
+    struct timer_wheel_entry timer;
+    struct ribs_context *worker_ctx;
+    int running;
+    int again; /* fired while user_func was blocked */
     void (*user_func)(void);
     char user_data[];
 };
 
-static int _timer_worker_schedule_next(int tfd, time_t usec) {
-    struct itimerspec timerspec = {{0,0},{usec/1000000,(usec%1000000)*1000}};
-    if (0 > timerfd_settime(tfd, 0, &timerspec, NULL))
-        return LOGGER_PERROR("timerfd: %d", tfd), -1;
-    return 0;
-}
-
 static inline struct timer_worker_context *_timer_worker_get_context(void) {
     struct timer_worker_context *twc = (struct timer_worker_context *)current_ctx->reserved;
     return twc;
@@ -42,42 +37,41 @@ static inline struct timer_worker_context *_timer_worker_get_context(void) {
 
 int timer_worker_schedule_next(time_t usec) {
     struct timer_worker_context *twc = _timer_worker_get_context();
-    return _timer_worker_schedule_next(twc->tfd, usec);
+    return timer_wheel_add(&twc->timer, (usec + 999) / 1000);
 }
 
 static void _timer_worker_wrapper(void) {
     struct timer_worker_context *twc = _timer_worker_get_context();
-    twc->user_func();
+    twc->running = 1;
+    do {
+        twc->again = 0;
+        twc->user_func();
+    } while (twc->again);
+    twc->running = 0;
 }
 
-static void _timer_worker_trigger(void) {
-    struct ribs_context **worker_ctx_ref = (struct ribs_context **)current_ctx->reserved;
-    struct ribs_context *worker_ctx = *worker_ctx_ref;
-    for (;;yield()) {
-        uint64_t num_exp;
-        if (sizeof(num_exp) != read(last_epollev.data.fd, &num_exp, sizeof(num_exp))) {
-            if (EAGAIN == errno)
-                continue;
-            abort();
-        }
-        ribs_makecontext(worker_ctx, event_loop_ctx, _timer_worker_wrapper);
-        ribs_swapcurcontext(worker_ctx);
+static void _timer_worker_trigger(void *arg) {
+    struct timer_worker_context *twc = (struct timer_worker_context *)arg;
+    if (twc->running) {
+        twc->again = 1;
+        return;
     }
+    ribs_makecontext(twc->worker_ctx, event_loop_ctx, _timer_worker_wrapper);
+    epoll_worker_queue_ctx(twc->worker_ctx);
 }
 
 void *timer_worker_init(size_t stack_size, size_t reserved_size, time_t usec_initial, void (*user_func)(void)) {
-    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
-    if (0 > tfd)
-        return LOGGER_PERROR("timerfd"), NULL;
-    if (0 > _timer_worker_schedule_next(tfd, usec_initial))
-        return close(tfd), NULL;
-    struct ribs_context *ctx = small_ctx_for_fd(tfd, sizeof(struct ribs_context *), _timer_worker_trigger);
     struct ribs_context *worker_ctx = ribs_context_create(stack_size, sizeof(struct timer_worker_context) + reserved_size, NULL);
-    struct ribs_context **ctx_ref = (struct ribs_context **)ctx->reserved;
-    *ctx_ref = worker_ctx;
+    if (NULL == worker_ctx)
+        return NULL;
     struct timer_worker_context *twc = (struct timer_worker_context *)worker_ctx->reserved;
-    twc->tfd = tfd;
+    timer_wheel_entry_init(&twc->timer, _timer_worker_trigger, twc);
+    twc->worker_ctx = worker_ctx;
+    twc->running = 0;
+    twc->again = 0;
     twc->user_func = user_func;
+    if (0 > timer_wheel_add(&twc->timer, (usec_initial + 999) / 1000))
+        return NULL;
     return twc->user_data;
 }
 
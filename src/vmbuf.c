@@ -23,6 +23,8 @@
 #include "context.h"
 #include "memalloc.h"
 #include "file_utils.h"
+#include "mempool.h"
+#include "ilog2.h"
 
 #define MEM_SYNC_ONLY 0x0001
 
@@ -124,10 +126,47 @@ static inline size_t _mem_resize_mp(void *mem, size_t old_size, size_t new_size,
     return s;
 }
 
+/* slab, power of 2 chunks from the per thread mempool. buffers which
+   outgrow VMBUF_SLAB_MAX_SIZE are promoted to their own mapping, the
+   size tells which is which */
+static inline size_t _mem_slab_size(size_t size) {
+    return size <= VMBUF_SLAB_MIN_SIZE ? VMBUF_SLAB_MIN_SIZE : next_p2_64(size);
+}
+
+static inline size_t _mem_alloc_slab(size_t size, void **mem, int fd) {
+    size = _mem_slab_size(size);
+    if (size > VMBUF_SLAB_MAX_SIZE)
+        return _mem_alloc_ab(size, mem, fd);
+    *mem = mempool_alloc_chunk(size);
+    if (NULL == *mem)
+        return 0;
+    return size;
+}
+
+static inline void _mem_free_slab(void *mem, size_t size, int fd) {
+    if (size > VMBUF_SLAB_MAX_SIZE)
+        _mem_free_ab(mem, size, fd);
+    else
+        mempool_free_chunk(mem, size);
+}
+
+static inline size_t _mem_resize_slab(void *mem, size_t old_size, size_t new_size, void **new_mem, int fd, uint16_t flags) {
+    new_size = _mem_slab_size(new_size);
+    if (old_size > VMBUF_SLAB_MAX_SIZE && new_size > VMBUF_SLAB_MAX_SIZE)
+        return _mem_resize_ab(mem, old_size, new_size, new_mem, fd, flags);
+    new_size = _mem_alloc_slab(new_size, new_mem, fd);
+    if (0 == new_size)
+        return 0;
+    memcpy(*new_mem, mem, new_size > old_size ? old_size : new_size);
+    _mem_free_slab(mem, old_size, fd);
+    return new_size;
+}
+
 struct vmbuf_mem_funcs _mem_funcs_anon_buf = { _mem_alloc_ab, _mem_free_ab, _mem_resize_ab };
 struct vmbuf_mem_funcs _mem_funcs_shared_buf = { _mem_alloc_sb, _mem_free_sb, _mem_resize_sb };
 struct vmbuf_mem_funcs _mem_funcs_shared_fixed_buf = { _mem_alloc_sfb, _mem_free_sfb, _mem_resize_sfb };
 struct vmbuf_mem_funcs _mem_funcs_mem_pool = { _mem_alloc_mp, _mem_free_mp, _mem_resize_mp };
+struct vmbuf_mem_funcs _mem_funcs_slab = { _mem_alloc_slab, _mem_free_slab, _mem_resize_slab };
 
 static int _vmbuf_init(struct vmbuf *vmbuf, size_t initial_size) {
     size_t size = vmbuf->funcs->mem_alloc(initial_size + sizeof(struct vmbuf_header), &vmbuf->mem, vmbuf->fd);
@@ -150,6 +189,15 @@ int vmbuf_init(struct vmbuf *vmbuf, size_t initial_size) {
     return _vmbuf_init(vmbuf, initial_size);
 }
 
+int vmbuf_init_slab(struct vmbuf *vmbuf, size_t initial_size) {
+    if (vmbuf->mem) {
+        vmbuf_reset(vmbuf);
+        return 0;
+    }
+    vmbuf->funcs = &_mem_funcs_slab;
+    return _vmbuf_init(vmbuf, initial_size);
+}
+
 int vmbuf_init_tmp(struct vmbuf *vmbuf, size_t initial_size) {
     vmbuf_free(vmbuf);
     vmbuf->funcs = &_mem_funcs_mem_pool;
@@ -0,0 +1,65 @@
+#include "ribs.h"
+#include "minunit.h"
+
+static struct http_client_pool client_pool;
+
+/* accepts the next connection and reads the request, polling up to 3s */
+static int accept_request(int lfd, char *buf, size_t size) {
+    int fd = -1;
+    struct timespec req = { 0, 50 * 1000000L };
+    int i;
+    for (i = 0; i < 60; ++i, ribs_nanosleep(0, &req, NULL)) {
+        if (0 > fd && 0 > (fd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)))
+            continue;
+        ssize_t res = read(fd, buf, size - 1);
+        if (0 < res)
+            return buf[res] = 0, fd;
+    }
+    if (0 <= fd)
+        close(fd);
+    return -1;
+}
+
+const char *test_http_client_pool() {
+    mu_assert(0 == epoll_worker_init(), "epoll_worker_init() failed");
+    client_pool.timeout_handler.timeout = 5000;
+    mu_assert_eqi(http_client_pool_init(&client_pool, 4, 4), 0);
+
+    /* a backlog of 0 holds a single connection, further SYNs are
+       dropped and the client's connect stays in progress */
+    int lfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t addrlen = sizeof(addr);
+    mu_assert(0 <= lfd &&
+              0 == bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) &&
+              0 == listen(lfd, 0) &&
+              0 == getsockname(lfd, (struct sockaddr *)&addr, &addrlen), "listen");
+    int filler = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    mu_assert(0 <= filler && 0 == connect(filler, (struct sockaddr *)&addr, sizeof(addr)), "connect");
+
+    struct http_client_context *cctx = http_client_pool_create_client2(&client_pool, addr.sin_addr, ntohs(addr.sin_port), "localhost", NULL);
+    mu_assert(NULL != cctx, "create client");
+    vmbuf_strcpy(&cctx->request, "GET /slow-connect HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    mu_assert_eqi(http_client_send_request(cctx), 0);
+
+    /* make room, the retransmitted SYN completes the connect and
+       EPOLLOUT starts the client to write the request */
+    int fd = accept(lfd, NULL, NULL);
+    close(filler);
+    if (0 <= fd)
+        close(fd);
+    char buf[1024];
+    fd = accept_request(lfd, buf, sizeof(buf));
+    mu_assert(0 <= fd, "request not sent once connected");
+    mu_assert(0 == strncmp(buf, "GET /slow-connect ", 18), "request line");
+    const char response[] = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\nConnection: close\r\n\r\nok";
+    mu_assert(SSTRLEN(response) == write(fd, response, SSTRLEN(response)), "write response");
+    yield(); /* the client returns here when done */
+    close(fd);
+    close(lfd);
+    mu_assert_eqi(cctx->http_status_code, 200);
+    mu_assert_eqi(cctx->content_length, 2);
+    mu_assert(0 == memcmp(cctx->content, "ok", 2), "content");
+    http_client_free(cctx);
+    return NULL;
+}
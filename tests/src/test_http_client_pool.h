@@ -0,0 +1,6 @@
+#ifndef _TEST_HTTP_CLIENT_POOL__H_
+#define _TEST_HTTP_CLIENT_POOL__H_
+
+const char *test_http_client_pool();
+
+#endif /* _TEST_HTTP_CLIENT_POOL__H_ */
@@ -0,0 +1,113 @@
+#include "ribs.h"
+#include "minunit.h"
+
+static const char REQUEST[] =
+    "\r\n" /* ignored */
+    "POST /submit?a=1 HTTP/1.1\r\n"
+    "Host: example.com\r\n"
+    "User-Agent: a rather long user agent string, longer than a vector\r\n"
+    "Connection: keep-alive, Upgrade\r\n"
+    "Expect: 100-continue\r\n"
+    "Content-Length:\t 5 \r\n"
+    "X-Tab: a\tb\r\n"
+    "\r\n"
+    "hello";
+
+static int span_eq(const char *buf, struct http_parser_span span, const char *s) {
+    return span.len == strlen(s) && 0 == memcmp(buf + span.ofs, s, span.len);
+}
+
+static int parse_str(const char *s) {
+    struct http_parser parser;
+    http_parser_init(&parser);
+    return http_parser_parse(&parser, s, strlen(s));
+}
+
+const char *test_http_parser() {
+    struct http_parser parser;
+    size_t header_len = sizeof(REQUEST) - 1 - 5;
+    size_t i;
+    /* byte by byte must give the same result as all at once */
+    for (i = 0; i < 2; ++i) {
+        http_parser_init(&parser);
+        int res = HTTP_PARSER_AGAIN;
+        size_t len = i ? 0 : header_len - 1;
+        while (HTTP_PARSER_AGAIN == res && len < sizeof(REQUEST) - 1)
+            res = http_parser_parse(&parser, REQUEST, ++len);
+        mu_assert_eqi(res, HTTP_PARSER_DONE);
+        mu_assert_eqi(len, header_len);
+        mu_assert_eqi(parser.header_len, header_len);
+        mu_assert_eqi(parser.method, HTTP_METHOD_POST);
+        mu_assert(span_eq(REQUEST, parser.method_name, "POST"), "method");
+        mu_assert(span_eq(REQUEST, parser.uri, "/submit?a=1"), "uri");
+        mu_assert_eqi(parser.version_minor, 1);
+        mu_assert_eqi(parser.num_headers, 6);
+        mu_assert(span_eq(REQUEST, parser.headers[1].name, "User-Agent"), "header name");
+        mu_assert(span_eq(REQUEST, parser.headers[4].value, "5"), "value whitespace");
+        mu_assert(span_eq(REQUEST, parser.headers[5].value, "a\tb"), "tab in value");
+        mu_assert_eqi(parser.content_length, 5);
+        mu_assert_eqi(parser.flags, HTTP_PARSER_CONTENT_LENGTH | HTTP_PARSER_KEEP_ALIVE | HTTP_PARSER_EXPECT_CONTINUE);
+        mu_assert(http_parser_keep_alive(&parser), "keep alive");
+        const struct http_parser_span *host = http_parser_find_header(&parser, REQUEST, "HOST");
+        mu_assert(host && span_eq(REQUEST, *host, "example.com"), "find header");
+    }
+
+    http_parser_init(&parser);
+    static const char HTTP10[] = "GET /\nTransfer-Encoding: gzip, chunked\nConnection: close\n\n";
+    mu_assert_eqi(http_parser_parse(&parser, HTTP10, SSTRLEN(HTTP10)), HTTP_PARSER_DONE);
+    mu_assert_eqi(parser.version_minor, 0);
+    mu_assert_eqi(parser.num_headers, 2);
+    mu_assert_eqi(parser.headers_end, SSTRLEN(HTTP10) - 2);
+    mu_assert_eqi(parser.flags, HTTP_PARSER_TRANSFER_ENCODING | HTTP_PARSER_CHUNKED | HTTP_PARSER_CONNECTION_CLOSE);
+    mu_assert(!http_parser_keep_alive(&parser), "connection close");
+
+    mu_assert_eqi(parse_str("GET / HTTP/1.0\r\n\r\n"), HTTP_PARSER_DONE);
+    mu_assert_eqi(parse_str("GET / HTTP/1.1\r\nHost: x\r\n"), HTTP_PARSER_AGAIN);
+    mu_assert_eqi(parse_str("GET / HTTP/2.0\r\n\r\n"), HTTP_PARSER_ERROR);
+    mu_assert_eqi(parse_str("GET  HTTP/1.1\r\n\r\n"), HTTP_PARSER_ERROR);
+    mu_assert_eqi(parse_str("GET / HTTP/1.1\r\nHost : x\r\n\r\n"), HTTP_PARSER_ERROR);
+    mu_assert_eqi(parse_str("GET / HTTP/1.1\r\nA: b\r\n folded\r\n\r\n"), HTTP_PARSER_ERROR);
+    mu_assert_eqi(parse_str("GET / HTTP/1.1\r\nA: b\rc\r\n\r\n"), HTTP_PARSER_ERROR);
+    mu_assert_eqi(parse_str("GET / HTTP/1.1\r\nContent-Length: 1x\r\n\r\n"), HTTP_PARSER_ERROR);
+    mu_assert_eqi(parse_str("GET / HTTP/1.1\r\nContent-Length: 1\r\nContent-Length: 2\r\n\r\n"), HTTP_PARSER_ERROR);
+    mu_assert_eqi(parse_str("GET / HTTP/1.1\r\nContent-Length: 1\r\nTransfer-Encoding: chunked\r\n\r\n"), HTTP_PARSER_ERROR);
+    /* chunked body, decoded in place one byte at a time, then the next request */
+    static const char CHUNKED[] =
+        "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+        "5;ext=1\r\nhello\r\n"
+        "1B\r\n, world and some more bytes\r\n"
+        "0\r\nTrailer: x\r\n\r\n"
+        "GET";
+    char buf[sizeof(CHUNKED)];
+    memcpy(buf, CHUNKED, sizeof(CHUNKED));
+    http_parser_init(&parser);
+    mu_assert_eqi(http_parser_parse(&parser, buf, SSTRLEN(CHUNKED)), HTTP_PARSER_DONE);
+    struct http_body_decoder body;
+    http_body_decoder_init(&body, &parser);
+    int res = HTTP_PARSER_AGAIN;
+    size_t len;
+    for (len = parser.header_len; HTTP_PARSER_AGAIN == res && len <= SSTRLEN(CHUNKED); ++len)
+        res = http_body_decode(&body, buf, len);
+    mu_assert_eqi(res, HTTP_PARSER_DONE);
+    mu_assert(http_body_decoder_done(&body), "not done");
+    static const char DECODED[] = "hello, world and some more bytes";
+    mu_assert_eqi(body.wpos - parser.header_len, SSTRLEN(DECODED));
+    mu_assert(0 == memcmp(buf + parser.header_len, DECODED, SSTRLEN(DECODED)), "decoded body");
+    mu_assert_eqi(body.rpos, SSTRLEN(CHUNKED) - 3);
+
+    static const char *BAD_CHUNKS[] = { "x\r\n", "2\r\nabc\r\n", "fffffffffffffffff\r\n", NULL };
+    const char **bad;
+    for (bad = BAD_CHUNKS; *bad; ++bad) {
+        char tmp[64];
+        size_t l = strlen(*bad);
+        memcpy(tmp, *bad, l);
+        struct http_parser p2 = { .header_len = 0, .flags = HTTP_PARSER_CHUNKED };
+        http_body_decoder_init(&body, &p2);
+        mu_assert_eqi(http_body_decode(&body, tmp, l), HTTP_PARSER_ERROR);
+    }
+
+    static const char NUL[] = "GET / HTTP/1.1\r\nA: b\0c\r\n\r\n";
+    http_parser_init(&parser);
+    mu_assert_eqi(http_parser_parse(&parser, NUL, SSTRLEN(NUL)), HTTP_PARSER_ERROR);
+    return NULL;
+}
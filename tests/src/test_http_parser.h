@@ -0,0 +1,6 @@
+#ifndef _TEST_HTTP_PARSER__H_
+#define _TEST_HTTP_PARSER__H_
+
+const char *test_http_parser();
+
+#endif /* _TEST_HTTP_PARSER__H_ */
@@ -0,0 +1,171 @@
+#include "ribs.h"
+#include "minunit.h"
+
+/* a server in this event loop, requested by the test's ribbon */
+static struct http_server server = HTTP_SERVER_INITIALIZER;
+static int num_calls;
+static int slow_no_store;
+static char resp[8192];
+
+static void handler(void) {
+    struct http_server_context *ctx = http_server_get_context();
+    const char *uri = ctx->uri;
+    const char *cache_control = "\r\nCache-Control: max-age=60";
+    ++num_calls;
+    if (0 == strcmp(uri, "/ttl"))
+        cache_control = ""; /* the default TTL */
+    else if (0 == strcmp(uri, "/no-store"))
+        cache_control = "\r\nCache-Control: no-store";
+    else if (0 == strcmp(uri, "/private"))
+        cache_control = "\r\nCache-Control: max-age=60, private";
+    else if (0 == strcmp(uri, "/slow")) {
+        struct timespec req = { 0, 50 * 1000000L };
+        ribs_nanosleep(0, &req, NULL);
+        if (slow_no_store)
+            cache_control = "\r\nCache-Control: no-store";
+    }
+    http_server_header_start(HTTP_STATUS_200, HTTP_CONTENT_TYPE_TEXT_PLAIN);
+    vmbuf_strcpy(&ctx->header, cache_control);
+    if (0 == strcmp(uri, "/cookie"))
+        vmbuf_strcpy(&ctx->header, "\r\nSet-Cookie: a=b");
+    if (0 == strcmp(uri, "/vary")) {
+        vmbuf_strcpy(&ctx->header, "\r\nVary: X-Lang");
+        const struct http_parser_span *lang = http_parser_find_header(&ctx->parser, vmbuf_data(&ctx->request), "x-lang");
+        if (lang)
+            vmbuf_memcpy(&ctx->payload, vmbuf_data(&ctx->request) + lang->ofs, lang->len);
+    }
+    vmbuf_sprintf(&ctx->payload, "[%d]", num_calls);
+    if (0 == strncmp(uri, "/big/", 5))
+        memset(vmbuf_data_ofs(&ctx->payload, vmbuf_alloc(&ctx->payload, 1000)), 'x', 1000);
+    http_server_header_content_length();
+    http_server_header_close();
+}
+
+/* returns 1 for a cache hit, 0 for a miss, -1 on error */
+static int request(const char *uri, const char *extra) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (0 > fd)
+        return -1;
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(server.port), .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    if ((0 > connect(fd, (struct sockaddr *)&addr, sizeof(addr)) && EINPROGRESS != errno) ||
+        0 > ribs_epoll_add(fd, EPOLLIN | EPOLLOUT | EPOLLET, current_ctx))
+        return ribs_close(fd), -1;
+    char req[512];
+    int n = snprintf(req, sizeof(req), "GET %s HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n%s\r\n", uri, extra);
+    int ofs = 0;
+    size_t len = 0;
+    int calls = num_calls;
+    while (ofs < n) {
+        ssize_t res = write(fd, req + ofs, n - ofs);
+        if (0 < res)
+            ofs += res;
+        else if (EAGAIN == errno)
+            yield();
+        else
+            return ribs_close(fd), -1;
+    }
+    for (;;) {
+        ssize_t res = read(fd, resp + len, sizeof(resp) - 1 - len);
+        if (0 < res)
+            len += res;
+        else if (0 == res)
+            break;
+        else if (EAGAIN == errno)
+            yield();
+        else
+            return ribs_close(fd), -1;
+    }
+    ribs_close(fd);
+    resp[len] = 0;
+    if (0 != strncmp(resp, "HTTP/1.1 200", 12))
+        return -1;
+    int hit = NULL != strstr(resp, "\r\nAge: ");
+    /* a hit must not run the handler */
+    return hit == (calls == num_calls) ? hit : -1;
+}
+
+static int request_task(void *uri) {
+    return request(uri, "");
+}
+
+const char *test_http_response_cache() {
+    mu_assert(0 == epoll_worker_init(), "epoll_worker_init() failed");
+    server.port = 0;
+    server.bind_addr = htonl(INADDR_LOOPBACK);
+    server.user_func = handler;
+    server.num_stacks = 4;
+    server.response_cache_size = 64 * 1024;
+    server.response_cache_ttl = 100;
+    mu_assert_eqi(http_server_init2(&server), 0);
+    mu_assert_eqi(http_server_init_acceptor(&server), 0);
+    struct http_response_cache *cache = server.response_cache;
+    mu_assert(NULL != cache, "no cache");
+
+    /* stored, then hit */
+    mu_assert_eqi(request("/a", ""), 0);
+    mu_assert_eqi(request("/a", ""), 1);
+    mu_assert(NULL != strstr(resp, "Connection: close") && NULL != strstr(resp, "[1]"), "cached response");
+    mu_assert_eqi(request("/a?q=1", ""), 0);
+    mu_assert_eqi(cache->stats.hits, 1);
+    mu_assert_eqi(cache->stats.stores, 2);
+
+    /* a key per value of the Vary header */
+    mu_assert_eqi(request("/vary", "X-Lang: en\r\n"), 0);
+    mu_assert_eqi(request("/vary", "X-Lang: fr\r\n"), 0);
+    mu_assert_eqi(request("/vary", "X-Lang: en\r\n"), 1);
+    mu_assert(NULL != strstr(resp, "\r\n\r\nen["), "en response");
+    mu_assert_eqi(request("/vary", "X-Lang: fr\r\n"), 1);
+    mu_assert(NULL != strstr(resp, "\r\n\r\nfr["), "fr response");
+    mu_assert_eqi(request("/vary", ""), 0);
+
+    /* not stored */
+    mu_assert_eqi(request("/no-store", ""), 0);
+    mu_assert_eqi(request("/no-store", ""), 0);
+    mu_assert_eqi(request("/private", ""), 0);
+    mu_assert_eqi(request("/private", ""), 0);
+    mu_assert_eqi(request("/cookie", ""), 0);
+    mu_assert_eqi(request("/cookie", ""), 0);
+
+    /* not stored last time, concurrent requests don't wait for each other */
+    slow_no_store = 1;
+    mu_assert_eqi(request("/slow", ""), 0);
+    uint64_t coalesced = cache->stats.coalesced;
+    int calls = num_calls;
+    struct ribs_group group;
+    struct ribs_task tasks[2];
+    mu_assert_eqi(ribs_group_init(&group, NULL), 0);
+    mu_assert_eqi(ribs_task_spawn(&group, tasks + 0, request_task, "/slow"), 0);
+    mu_assert_eqi(ribs_task_spawn(&group, tasks + 1, request_task, "/slow"), 0);
+    mu_assert_eqi(ribs_group_wait(&group, 1000), 0);
+    mu_assert_eqi(tasks[0].result, 0);
+    mu_assert_eqi(tasks[1].result, 0);
+    mu_assert_eqi(cache->stats.coalesced - coalesced, 0);
+    mu_assert_eqi(num_calls - calls, 2);
+    /* stored again once cacheable */
+    slow_no_store = 0;
+    mu_assert_eqi(request("/slow", ""), 0);
+    mu_assert_eqi(request("/slow", ""), 1);
+
+    /* expiry, default TTL */
+    mu_assert_eqi(request("/ttl", ""), 0);
+    mu_assert_eqi(request("/ttl", ""), 1);
+    struct timespec req = { 0, 150 * 1000000L };
+    mu_assert(0 == ribs_nanosleep(0, &req, NULL), "ribs_nanosleep() failed");
+    mu_assert_eqi(request("/ttl", ""), 0);
+
+    /* LRU eviction, room for three big entries */
+    http_response_cache_purge(cache);
+    mu_assert_eqi(request("/big/1", ""), 0);
+    cache->max_bytes = cache->bytes * 3 + cache->bytes / 2;
+    mu_assert_eqi(request("/big/2", ""), 0);
+    mu_assert_eqi(request("/big/3", ""), 0);
+    mu_assert_eqi(request("/big/1", ""), 1); /* most recently used */
+    uint64_t evictions = cache->stats.evictions;
+    mu_assert_eqi(request("/big/4", ""), 0);
+    mu_assert_eqi(cache->stats.evictions - evictions, 1);
+    mu_assert(cache->bytes <= cache->max_bytes, "over max_bytes");
+    mu_assert_eqi(request("/big/1", ""), 1);
+    mu_assert_eqi(request("/big/3", ""), 1);
+    mu_assert_eqi(request("/big/2", ""), 0); /* evicted */
+    return NULL;
+}
@@ -0,0 +1,6 @@
+#ifndef _TEST_HTTP_RESPONSE_CACHE__H_
+#define _TEST_HTTP_RESPONSE_CACHE__H_
+
+const char *test_http_response_cache();
+
+#endif /* _TEST_HTTP_RESPONSE_CACHE__H_ */
@@ -0,0 +1,66 @@
+#include "ribs.h"
+#include "minunit.h"
+
+static void h_root(void) {}
+static void h_users(void) {}
+static void h_user(void) {}
+static void h_user_post(void) {}
+static void h_user_me(void) {}
+static void h_user_file(void) {}
+static void h_static(void) {}
+static void h_any(void) {}
+
+static int match(struct http_router *router, int method, const char *path, struct http_router_match *m) {
+    return http_router_match(router, method, path, strlen(path), m);
+}
+
+static int param_eq(const struct http_router_match *m, const char *name, const char *value) {
+    const struct http_router_param *p = http_router_get_param(m, name);
+    return p && p->value_len == strlen(value) && 0 == memcmp(p->value, value, p->value_len);
+}
+
+const char *test_http_router() {
+    struct http_router router;
+    struct http_router_match m;
+    mu_assert_eqi(http_router_init(&router), 0);
+    mu_assert_eqi(http_router_add(&router, HTTP_METHOD_GET, "/", h_root), 0);
+    mu_assert_eqi(http_router_add(&router, HTTP_METHOD_GET, "/users", h_users), 0);
+    mu_assert_eqi(http_router_add(&router, HTTP_METHOD_GET, "/users/:id", h_user), 0);
+    mu_assert_eqi(http_router_add(&router, HTTP_METHOD_POST, "/users/:id", h_user_post), 0);
+    mu_assert_eqi(http_router_add(&router, HTTP_METHOD_GET, "/users/me", h_user_me), 0);
+    mu_assert_eqi(http_router_add(&router, HTTP_METHOD_GET, "/users/:id/files/*path", h_user_file), 0);
+    mu_assert_eqi(http_router_add(&router, HTTP_METHOD_GET, "/user", h_static), 0); /* splits "/users" */
+    mu_assert_eqi(http_router_add(&router, HTTP_ROUTER_ANY_METHOD, "/any", h_any), 0);
+    /* errors */
+    mu_assert(0 > http_router_add(&router, HTTP_METHOD_GET, "/users/:name/x", h_user), "conflicting param");
+    mu_assert(0 > http_router_add(&router, HTTP_METHOD_GET, "/users", h_user), "duplicate");
+    mu_assert(0 > http_router_add(&router, HTTP_METHOD_GET, "/a/*rest/b", h_user), "wildcard not last");
+    mu_assert(0 > http_router_add(&router, HTTP_METHOD_GET, "/a/:", h_user), "empty name");
+    mu_assert_eqi(http_router_add(&router, HTTP_METHOD_GET, "/p/:a/:b/:c/:d/:e/:f/:g/*h", h_user), 0);
+    mu_assert(0 > http_router_add(&router, HTTP_METHOD_GET, "/p/:a/:b/:c/:d/:e/:f/:g/:h/:i", h_user), "too many params");
+
+    mu_assert(HTTP_ROUTER_MATCH == match(&router, HTTP_METHOD_GET, "/", &m) && m.handler == h_root, "root");
+    mu_assert(HTTP_ROUTER_MATCH == match(&router, HTTP_METHOD_GET, "/users", &m) && m.handler == h_users, "static");
+    mu_assert(HTTP_ROUTER_MATCH == match(&router, HTTP_METHOD_GET, "/user", &m) && m.handler == h_static, "split");
+    mu_assert(HTTP_ROUTER_MATCH == match(&router, HTTP_METHOD_GET, "/users/me", &m) && m.handler == h_user_me, "static first");
+    mu_assert_eqi(m.num_params, 0);
+    mu_assert(HTTP_ROUTER_MATCH == match(&router, HTTP_METHOD_GET, "/users/mex", &m) && m.handler == h_user, "backtrack to param");
+    mu_assert(param_eq(&m, "id", "mex"), "param value");
+    mu_assert(HTTP_ROUTER_MATCH == match(&router, HTTP_METHOD_POST, "/users/42", &m) && m.handler == h_user_post, "method");
+    mu_assert(HTTP_ROUTER_MATCH == match(&router, HTTP_METHOD_HEAD, "/users/42", &m) && m.handler == h_user, "HEAD uses GET");
+    mu_assert(HTTP_ROUTER_MATCH == match(&router, HTTP_METHOD_GET, "/users/me/files/a/b.txt", &m) && m.handler == h_user_file, "wildcard");
+    mu_assert_eqi(m.num_params, 2);
+    mu_assert(param_eq(&m, "id", "me") && param_eq(&m, "path", "a/b.txt"), "wildcard params");
+    mu_assert(HTTP_ROUTER_MATCH == match(&router, HTTP_METHOD_GET, "/users/7/files/", &m) && param_eq(&m, "path", ""), "empty tail");
+    mu_assert(HTTP_ROUTER_MATCH == match(&router, HTTP_METHOD_DELETE, "/any", &m) && m.handler == h_any, "any method");
+    mu_assert_eqi(match(&router, HTTP_METHOD_DELETE, "/users/42", &m), HTTP_ROUTER_METHOD_NOT_ALLOWED);
+    mu_assert_eqi(match(&router, HTTP_METHOD_GET, "/users/", &m), HTTP_ROUTER_NOT_FOUND);
+    mu_assert_eqi(match(&router, HTTP_METHOD_GET, "/users/42/x", &m), HTTP_ROUTER_NOT_FOUND);
+    mu_assert(HTTP_ROUTER_MATCH == match(&router, HTTP_METHOD_GET, "/p/1/2/3/4/5/6/7/8/9", &m), "max params");
+    mu_assert_eqi(m.num_params, HTTP_ROUTER_MAX_PARAMS);
+    mu_assert(param_eq(&m, "g", "7") && param_eq(&m, "h", "8/9"), "max params values");
+    mu_assert_eqi(match(&router, HTTP_METHOD_GET, "/nope", &m), HTTP_ROUTER_NOT_FOUND);
+    mu_assert_eqi(m.num_params, 0);
+    http_router_free(&router);
+    return 0;
+}
@@ -0,0 +1,6 @@
+#ifndef _TEST_HTTP_ROUTER__H_
+#define _TEST_HTTP_ROUTER__H_
+
+const char *test_http_router();
+
+#endif /* _TEST_HTTP_ROUTER__H_ */
@@ -2,11 +2,25 @@
 #include "test_kmeans.h"
 #include "test_ds_var_field.h"
 #include "test_zlib.h"
+#include "test_timer_wheel.h"
+#include "test_http_parser.h"
+#include "test_http_router.h"
+#include "test_ribs_task.h"
+#include "test_ribs_sync.h"
+#include "test_http_response_cache.h"
+#include "test_http_client_pool.h"
 
 static const char *all_tests() {
     mu_run_test(test_kmeans);
     mu_run_test(test_ds_var_field);
     mu_run_test(test_zlib_vmbuf);
+    mu_run_test(test_timer_wheel);
+    mu_run_test(test_ribs_task);
+    mu_run_test(test_ribs_sync);
+    mu_run_test(test_http_parser);
+    mu_run_test(test_http_router);
+    mu_run_test(test_http_response_cache);
+    mu_run_test(test_http_client_pool);
     return 0;
 }
 
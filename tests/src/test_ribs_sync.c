@@ -0,0 +1,131 @@
+#include "ribs.h"
+#include "minunit.h"
+
+static struct ribs_sem sem;
+static struct ribs_mutex mutex;
+static struct ribs_cond cond;
+static int ready;
+static int order[4];
+static int num_order;
+
+static int sem_waiter(void *arg) {
+    if (0 > ribs_sem_wait(&sem, 1000))
+        return -1;
+    order[num_order++] = (int)(intptr_t)arg;
+    return 0;
+}
+
+static int mutex_locker(void *arg) {
+    if (0 > ribs_mutex_lock(&mutex, 1000))
+        return -1;
+    order[num_order++] = (int)(intptr_t)arg;
+    /* still owned while others run */
+    courtesy_yield();
+    return ribs_mutex_unlock(&mutex);
+}
+
+static int mutex_timed_locker(void *arg) {
+    (void)arg;
+    if (0 == ribs_mutex_lock(&mutex, 20))
+        return 0;
+    return -errno;
+}
+
+static int cond_waiter(void *arg) {
+    if (0 > ribs_mutex_lock(&mutex, 1000))
+        return -1;
+    while (!ready) {
+        if (0 > ribs_cond_wait(&cond, &mutex, 1000)) {
+            ribs_mutex_unlock(&mutex);
+            return -1;
+        }
+    }
+    order[num_order++] = (int)(intptr_t)arg;
+    return ribs_mutex_unlock(&mutex);
+}
+
+/* run the spawned tasks until they are all blocked */
+static int let_them_block(struct ribs_group *group) {
+    return 0 > ribs_group_wait(group, 10) && ETIMEDOUT == errno;
+}
+
+const char *test_ribs_sync() {
+    mu_assert(0 == epoll_worker_init(), "epoll_worker_init() failed");
+    struct ribs_group group;
+    struct ribs_task tasks[3];
+    int i;
+
+    /* semaphore: FIFO wake up, units handed over to the waiters */
+    ribs_sem_init(&sem, 1);
+    mu_assert_eqi(ribs_sem_trywait(&sem), 0);
+    mu_assert(0 > ribs_sem_trywait(&sem) && EAGAIN == errno, "sem_trywait() should fail");
+    mu_assert(0 > ribs_sem_wait(&sem, 20) && ETIMEDOUT == errno, "sem_wait() should time out");
+    mu_assert_eqi(ribs_group_init(&group, NULL), 0);
+    num_order = 0;
+    for (i = 0; i < 3; ++i)
+        mu_assert_eqi(ribs_task_spawn(&group, tasks + i, sem_waiter, (void *)(intptr_t)i), 0);
+    mu_assert(let_them_block(&group), "sem waiters should block");
+    for (i = 0; i < 3; ++i)
+        ribs_sem_post(&sem);
+    mu_assert_eqi(sem.count, 0);
+    mu_assert_eqi(ribs_group_wait(&group, 1000), 0);
+    mu_assert_eqi(num_order, 3);
+    for (i = 0; i < 3; ++i)
+        mu_assert_eqi(order[i], i);
+    ribs_sem_post(&sem);
+    mu_assert_eqi(sem.count, 1);
+
+    /* mutex: ownership goes to the first waiter */
+    ribs_mutex_init(&mutex);
+    mu_assert_eqi(ribs_mutex_lock(&mutex, -1), 0);
+    mu_assert(0 > ribs_mutex_lock(&mutex, -1) && EDEADLK == errno, "relock should fail");
+    mu_assert(0 > ribs_mutex_trylock(&mutex) && EBUSY == errno, "trylock should fail");
+    mu_assert_eqi(ribs_group_init(&group, NULL), 0);
+    num_order = 0;
+    for (i = 0; i < 3; ++i)
+        mu_assert_eqi(ribs_task_spawn(&group, tasks + i, mutex_locker, (void *)(intptr_t)i), 0);
+    mu_assert(let_them_block(&group), "lockers should block");
+    mu_assert_eqi(ribs_mutex_unlock(&mutex), 0);
+    mu_assert(mutex.owner == tasks[0].ctx, "ownership handed over");
+    mu_assert(0 > ribs_mutex_unlock(&mutex) && EPERM == errno, "unlock by non owner");
+    mu_assert_eqi(ribs_group_wait(&group, 1000), 0);
+    mu_assert_eqi(num_order, 3);
+    for (i = 0; i < 3; ++i)
+        mu_assert_eqi(order[i], i);
+    mu_assert(NULL == mutex.owner, "mutex should be free");
+
+    /* mutex timeout */
+    mu_assert_eqi(ribs_mutex_lock(&mutex, -1), 0);
+    mu_assert_eqi(ribs_group_init(&group, NULL), 0);
+    mu_assert_eqi(ribs_task_spawn(&group, tasks + 0, mutex_timed_locker, NULL), 0);
+    mu_assert_eqi(ribs_group_wait(&group, 1000), 0);
+    mu_assert_eqi(tasks[0].result, -ETIMEDOUT);
+    mu_assert_eqi(group.error, -ETIMEDOUT);
+    mu_assert(list_empty(&mutex.waiters), "timed out waiter should be removed");
+    mu_assert_eqi(ribs_mutex_unlock(&mutex), 0);
+
+    /* cond: signal wakes the first waiter, broadcast the rest */
+    ribs_cond_init(&cond);
+    ready = 0;
+    mu_assert_eqi(ribs_group_init(&group, NULL), 0);
+    num_order = 0;
+    for (i = 0; i < 3; ++i)
+        mu_assert_eqi(ribs_task_spawn(&group, tasks + i, cond_waiter, (void *)(intptr_t)i), 0);
+    mu_assert(let_them_block(&group), "cond waiters should block");
+    mu_assert_eqi(ribs_mutex_lock(&mutex, -1), 0);
+    ready = 1;
+    ribs_cond_signal(&cond);
+    ribs_cond_broadcast(&cond);
+    mu_assert_eqi(ribs_mutex_unlock(&mutex), 0);
+    mu_assert_eqi(ribs_group_wait(&group, 1000), 0);
+    mu_assert_eqi(num_order, 3);
+    for (i = 0; i < 3; ++i)
+        mu_assert_eqi(order[i], i);
+
+    /* cond timeout, the mutex is locked again */
+    mu_assert_eqi(ribs_mutex_lock(&mutex, -1), 0);
+    mu_assert(0 > ribs_cond_wait(&cond, &mutex, 20) && ETIMEDOUT == errno, "cond_wait() should time out");
+    mu_assert(mutex.owner == current_ctx, "mutex should be locked after timeout");
+    mu_assert_eqi(ribs_mutex_unlock(&mutex), 0);
+    return NULL;
+}
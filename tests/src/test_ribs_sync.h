@@ -0,0 +1,6 @@
+#ifndef _TEST_RIBS_SYNC__H_
+#define _TEST_RIBS_SYNC__H_
+
+const char *test_ribs_sync();
+
+#endif /* _TEST_RIBS_SYNC__H_ */
@@ -0,0 +1,119 @@
+#include "ribs.h"
+#include "minunit.h"
+
+static int square(void *arg) {
+    int n = (int)(intptr_t)arg;
+    courtesy_yield();
+    return n * n;
+}
+
+static int producer(void *arg) {
+    struct ribs_chan *chan = arg;
+    intptr_t i;
+    for (i = 1; i <= 10; ++i)
+        if (0 > ribs_chan_send(chan, (void *)i))
+            return -1;
+    ribs_chan_close(chan);
+    return 0;
+}
+
+static int consumer(void *arg) {
+    struct ribs_chan *chan = arg;
+    void *item;
+    int sum = 0;
+    while (0 == ribs_chan_recv(chan, &item))
+        sum += (int)(intptr_t)item;
+    return EPIPE == errno ? sum : -1;
+}
+
+static int blocked_recv(void *arg) {
+    void *item;
+    if (0 == ribs_chan_recv(arg, &item))
+        return 0;
+    return ECANCELED == errno ? -ECANCELED : -1;
+}
+
+static int pipe_read(void *arg) {
+    int fd = *(int *)arg;
+    char c;
+    if (0 > ribs_epoll_add(fd, EPOLLIN | EPOLLET, current_ctx))
+        return -1;
+    while (0 > read(fd, &c, 1)) {
+        if (EAGAIN != errno)
+            return -1;
+        yield();
+    }
+    return c;
+}
+
+static int pipe_write_and_cancel(void *arg) {
+    int fd = *(int *)arg;
+    if (1 != write(fd, "x", 1))
+        return -1;
+    ribs_group_cancel(ribs_task_self()->group);
+    return 0;
+}
+
+const char *test_ribs_task() {
+    mu_assert(0 == epoll_worker_init(), "epoll_worker_init() failed");
+    struct ribs_group group;
+    struct ribs_task tasks[4];
+    int i;
+
+    /* spawn and join */
+    mu_assert_eqi(ribs_group_init(&group, NULL), 0);
+    for (i = 0; i < 4; ++i)
+        mu_assert_eqi(ribs_task_spawn(&group, tasks + i, square, (void *)(intptr_t)i), 0);
+    for (i = 3; i >= 0; --i)
+        mu_assert_eqi(ribs_task_join(tasks + i), i * i);
+    mu_assert_eqi(ribs_group_wait(&group, -1), 0);
+    mu_assert_eqi(group.num_running, 0);
+
+    /* channel smaller than the stream, closed by the producer */
+    struct ribs_chan chan;
+    mu_assert_eqi(ribs_chan_init(&chan, 3), 0);
+    mu_assert_eqi(ribs_group_init(&group, NULL), 0);
+    mu_assert_eqi(ribs_task_spawn(&group, tasks + 0, consumer, &chan), 0);
+    mu_assert_eqi(ribs_task_spawn(&group, tasks + 1, producer, &chan), 0);
+    mu_assert_eqi(ribs_group_wait(&group, 1000), 0);
+    mu_assert_eqi(tasks[0].result, 55);
+    mu_assert_eqi(tasks[1].result, 0);
+    mu_assert(0 > ribs_chan_try_send(&chan, NULL) && EPIPE == errno, "send on closed channel");
+    ribs_chan_free(&chan);
+
+    /* cancel wakes up a blocked receiver */
+    mu_assert_eqi(ribs_chan_init(&chan, 1), 0);
+    mu_assert_eqi(ribs_group_init(&group, NULL), 0);
+    mu_assert_eqi(ribs_task_spawn(&group, tasks + 0, blocked_recv, &chan), 0);
+    mu_assert(0 > ribs_group_wait(&group, 20) && ETIMEDOUT == errno, "group_wait() should time out");
+    ribs_group_cancel(&group);
+    mu_assert_eqi(ribs_group_wait(&group, 1000), 0);
+    mu_assert_eqi(tasks[0].result, -ECANCELED);
+    mu_assert_eqi(group.error, -ECANCELED);
+    ribs_chan_free(&chan);
+
+    /* a cancelled task which finishes through its fd wakeup before the
+       run queue gets to it must not be resumed again */
+    int pfd[2];
+    mu_assert(0 == pipe2(pfd, O_NONBLOCK), "pipe2() failed");
+    mu_assert_eqi(epoll_worker_set_run_queue_budget(1), 0);
+    struct epoll_worker_stats stats;
+    epoll_worker_get_stats(&stats);
+    uint64_t num_runnable = stats.num_runnable;
+    mu_assert_eqi(ribs_group_init(&group, NULL), 0);
+    mu_assert_eqi(ribs_task_spawn(&group, tasks + 0, pipe_read, pfd + 0), 0);
+    mu_assert_eqi(ribs_task_spawn(&group, tasks + 1, pipe_write_and_cancel, pfd + 1), 0);
+    mu_assert_eqi(ribs_group_wait(&group, 1000), 0);
+    epoll_worker_set_run_queue_budget(EPOLL_WORKER_DEFAULT_RUN_QUEUE_BUDGET);
+    mu_assert_eqi(tasks[0].result, 'x');
+    /* reader, writer and us, the reader is not run a second time */
+    epoll_worker_get_stats(&stats);
+    mu_assert_eqi(stats.num_runnable - num_runnable, 3);
+    mu_assert_eqi(tasks[1].result, 0);
+    /* the freed ribbon is reused by the next task */
+    mu_assert_eqi(ribs_task_spawn(&group, tasks + 2, square, (void *)(intptr_t)5), 0);
+    mu_assert_eqi(ribs_task_join(tasks + 2), 25);
+    close(pfd[0]);
+    close(pfd[1]);
+    return NULL;
+}
@@ -0,0 +1,6 @@
+#ifndef _TEST_RIBS_TASK__H_
+#define _TEST_RIBS_TASK__H_
+
+const char *test_ribs_task();
+
+#endif /* _TEST_RIBS_TASK__H_ */
@@ -0,0 +1,36 @@
+#include "ribs.h"
+#include "minunit.h"
+
+static int fired[8];
+static int num_fired;
+
+static void record(void *arg) {
+    fired[num_fired++] = (int)(intptr_t)arg;
+}
+
+const char *test_timer_wheel() {
+    mu_assert(0 == epoll_worker_init(), "epoll_worker_init() failed");
+    /* level 0, level 1 (>= 64 ticks) and an entry that gets cancelled */
+    static const int delays[] = { 150, 1, 70, 20, 100 };
+    struct timer_wheel_entry entries[5];
+    int i;
+    for (i = 0; i < 5; ++i) {
+        timer_wheel_entry_init(entries + i, record, (void *)(intptr_t)i);
+        mu_assert(0 == timer_wheel_add(entries + i, delays[i]), "timer_wheel_add() failed");
+        mu_assert(timer_wheel_pending(entries + i), "entry is not pending");
+    }
+    timer_wheel_cancel(entries + 4);
+    mu_assert(!timer_wheel_pending(entries + 4), "cancelled entry is still pending");
+    uint64_t start = timer_wheel_now();
+    struct timespec req = { 0, 200 * 1000000L };
+    mu_assert(0 == ribs_nanosleep(0, &req, NULL), "ribs_nanosleep() failed");
+    mu_assert(timer_wheel_now() - start >= 200, "ribs_nanosleep() returned early");
+    mu_assert_eqi(num_fired, 4);
+    mu_assert_eqi(fired[0], 1);
+    mu_assert_eqi(fired[1], 3);
+    mu_assert_eqi(fired[2], 2);
+    mu_assert_eqi(fired[3], 0);
+    for (i = 0; i < 4; ++i)
+        mu_assert(!timer_wheel_pending(entries + i), "fired entry is still pending");
+    return NULL;
+}
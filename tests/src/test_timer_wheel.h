@@ -0,0 +1,6 @@
+#ifndef _TEST_TIMER_WHEEL__H_
+#define _TEST_TIMER_WHEEL__H_
+
+const char *test_timer_wheel();
+
+#endif /* _TEST_TIMER_WHEEL__H_ */